@@ -0,0 +1,84 @@
+#include <chrono>
+#include <string>
+
+#include <benchmark/benchmark.h>
+
+#include "shkwon/cli_parser/cli_parser.hpp"
+
+namespace
+{
+const char *const kArguments[] = { "tool", "-vp", "8080", "--name=frontend", "--timeout", "250ms", "--retries=3", "input" };
+const int kNumArguments = static_cast<int>(sizeof(kArguments) / sizeof(kArguments[0]));
+
+// Setting up a parser over a table of options and parsing a typical command line, as a short-lived tool does once.
+void BM_CliParserTable(benchmark::State &state)
+{
+    for (auto _ : state)
+    {
+        int port = 0;
+        int retries = 0;
+        bool verbose = false;
+        shkwon::StringView name;
+        std::chrono::milliseconds timeout(0);
+        const shkwon::CliOption options[] = {
+            shkwon::CliOption('p', "port", port),       shkwon::CliOption('r', "retries", retries),
+            shkwon::CliOption('v', "verbose", verbose), shkwon::CliOption('n', "name", name),
+            shkwon::CliOption('t', "timeout", timeout),
+        };
+        shkwon::CliParser parser(options);
+        auto status = parser.TryParse(kNumArguments, kArguments);
+        benchmark::DoNotOptimize(status);
+        benchmark::DoNotOptimize(port);
+    }
+}
+
+// The same with AddOption(), which keeps the options and their usage in the parser.
+void BM_CliParserAddOption(benchmark::State &state)
+{
+    for (auto _ : state)
+    {
+        int port = 0;
+        int retries = 0;
+        bool verbose = false;
+        std::string name;
+        std::chrono::milliseconds timeout(0);
+        shkwon::CliParser parser("tool");
+        parser.AddOption('p', "port", port, "-p --port <port>")
+            .AddOption('r', "retries", retries, "-r --retries <count>")
+            .AddOption('v', "verbose", verbose, "-v --verbose")
+            .AddOption('n', "name", name, "-n --name <name>")
+            .AddOption('t', "timeout", timeout, "-t --timeout <duration>");
+        auto status = parser.TryParse(kNumArguments, kArguments);
+        benchmark::DoNotOptimize(status);
+        benchmark::DoNotOptimize(port);
+    }
+}
+
+// Parsing a config file that is already in memory.
+void BM_CliParserConfig(benchmark::State &state)
+{
+    int port = 0;
+    int retries = 0;
+    bool verbose = false;
+    shkwon::StringView name;
+    std::chrono::milliseconds timeout(0);
+    const shkwon::CliOption options[] = {
+        shkwon::CliOption('p', "port", port),       shkwon::CliOption('r', "retries", retries),
+        shkwon::CliOption('v', "verbose", verbose), shkwon::CliOption('n', "name", name),
+        shkwon::CliOption('t', "timeout", timeout),
+    };
+    shkwon::CliParser parser(options);
+    const char *config = "# frontend\nport = 8080\nverbose\nname = \"frontend\"\ntimeout = 250ms\nretries = 3\n";
+    for (auto _ : state)
+    {
+        auto status = parser.ParseConfig(config);
+        benchmark::DoNotOptimize(status);
+    }
+}
+} // namespace
+
+BENCHMARK(BM_CliParserTable);
+BENCHMARK(BM_CliParserAddOption);
+BENCHMARK(BM_CliParserConfig);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,155 @@
+#include <chrono>
+#include <cstdint>
+#include <random>
+
+#include <benchmark/benchmark.h>
+
+#include "shkwon/expiry/compact_expiry_set.hpp"
+#include "shkwon/expiry/expiry_set.hpp"
+#include "shkwon/expiry/sharded_expiry_set.hpp"
+
+namespace
+{
+// Looks up random keys, half of them present, in a set of `range(0)` live keys.
+void BM_ExpirySetContains(benchmark::State &state)
+{
+    auto num_keys = static_cast<uint64_t>(state.range(0));
+    shkwon::ExpirySet<uint64_t> set;
+    for (uint64_t key = 0; key < num_keys; ++key)
+    {
+        set.Insert(key, std::chrono::minutes(30));
+    }
+
+    std::mt19937_64 random(42);
+    std::uniform_int_distribution<uint64_t> keys(0, 2 * num_keys - 1);
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(set.Contains(keys(random)));
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+
+// Refreshes random keys of a set of `range(0)` live keys, which moves each of them to another slot.
+void BM_ExpirySetRefresh(benchmark::State &state)
+{
+    auto num_keys = static_cast<uint64_t>(state.range(0));
+    shkwon::ExpirySet<uint64_t> set;
+    for (uint64_t key = 0; key < num_keys; ++key)
+    {
+        set.Insert(key, std::chrono::minutes(30));
+    }
+
+    std::mt19937_64 random(42);
+    std::uniform_int_distribution<uint64_t> keys(0, num_keys - 1);
+    std::uniform_int_distribution<int64_t> ttl(60, 1800);
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(set.Refresh(keys(random), std::chrono::seconds(ttl(random))));
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+
+// The dedup pattern: every packet inserts a new key with a short time to live, so the set keeps dropping the oldest
+// keys while it holds the ones of the last `range(0)` milliseconds.
+void BM_ExpirySetChurn(benchmark::State &state)
+{
+    shkwon::ExpirySet<uint64_t> set;
+    auto ttl = std::chrono::milliseconds(state.range(0));
+    uint64_t key = 0;
+    for (auto _ : state)
+    {
+        set.Insert(key++, ttl);
+    }
+    state.counters["live_keys"] = static_cast<double>(set.GetSize());
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+
+// BM_ExpirySetContains on the flat table of a CompactExpirySet without a capacity.
+void BM_CompactExpirySetContains(benchmark::State &state)
+{
+    auto num_keys = static_cast<uint64_t>(state.range(0));
+    shkwon::CompactExpirySet<uint64_t> set;
+    for (uint64_t key = 0; key < num_keys; ++key)
+    {
+        set.Insert(key, std::chrono::minutes(30));
+    }
+
+    std::mt19937_64 random(42);
+    std::uniform_int_distribution<uint64_t> keys(0, 2 * num_keys - 1);
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(set.Contains(keys(random)));
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+
+// Inserts new keys into a full CompactExpirySet of `range(0)` keys, so every insert evicts one, sampled by the policy
+// in `range(1)`: 0 for the soonest expiry, 1 for the least recently used.
+void BM_CompactExpirySetEvict(benchmark::State &state)
+{
+    auto capacity = static_cast<uint64_t>(state.range(0));
+    auto eviction =
+        state.range(1) != 0 ? shkwon::ExpiryEviction::LeastRecentlyUsed : shkwon::ExpiryEviction::SoonestExpiry;
+    shkwon::CompactExpirySet<uint64_t> set(capacity, eviction);
+    std::mt19937_64 random(42);
+    std::uniform_int_distribution<int64_t> ttl(60, 1800);
+    uint64_t key = 0;
+    for (; key < capacity; ++key)
+    {
+        set.Insert(key, std::chrono::seconds(ttl(random)));
+    }
+
+    for (auto _ : state)
+    {
+        set.Insert(key++, std::chrono::seconds(ttl(random)));
+    }
+    state.counters["evicted"] = static_cast<double>(set.GetNumEvicted());
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+
+// Looks up random keys from every benchmark thread at once in one set of 500k live keys, with one insert of a short
+// lived key every `range(0)` lookups per thread, so the set keeps expiring keys meanwhile. Compares one ExpirySet, under
+// one mutex, with a ShardedExpirySet of one shard per hardware thread.
+template <class Set>
+void BM_ConcurrentContains(benchmark::State &state)
+{
+    constexpr uint64_t kNumKeys = 500000;
+    static Set *set = []() {
+        auto *set = new Set();
+        for (uint64_t key = 0; key < kNumKeys; ++key)
+        {
+            set->Insert(key, std::chrono::minutes(30));
+        }
+        return set;
+    }();
+
+    auto insert_every = state.range(0);
+    std::mt19937_64 random(static_cast<uint64_t>(state.thread_index()));
+    std::uniform_int_distribution<uint64_t> keys(0, kNumKeys - 1);
+    auto next_key = kNumKeys + static_cast<uint64_t>(state.thread_index()) * (uint64_t(1) << 40);
+    int64_t n = 0;
+    for (auto _ : state)
+    {
+        if (++n % insert_every == 0)
+        {
+            set->Insert(next_key++, std::chrono::milliseconds(10));
+            continue;
+        }
+        benchmark::DoNotOptimize(set->Contains(keys(random)));
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+} // namespace
+
+BENCHMARK(BM_ExpirySetContains)->Arg(1000)->Arg(500000);
+BENCHMARK(BM_ExpirySetRefresh)->Arg(1000)->Arg(500000);
+BENCHMARK(BM_ExpirySetChurn)->Arg(5)->Arg(100);
+BENCHMARK(BM_CompactExpirySetContains)->Arg(1000)->Arg(500000);
+BENCHMARK(BM_CompactExpirySetEvict)->ArgsProduct({ { 1000000 }, { 0, 1 } });
+BENCHMARK_TEMPLATE(BM_ConcurrentContains, shkwon::ExpirySet<uint64_t>)->Arg(10)->ThreadRange(1, 16)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_ConcurrentContains, shkwon::ShardedExpirySet<uint64_t>)
+    ->Arg(10)
+    ->ThreadRange(1, 16)
+    ->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -0,0 +1,79 @@
+#include <cstdint>
+#include <mutex>
+#include <shared_mutex>
+
+#include <benchmark/benchmark.h>
+
+#include "shkwon/lock/big_reader_lock.hpp"
+#include "shkwon/lock/snapshot.hpp"
+#include "shkwon/lock/starve_free_lock.hpp"
+
+namespace
+{
+// A small table guarded by the lock, read by every thread and written once every `range(0)` operations per thread, or
+// never for 0.
+template <class Lock>
+struct Guarded
+{
+    Lock lock;
+    uint64_t values[8] = {};
+};
+
+// Takes the lock shared from every benchmark thread at once, with an occasional exclusive lock in between. Compares
+// BigReaderLock against StarveFreeLock and std::shared_timed_mutex, the shared mutex available in C++14.
+template <class Lock>
+void BM_SharedLock(benchmark::State &state)
+{
+    static Guarded<Lock> guarded;
+    auto write_every = state.range(0);
+    int64_t n = 0;
+    uint64_t sum = 0;
+    for (auto _ : state)
+    {
+        if (write_every != 0 && ++n % write_every == 0)
+        {
+            std::lock_guard<Lock> lock(guarded.lock);
+            ++guarded.values[n % 8];
+            continue;
+        }
+
+        std::shared_lock<Lock> lock(guarded.lock);
+        sum += guarded.values[n % 8];
+    }
+    benchmark::DoNotOptimize(sum);
+    state.SetItemsProcessed(state.iterations());
+}
+
+// The same reads and writes on a Snapshot, whose readers take no lock.
+void BM_SnapshotRead(benchmark::State &state)
+{
+    struct Values
+    {
+        uint64_t values[8];
+    };
+    static shkwon::Snapshot<Values> snapshot(Values{});
+    auto write_every = state.range(0);
+    int64_t n = 0;
+    uint64_t sum = 0;
+    for (auto _ : state)
+    {
+        if (write_every != 0 && ++n % write_every == 0)
+        {
+            snapshot.Update([n](Values &next) { ++next.values[n % 8]; });
+            continue;
+        }
+
+        sum += snapshot.Read()->values[n % 8];
+    }
+    benchmark::DoNotOptimize(sum);
+    state.SetItemsProcessed(state.iterations());
+}
+} // namespace
+
+// The argument is the number of operations per thread between two writes; 0 means read only.
+BENCHMARK_TEMPLATE(BM_SharedLock, BigReaderLock)->Arg(0)->Arg(1000)->ThreadRange(1, 64)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_SharedLock, StarveFreeLock)->Arg(0)->Arg(1000)->ThreadRange(1, 64)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_SharedLock, std::shared_timed_mutex)->Arg(0)->Arg(1000)->ThreadRange(1, 64)->UseRealTime();
+BENCHMARK(BM_SnapshotRead)->Arg(0)->Arg(1000)->ThreadRange(1, 64)->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -0,0 +1,49 @@
+// The zones are compiled in here whatever the CMake option says; SHKWON_PROFILE_TSC still picks the clock.
+#ifndef SHKWON_ENABLE_PROFILER
+#define SHKWON_ENABLE_PROFILER
+#endif
+
+#include <chrono>
+
+#include <benchmark/benchmark.h>
+
+#include "shkwon/timer/profiler.hpp"
+
+namespace
+{
+// The cost of reading the clock of the profiler once.
+void BM_ProfileClock(benchmark::State &state)
+{
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(shkwon::ProfileClock::Now());
+    }
+}
+
+// The cost of an empty zone: two clock reads and recording the timing, from every benchmark thread at once.
+void BM_ProfileScope(benchmark::State &state)
+{
+    for (auto _ : state)
+    {
+        SHKWON_PROFILE_SCOPE("empty");
+    }
+}
+
+// Collecting while the zone holds stats from every thread that entered it.
+void BM_ProfileCollect(benchmark::State &state)
+{
+    {
+        SHKWON_PROFILE_SCOPE("empty");
+    }
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(shkwon::Profiler::Get().Collect());
+    }
+}
+} // namespace
+
+BENCHMARK(BM_ProfileClock);
+BENCHMARK(BM_ProfileScope)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK(BM_ProfileCollect);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,112 @@
+#include <string>
+
+#include <benchmark/benchmark.h>
+
+#include "shkwon/status/status.hpp"
+#include "shkwon/thread_pool/thread_pool_error_code.hpp"
+
+namespace
+{
+// A validation step that fails for negative values, the way the hot paths of callers build their errors.
+__attribute__((noinline)) shkwon::Status CheckFormatted(int value)
+{
+    if (value >= 0)
+    {
+        return shkwon::Status(shkwon::ThreadPoolErrorCode::Success);
+    }
+    return shkwon::Status(shkwon::ThreadPoolErrorCode::QueueFull, "value %d is negative", value);
+}
+
+__attribute__((noinline)) shkwon::Status CheckStatic(int value)
+{
+    if (value >= 0)
+    {
+        return shkwon::Status(shkwon::ThreadPoolErrorCode::Success);
+    }
+    return shkwon::Status(shkwon::ThreadPoolErrorCode::QueueFull, shkwon::StaticMessage("value is negative"));
+}
+
+__attribute__((noinline)) shkwon::Result<int> Parse(int value)
+{
+    return shkwon::Result<int>{ value, shkwon::Status(shkwon::ThreadPoolErrorCode::Success) };
+}
+
+// Returning and checking a successful Status.
+void BM_StatusSuccess(benchmark::State &state)
+{
+    int value = 1;
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(value);
+        auto status = CheckFormatted(value);
+        benchmark::DoNotOptimize(static_cast<bool>(status));
+    }
+}
+
+// Returning an error with a printf-style message, which is formatted and allocated once.
+void BM_StatusFormatted(benchmark::State &state)
+{
+    int value = -1;
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(value);
+        auto status = CheckFormatted(value);
+        benchmark::DoNotOptimize(static_cast<bool>(status));
+    }
+}
+
+// Returning an error with a StaticMessage, which is never copied.
+void BM_StatusStatic(benchmark::State &state)
+{
+    int value = -1;
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(value);
+        auto status = CheckStatic(value);
+        benchmark::DoNotOptimize(static_cast<bool>(status));
+    }
+}
+
+// Chaining a formatted message onto a formatted error.
+void BM_StatusChain(benchmark::State &state)
+{
+    int value = -1;
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(value);
+        auto status = CheckFormatted(value).Chain("while checking %d", value);
+        benchmark::DoNotOptimize(static_cast<bool>(status));
+    }
+}
+
+// Putting the full message of a chained error together.
+void BM_StatusMessage(benchmark::State &state)
+{
+    auto status = CheckFormatted(-1).Chain("while checking").Chain("while loading");
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(status.message());
+    }
+}
+
+// Returning a successful Result<int>.
+void BM_ResultSuccess(benchmark::State &state)
+{
+    int value = 1;
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(value);
+        auto result = Parse(value);
+        benchmark::DoNotOptimize(result.data);
+    }
+}
+} // namespace
+
+BENCHMARK(BM_StatusSuccess);
+BENCHMARK(BM_StatusFormatted);
+BENCHMARK(BM_StatusStatic);
+BENCHMARK(BM_StatusChain);
+BENCHMARK(BM_StatusMessage);
+BENCHMARK(BM_ResultSuccess);
+
+BENCHMARK_MAIN();
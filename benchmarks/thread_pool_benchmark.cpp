@@ -0,0 +1,147 @@
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <thread>
+
+#include <benchmark/benchmark.h>
+
+#include "shkwon/thread_pool/thread_pool.hpp"
+#include "shkwon/thread_pool/work_stealing_thread_pool.hpp"
+
+namespace
+{
+// Counts every heap allocation in the process so that the benchmarks can report allocations per job.
+std::atomic<size_t> g_allocations(0);
+
+constexpr int kJobsPerIteration = 1024;
+
+// ThreadPool on top of the lock-free bounded ring instead of the mutex-guarded queue.
+class BoundedThreadPool : public shkwon::ThreadPool
+{
+public:
+    explicit BoundedThreadPool(size_t num_threads)
+        : shkwon::ThreadPool(MakeOptions(num_threads))
+    {
+    }
+
+private:
+    static shkwon::ThreadPoolOptions MakeOptions(size_t num_threads)
+    {
+        shkwon::ThreadPoolOptions options;
+        options.num_threads = num_threads;
+        options.queue = shkwon::ThreadPoolQueue::BoundedLockFree;
+        options.queue_capacity = kJobsPerIteration;
+        return options;
+    }
+};
+
+void WaitFor(const std::atomic<int> &counter, int expected)
+{
+    while (counter.load(std::memory_order_acquire) != expected)
+    {
+        std::this_thread::yield();
+    }
+}
+
+template <class Pool>
+void BM_Push(benchmark::State &state)
+{
+    Pool pool(static_cast<size_t>(state.range(0)));
+    std::atomic<int> done(0);
+
+    size_t allocations = g_allocations.load();
+    for (auto _ : state)
+    {
+        done.store(0, std::memory_order_relaxed);
+        for (int i = 0; i < kJobsPerIteration; ++i)
+        {
+            pool.Push([&done]() { done.fetch_add(1, std::memory_order_release); });
+        }
+        WaitFor(done, kJobsPerIteration);
+    }
+    allocations = g_allocations.load() - allocations;
+
+    state.SetItemsProcessed(state.iterations() * kJobsPerIteration);
+    state.counters["allocs_per_job"] =
+        static_cast<double>(allocations) / static_cast<double>(state.iterations() * kJobsPerIteration);
+}
+
+template <class Pool>
+void BM_Post(benchmark::State &state)
+{
+    Pool pool(static_cast<size_t>(state.range(0)));
+    std::atomic<int> done(0);
+
+    size_t allocations = g_allocations.load();
+    for (auto _ : state)
+    {
+        done.store(0, std::memory_order_relaxed);
+        for (int i = 0; i < kJobsPerIteration; ++i)
+        {
+            pool.Post([&done]() { done.fetch_add(1, std::memory_order_release); });
+        }
+        WaitFor(done, kJobsPerIteration);
+    }
+    allocations = g_allocations.load() - allocations;
+
+    state.SetItemsProcessed(state.iterations() * kJobsPerIteration);
+    state.counters["allocs_per_job"] =
+        static_cast<double>(allocations) / static_cast<double>(state.iterations() * kJobsPerIteration);
+}
+} // namespace
+
+// None of these are inlined, so that GCC does not match a std::free() or an operator delete() up with the std::malloc()
+// or the operator new() it would otherwise see through and warn of a mismatch.
+__attribute__((noinline)) void *operator new(size_t size)
+{
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = std::malloc(size == 0 ? 1 : size))
+    {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+__attribute__((noinline)) void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+__attribute__((noinline)) void operator delete(void *p, size_t) noexcept
+{
+    operator delete(p);
+}
+
+// Over-aligned types are allocated through these from C++17 on, so allocs_per_job counts them too.
+#if defined(__cpp_aligned_new)
+__attribute__((noinline)) void *operator new(size_t size, std::align_val_t alignment)
+{
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    auto align = static_cast<size_t>(alignment);
+    if (void *p = std::aligned_alloc(align, (size + align - 1) / align * align))
+    {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+__attribute__((noinline)) void operator delete(void *p, std::align_val_t) noexcept
+{
+    std::free(p);
+}
+
+__attribute__((noinline)) void operator delete(void *p, size_t, std::align_val_t alignment) noexcept
+{
+    operator delete(p, alignment);
+}
+#endif
+
+BENCHMARK_TEMPLATE(BM_Push, shkwon::ThreadPool)->Arg(1)->Arg(4)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_Post, shkwon::ThreadPool)->Arg(1)->Arg(4)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_Post, BoundedThreadPool)->Arg(1)->Arg(4)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_Post, shkwon::InstrumentedThreadPool)->Arg(1)->Arg(4)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_Push, shkwon::WorkStealingThreadPool)->Arg(1)->Arg(4)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_Post, shkwon::WorkStealingThreadPool)->Arg(1)->Arg(4)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_Post, shkwon::InstrumentedWorkStealingThreadPool)->Arg(1)->Arg(4)->UseRealTime();
+
+BENCHMARK_MAIN();
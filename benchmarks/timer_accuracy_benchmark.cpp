@@ -0,0 +1,179 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "shkwon/time_wheel_scheduler/time_wheel_scheduler.hpp"
+
+namespace
+{
+// Counts the bytes on the heap so that the benchmarks can report the memory held per live timer. Every block carries its
+// size in front of it, in a header that keeps the block aligned.
+std::atomic<int64_t> g_heap_bytes(0);
+
+constexpr size_t kHeaderSize = alignof(std::max_align_t);
+
+std::unique_ptr<shkwon::TimeWheelScheduler> MakeScheduler(shkwon::TimerTickMode mode)
+{
+    auto scheduler = std::make_unique<shkwon::TimeWheelScheduler>(1, mode);
+    scheduler->AppendTimeWheel(24, 3600 * 1000, "hour");
+    scheduler->AppendTimeWheel(60, 60 * 1000, "minute");
+    scheduler->AppendTimeWheel(60, 1000, "second");
+    scheduler->AppendTimeWheel(1000, 1, "millisecond");
+    return scheduler;
+}
+
+// The classic setup with 50ms ticks, whose slots are longer than the milliseconds the timers are counted in.
+std::unique_ptr<shkwon::TimeWheelScheduler> MakeCoarseScheduler(shkwon::TimerTickMode mode)
+{
+    auto scheduler = std::make_unique<shkwon::TimeWheelScheduler>(50, mode);
+    scheduler->AppendTimeWheel(60, 3000, "minute");
+    scheduler->AppendTimeWheel(60, 50, "tick");
+    return scheduler;
+}
+
+// Fires timers due within half a second on a running scheduler with 1ms ticks and reports how late they fire,
+// measured from their due time to the start of their callback: percentiles and a histogram in microseconds.
+// The first argument selects the tickless mode, the second inline execution instead of posting to the pool, the third
+// 50ms ticks instead, for which anything early is a timer fired at the start of its tick rather than after it.
+void BM_ExpiryJitter(benchmark::State &state)
+{
+    constexpr int kTimers = 2000;
+    auto mode = state.range(0) != 0 ? shkwon::TimerTickMode::Tickless : shkwon::TimerTickMode::Periodic;
+    auto scheduler = state.range(2) != 0 ? MakeCoarseScheduler(mode) : MakeScheduler(mode);
+    if (state.range(1) != 0)
+    {
+        scheduler->SetExecution(shkwon::TimerExecution::Inline);
+    }
+    scheduler->Start();
+
+    using Clock = std::chrono::steady_clock;
+    std::mt19937_64 random(42);
+    std::uniform_int_distribution<int64_t> delay(1, 500);
+    std::vector<int64_t> lateness;
+    for (auto _ : state)
+    {
+        std::vector<Clock::time_point> due(kTimers);
+        std::vector<Clock::time_point> fired(kTimers);
+        std::atomic<int> remaining(kTimers);
+        for (int i = 0; i < kTimers; ++i)
+        {
+            auto ms = delay(random);
+            due[i] = Clock::now() + std::chrono::milliseconds(ms);
+            scheduler->CreateTimerAfter(ms, [&fired, &remaining, i]() {
+                fired[i] = Clock::now();
+                remaining.fetch_sub(1, std::memory_order_release);
+            });
+        }
+        while (remaining.load(std::memory_order_acquire) > 0)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+
+        for (int i = 0; i < kTimers; ++i)
+        {
+            lateness.push_back(std::chrono::duration_cast<std::chrono::microseconds>(fired[i] - due[i]).count());
+        }
+    }
+    scheduler->Stop();
+
+    std::sort(lateness.begin(), lateness.end());
+    auto percentile = [&lateness](double p) {
+        return static_cast<double>(lateness[static_cast<size_t>(p * static_cast<double>(lateness.size() - 1))]);
+    };
+    state.counters["p50_us"] = percentile(0.5);
+    state.counters["p99_us"] = percentile(0.99);
+    state.counters["max_us"] = static_cast<double>(lateness.back());
+
+    // Upper bounds of the buckets; the last one takes everything later.
+    const int64_t bounds[] = { 0, 250, 500, 1000, 2000, 5000, 10000, 50000 };
+    const char *names[] = { "early", "le_250us", "le_500us", "le_1ms", "le_2ms", "le_5ms", "le_10ms", "le_50ms" };
+    size_t begin = 0;
+    for (size_t b = 0; b < sizeof(bounds) / sizeof(bounds[0]); ++b)
+    {
+        auto end = static_cast<size_t>(std::upper_bound(lateness.begin(), lateness.end(),
+                                                        b == 0 ? bounds[b] - 1 : bounds[b]) -
+                                       lateness.begin());
+        state.counters[names[b]] = static_cast<double>(end - begin);
+        begin = end;
+    }
+    state.counters["gt_50ms"] = static_cast<double>(lateness.size() - begin);
+}
+
+// Creates `num_timers` timers an hour or so away and reports the heap they hold once the scheduler thread has placed
+// them, everything included: jobs, tasks, slots and command nodes that have not been freed.
+void BM_MemoryPerTimer(benchmark::State &state)
+{
+    auto num_timers = static_cast<size_t>(state.range(0));
+    std::mt19937_64 random(42);
+    std::uniform_int_distribution<int64_t> delay(3600 * 1000, 2 * 3600 * 1000);
+    double bytes_per_timer = 0;
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        {
+            auto scheduler = MakeScheduler(shkwon::TimerTickMode::Tickless);
+            scheduler->Start();
+            std::vector<shkwon::TimerHandle> handles;
+            handles.reserve(num_timers);
+
+            auto before = g_heap_bytes.load();
+            for (size_t i = 0; i < num_timers; ++i)
+            {
+                handles.push_back(scheduler->CreateTimerAfter(delay(random), []() {}));
+            }
+            // Give the thread time to drain the command queue.
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            bytes_per_timer = static_cast<double>(g_heap_bytes.load() - before -
+                                                  static_cast<int64_t>(handles.capacity() * sizeof(handles[0]))) /
+                              static_cast<double>(num_timers);
+            scheduler->Stop();
+        }
+        state.ResumeTiming();
+    }
+    state.counters["bytes_per_timer"] = bytes_per_timer;
+}
+} // namespace
+
+// None of these are inlined, so that GCC does not see through them to the std::malloc() and std::free() of the blocks
+// with their headers, and warn of a mismatch.
+__attribute__((noinline)) void *operator new(size_t size)
+{
+    if (auto *p = static_cast<char *>(std::malloc(size + kHeaderSize)))
+    {
+        *reinterpret_cast<size_t *>(p) = size;
+        g_heap_bytes.fetch_add(static_cast<int64_t>(size), std::memory_order_relaxed);
+        return p + kHeaderSize;
+    }
+    throw std::bad_alloc();
+}
+
+__attribute__((noinline)) void operator delete(void *p) noexcept
+{
+    if (p == nullptr)
+    {
+        return;
+    }
+    auto *block = static_cast<char *>(p) - kHeaderSize;
+    g_heap_bytes.fetch_sub(static_cast<int64_t>(*reinterpret_cast<size_t *>(block)), std::memory_order_relaxed);
+    std::free(block);
+}
+
+__attribute__((noinline)) void operator delete(void *p, size_t) noexcept
+{
+    operator delete(p);
+}
+
+BENCHMARK(BM_ExpiryJitter)->ArgsProduct({ { 0, 1 }, { 0, 1 }, { 0, 1 } })->Iterations(3)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_MemoryPerTimer)->Arg(10000)->Arg(1000000)->Iterations(1)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,330 @@
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "shkwon/time_wheel_scheduler/sharded_time_wheel_scheduler.hpp"
+#include "shkwon/time_wheel_scheduler/time_wheel.hpp"
+#include "shkwon/time_wheel_scheduler/time_wheel_scheduler.hpp"
+#include "shkwon/time_wheel_scheduler/timer_slab.hpp"
+
+namespace
+{
+// Hours, minutes, seconds and 50ms ticks, greatest to least.
+template <class Scheduler>
+void AppendDefaultTimeWheels(Scheduler &scheduler)
+{
+    scheduler.AppendTimeWheel(24, 3600 * 1000, "hour");
+    scheduler.AppendTimeWheel(60, 60 * 1000, "minute");
+    scheduler.AppendTimeWheel(60, 1000, "second");
+    scheduler.AppendTimeWheel(20, 50, "millisecond");
+}
+
+// A running scheduler holding `num_timers` live timers due between one second and one hour from now, while the
+// benchmark creates, cancels and resets timers around them. It is tickless, so its thread only wakes up to apply the
+// commands and to fire the few timers that fall due during the run. A preset scheduler builds its own power-of-two
+// hierarchy with 1ms ticks instead of using the default wheels.
+struct LoadedScheduler
+{
+    explicit LoadedScheduler(size_t num_timers, bool preset = false)
+        : owner(MakeScheduler(preset))
+        , scheduler(*owner)
+        , random(42)
+    {
+        scheduler.Start();
+        handles.reserve(num_timers);
+        std::uniform_int_distribution<int64_t> delay(1000, 3600 * 1000);
+        for (size_t i = 0; i < num_timers; ++i)
+        {
+            handles.push_back(scheduler.CreateTimerAfter(delay(random), []() {}));
+        }
+    }
+
+    ~LoadedScheduler()
+    {
+        scheduler.Stop();
+    }
+
+    static std::unique_ptr<shkwon::TimeWheelScheduler> MakeScheduler(bool preset)
+    {
+        if (preset)
+        {
+            return std::make_unique<shkwon::TimeWheelScheduler>(std::chrono::milliseconds(1), std::chrono::hours(24),
+                                                                shkwon::TimerTickMode::Tickless);
+        }
+        auto scheduler = std::make_unique<shkwon::TimeWheelScheduler>(50, shkwon::TimerTickMode::Tickless);
+        AppendDefaultTimeWheels(*scheduler);
+        return scheduler;
+    }
+
+    std::unique_ptr<shkwon::TimeWheelScheduler> owner;
+    shkwon::TimeWheelScheduler &scheduler;
+    std::vector<shkwon::TimerHandle> handles;
+    std::mt19937_64 random;
+};
+
+void BM_CreateCancel(benchmark::State &state)
+{
+    LoadedScheduler loaded(static_cast<size_t>(state.range(0)), state.range(1) != 0);
+    for (auto _ : state)
+    {
+        auto handle = loaded.scheduler.CreateTimerAfter(30 * 1000, []() {});
+        benchmark::DoNotOptimize(loaded.scheduler.CancelTimer(handle));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+void BM_Reset(benchmark::State &state)
+{
+    LoadedScheduler loaded(static_cast<size_t>(state.range(0)), state.range(1) != 0);
+    std::uniform_int_distribution<size_t> pick(0, loaded.handles.size() - 1);
+    std::uniform_int_distribution<int64_t> delay(1000, 3600 * 1000);
+    for (auto _ : state)
+    {
+        auto &handle = loaded.handles[pick(loaded.random)];
+        benchmark::DoNotOptimize(loaded.scheduler.ResetTimerAfter(handle, delay(loaded.random)));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+// Creates and cancels `batch` timers at a time, the way a reconnecting client reschedules its timers, either one by one
+// or through the batch APIs.
+void BM_CreateCancelBatch(benchmark::State &state)
+{
+    LoadedScheduler loaded(1000000);
+    auto batch = static_cast<size_t>(state.range(0));
+    auto batched = state.range(1) != 0;
+    std::uniform_int_distribution<int64_t> delay(1000, 60 * 1000);
+    std::vector<std::pair<int64_t, std::function<void()>>> timers;
+    for (size_t i = 0; i < batch; ++i)
+    {
+        timers.emplace_back(delay(loaded.random), []() {});
+    }
+
+    std::vector<shkwon::TimerHandle> handles;
+    for (auto _ : state)
+    {
+        if (batched)
+        {
+            handles = loaded.scheduler.CreateTimersAfter(timers.begin(), timers.end());
+            benchmark::DoNotOptimize(loaded.scheduler.CancelTimers(handles.begin(), handles.end()));
+            continue;
+        }
+
+        handles.clear();
+        for (auto &timer : timers)
+        {
+            handles.push_back(loaded.scheduler.CreateTimerAfter(timer.first, timer.second));
+        }
+        for (auto &handle : handles)
+        {
+            benchmark::DoNotOptimize(loaded.scheduler.CancelTimer(handle));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(batch));
+}
+
+// A started scheduler shared by every benchmark thread; it lives until the process exits.
+template <class Scheduler>
+Scheduler &GetRunningScheduler()
+{
+    static auto *scheduler = []() {
+        auto *created = new Scheduler();
+        AppendDefaultTimeWheels(*created);
+        created->Start();
+        return created;
+    }();
+    return *scheduler;
+}
+
+// Creates and cancels timers from several threads at once against a running scheduler.
+template <class Scheduler>
+void BM_CreateCancelThreaded(benchmark::State &state)
+{
+    auto &scheduler = GetRunningScheduler<Scheduler>();
+    for (auto _ : state)
+    {
+        auto handle = scheduler.CreateTimerAfter(30 * 1000, []() {});
+        benchmark::DoNotOptimize(scheduler.CancelTimer(handle));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+// Expires `num_timers` timers spread over four seconds of 1ms ticks in a two-level hierarchy, so most of them cascade
+// from the outer wheel before they fire.
+void BM_Expire(benchmark::State &state)
+{
+    auto num_timers = static_cast<size_t>(state.range(0));
+    shkwon::TimerSlab slab;
+    shkwon::TimeWheel outer(64, 64, "outer");
+    shkwon::TimeWheel inner(64, 1, "inner");
+    outer.SetLessLevelTimeWheel(&inner);
+    inner.SetGreaterLevelTimeWheel(&outer);
+    std::mt19937_64 random(42);
+    std::uniform_int_distribution<int64_t> delay(1, 4095);
+
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        auto now = shkwon::GetSteadyTimestamp();
+        for (size_t i = 0; i < num_timers; ++i)
+        {
+            auto *job = slab.Allocate();
+            job->Assign(static_cast<uint32_t>(i + 1), now + delay(random), 0, []() {});
+            outer.AddTimer(job, now);
+        }
+        state.ResumeTiming();
+
+        // The wheels tick faster than the clock, as fast as the timers can be fired.
+        auto tick_time = now;
+        while (slab.GetNumAllocated() > 0)
+        {
+            inner.Increase(++tick_time);
+            auto slot = inner.PopCurrentSlot();
+            while (!slot.Empty())
+            {
+                auto *job = static_cast<shkwon::TimeoutJob *>(slot.PopFront());
+                job->Run();
+                slab.Free(job);
+            }
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(num_timers));
+}
+
+// The baseline the wheels have to beat: a std::priority_queue of jobs ordered by expiration time. A priority_queue
+// cannot remove an entry, so a cancelled job stays in it until it reaches the top and is dropped there.
+struct HeapEntry
+{
+    int64_t when;
+    shkwon::TimeoutJob *job;
+
+    bool operator>(const HeapEntry &other) const
+    {
+        return when > other.when;
+    }
+};
+
+using TimerHeap = std::priority_queue<HeapEntry, std::vector<HeapEntry>, std::greater<HeapEntry>>;
+
+// Expires the same timers as BM_Expire from the heap.
+void BM_HeapExpire(benchmark::State &state)
+{
+    auto num_timers = static_cast<size_t>(state.range(0));
+    shkwon::TimerSlab slab;
+    std::mt19937_64 random(42);
+    std::uniform_int_distribution<int64_t> delay(1, 4095);
+
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        TimerHeap heap;
+        auto now = shkwon::GetSteadyTimestamp();
+        for (size_t i = 0; i < num_timers; ++i)
+        {
+            auto *job = slab.Allocate();
+            job->Assign(static_cast<uint32_t>(i + 1), now + delay(random), 0, []() {});
+            heap.push(HeapEntry{ job->GetExpirationTime(), job });
+        }
+        state.ResumeTiming();
+
+        while (!heap.empty())
+        {
+            auto *job = heap.top().job;
+            heap.pop();
+            job->Run();
+            slab.Free(job);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(num_timers));
+}
+
+// Adds and cancels a timer with `num_timers` others live, on a four-level wheel hierarchy of 1ms ticks without a
+// scheduler thread in between, to compare with BM_HeapAddCancel.
+void BM_WheelAddCancel(benchmark::State &state)
+{
+    auto num_timers = static_cast<size_t>(state.range(0));
+    shkwon::TimerSlab slab;
+    std::vector<std::unique_ptr<shkwon::TimeWheel>> wheels;
+    for (int level = 3; level >= 0; --level)
+    {
+        wheels.push_back(std::make_unique<shkwon::TimeWheel>(64, uint64_t(1) << (6 * level)));
+        if (wheels.size() > 1)
+        {
+            wheels[wheels.size() - 2]->SetLessLevelTimeWheel(wheels.back().get());
+            wheels.back()->SetGreaterLevelTimeWheel(wheels[wheels.size() - 2].get());
+        }
+    }
+    auto &greatest = *wheels.front();
+
+    std::mt19937_64 random(42);
+    std::uniform_int_distribution<int64_t> delay(1000, 3600 * 1000);
+    auto now = shkwon::GetSteadyTimestamp();
+    for (size_t i = 0; i < num_timers; ++i)
+    {
+        auto *job = slab.Allocate();
+        job->Assign(static_cast<uint32_t>(i + 1), now + delay(random), 0, []() {});
+        greatest.AddTimer(job, now);
+    }
+
+    for (auto _ : state)
+    {
+        auto *job = slab.Allocate();
+        job->Assign(1, now + 30 * 1000, 0, []() {});
+        greatest.AddTimer(job, now);
+        shkwon::TimerList::Unlink(job);
+        slab.Free(job);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+// Adds and cancels a timer with `num_timers` others live on the heap. The cancelled jobs pile up in the heap, as they
+// do in a priority_queue based timer until their time comes.
+void BM_HeapAddCancel(benchmark::State &state)
+{
+    auto num_timers = static_cast<size_t>(state.range(0));
+    shkwon::TimerSlab slab;
+    TimerHeap heap;
+    std::mt19937_64 random(42);
+    std::uniform_int_distribution<int64_t> delay(1000, 3600 * 1000);
+    auto now = shkwon::GetSteadyTimestamp();
+    for (size_t i = 0; i < num_timers; ++i)
+    {
+        auto *job = slab.Allocate();
+        job->Assign(static_cast<uint32_t>(i + 1), now + delay(random), 0, []() {});
+        heap.push(HeapEntry{ job->GetExpirationTime(), job });
+    }
+
+    for (auto _ : state)
+    {
+        auto *job = slab.Allocate();
+        job->Assign(1, now + 30 * 1000, 0, []() {});
+        heap.push(HeapEntry{ job->GetExpirationTime(), job });
+        benchmark::DoNotOptimize(job->TryCancel(1));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+} // namespace
+
+// The first argument is the number of live timers, the second selects the preset hierarchy.
+BENCHMARK(BM_CreateCancel)
+    ->ArgsProduct({ { 1000, 100000, 1000000, 10000000 }, { 0, 1 } })
+    ->Unit(benchmark::kNanosecond);
+BENCHMARK(BM_Reset)->ArgsProduct({ { 1000, 100000, 1000000, 10000000 }, { 0, 1 } })->Unit(benchmark::kNanosecond);
+// The second argument selects the batch APIs.
+BENCHMARK(BM_CreateCancelBatch)->ArgsProduct({ { 1000 }, { 0, 1 } })->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_CreateCancelThreaded, shkwon::TimeWheelScheduler)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_CreateCancelThreaded, shkwon::ShardedTimeWheelScheduler)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK(BM_Expire)->Arg(1000000)->Arg(10000000)->Iterations(3)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_HeapExpire)->Arg(1000000)->Arg(10000000)->Iterations(3)->Unit(benchmark::kMillisecond);
+// A fixed number of iterations, since every one of them leaves a cancelled job in the heap.
+BENCHMARK(BM_WheelAddCancel)->Arg(1000)->Arg(100000)->Arg(1000000)->Iterations(1000000)->Unit(benchmark::kNanosecond);
+BENCHMARK(BM_HeapAddCancel)->Arg(1000)->Arg(100000)->Arg(1000000)->Iterations(1000000)->Unit(benchmark::kNanosecond);
+
+BENCHMARK_MAIN();
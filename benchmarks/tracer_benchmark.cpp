@@ -0,0 +1,67 @@
+// The trace points are compiled in here whatever the CMake option says; SHKWON_PROFILE_TSC still picks the clock.
+#ifndef SHKWON_ENABLE_TRACING
+#define SHKWON_ENABLE_TRACING
+#endif
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+#include <benchmark/benchmark.h>
+
+#include "shkwon/debug/tracer.hpp"
+
+namespace
+{
+std::string GetTracePath()
+{
+    return "tracer_benchmark.json";
+}
+
+// The cost of a trace point while the tracer is not recording: one relaxed load.
+void BM_TraceEventIdle(benchmark::State &state)
+{
+    for (auto _ : state)
+    {
+        SHKWON_TRACE_INSTANT("idle");
+    }
+}
+
+// The cost of recording one event, from every benchmark thread at once. The flusher drains often enough that the
+// rings do not fill up.
+void BM_TraceEvent(benchmark::State &state)
+{
+    if (state.thread_index() == 0)
+    {
+        shkwon::Tracer::Get().Start(GetTracePath(), std::chrono::milliseconds(1), size_t(1) << 16);
+    }
+    for (auto _ : state)
+    {
+        SHKWON_TRACE_INSTANT("instant");
+    }
+    if (state.thread_index() == 0)
+    {
+        shkwon::Tracer::Get().Stop();
+        state.counters["dropped"] = static_cast<double>(shkwon::Tracer::Get().GetNumDropped());
+        std::remove(GetTracePath().c_str());
+    }
+}
+
+// The cost of an empty slice: a begin and an end event.
+void BM_TraceScope(benchmark::State &state)
+{
+    shkwon::Tracer::Get().Start(GetTracePath(), std::chrono::milliseconds(1), size_t(1) << 16);
+    for (auto _ : state)
+    {
+        SHKWON_TRACE_SCOPE("empty");
+    }
+    shkwon::Tracer::Get().Stop();
+    std::remove(GetTracePath().c_str());
+}
+} // namespace
+
+BENCHMARK(BM_TraceEventIdle);
+BENCHMARK(BM_TraceEvent)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK(BM_TraceScope);
+
+BENCHMARK_MAIN();
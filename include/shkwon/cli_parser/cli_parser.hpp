@@ -1,53 +1,455 @@
-#include <getopt.h>
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
 #include <iostream>
+#include <limits>
+#include <memory>
+#include <stdexcept>
 #include <string>
-#include <tuple>
-#include <unordered_map>
+#include <type_traits>
 #include <vector>
 
+#include "shkwon/cli_parser/cli_parser_error_code.hpp"
+#include "shkwon/cli_parser/string_view.hpp"
+#include "shkwon/status/status.hpp"
+
 namespace shkwon
 {
-class CliParser
+/**
+ * One accepted spelling of an enum option, for the `values` table of a CliOption.
+ */
+template <class E>
+struct CliEnumValue
+{
+    StringView name;
+    E value;
+};
+
+namespace detail
+{
+/**
+ * Parses the text of an option into its destination. Specialised for every supported destination type; kTakesValue is
+ * false for flags, which are set without a value, and kNeedsValues is true for enums, which need a CliEnumValue table.
+ */
+template <class T, class Enable = void>
+struct CliValue;
+
+template <class T>
+bool ParseCliInteger(StringView text, T &value)
+{
+    auto negative = !text.empty() && text[0] == '-';
+    auto digits = negative ? text.substr(1) : text;
+    if (digits.empty())
+    {
+        return false;
+    }
+
+    uint64_t magnitude = 0;
+    for (auto c : digits)
+    {
+        if (c < '0' || c > '9')
+        {
+            return false;
+        }
+        auto digit = static_cast<uint64_t>(c - '0');
+        if (magnitude > (UINT64_MAX - digit) / 10)
+        {
+            return false;
+        }
+        magnitude = magnitude * 10 + digit;
+    }
+
+    auto max = static_cast<uint64_t>(std::numeric_limits<T>::max());
+    if (!negative)
+    {
+        if (magnitude > max)
+        {
+            return false;
+        }
+        value = static_cast<T>(magnitude);
+        return true;
+    }
+    if (magnitude == 0)
+    {
+        value = 0;
+        return true;
+    }
+    if (!std::is_signed<T>::value || magnitude - 1 > max)
+    {
+        return false;
+    }
+    // -(magnitude - 1) - 1 cannot overflow, even for the lowest value of T.
+    value = static_cast<T>(-static_cast<int64_t>(magnitude - 1) - 1);
+    return true;
+}
+
+template <class T>
+struct CliValue<T, typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value>::type>
+{
+    static constexpr bool kTakesValue = true;
+    static constexpr bool kNeedsValues = false;
+
+    static bool Parse(StringView text, T &value, const void * /* values */, size_t /* num_values */)
+    {
+        return ParseCliInteger(text, value);
+    }
+};
+
+template <>
+struct CliValue<bool>
+{
+    static constexpr bool kTakesValue = false;
+    static constexpr bool kNeedsValues = false;
+
+    static bool Parse(StringView text, bool &value, const void * /* values */, size_t /* num_values */)
+    {
+        if (text == "true" || text == "1" || text == "yes" || text == "on")
+        {
+            value = true;
+            return true;
+        }
+        if (text == "false" || text == "0" || text == "no" || text == "off")
+        {
+            value = false;
+            return true;
+        }
+        return false;
+    }
+};
+
+template <class T>
+struct CliValue<T, typename std::enable_if<std::is_enum<T>::value>::type>
+{
+    static constexpr bool kTakesValue = true;
+    static constexpr bool kNeedsValues = true;
+
+    static bool Parse(StringView text, T &value, const void *values, size_t num_values)
+    {
+        auto *names = static_cast<const CliEnumValue<T> *>(values);
+        for (size_t i = 0; i < num_values; ++i)
+        {
+            if (names[i].name == text)
+            {
+                value = names[i].value;
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+template <>
+struct CliValue<StringView>
+{
+    static constexpr bool kTakesValue = true;
+    static constexpr bool kNeedsValues = false;
+
+    static bool Parse(StringView text, StringView &value, const void * /* values */, size_t /* num_values */)
+    {
+        value = text;
+        return true;
+    }
+};
+
+template <>
+struct CliValue<std::string>
+{
+    static constexpr bool kTakesValue = true;
+    static constexpr bool kNeedsValues = false;
+
+    static bool Parse(StringView text, std::string &value, const void * /* values */, size_t /* num_values */)
+    {
+        value.assign(text.data(), text.size());
+        return true;
+    }
+};
+
+// A whole number with an optional unit of ns, us, ms, s, m or h, and in the units of the duration without one. The
+// value has to be a whole number of those units, so that e.g. 1500us is not silently cut down to 1ms.
+template <class Rep, class Period>
+struct CliValue<std::chrono::duration<Rep, Period>>
+{
+    static_assert(std::is_integral<Rep>::value, "Duration options need an integral count");
+
+    static constexpr bool kTakesValue = true;
+    static constexpr bool kNeedsValues = false;
+
+    using Duration = std::chrono::duration<Rep, Period>;
+
+    static bool Parse(StringView text, Duration &value, const void * /* values */, size_t /* num_values */)
+    {
+        size_t digits = 0;
+        while (digits < text.size() && ((text[digits] >= '0' && text[digits] <= '9') || (digits == 0 && text[0] == '-')))
+        {
+            ++digits;
+        }
+        auto unit = text.substr(digits);
+        if (unit.empty())
+        {
+            Rep count;
+            if (!ParseCliInteger(text, count))
+            {
+                return false;
+            }
+            value = Duration(count);
+            return true;
+        }
+
+        int64_t factor;
+        if (unit == "ns")
+        {
+            factor = 1;
+        }
+        else if (unit == "us")
+        {
+            factor = 1000;
+        }
+        else if (unit == "ms")
+        {
+            factor = 1000 * 1000;
+        }
+        else if (unit == "s")
+        {
+            factor = 1000 * 1000 * 1000;
+        }
+        else if (unit == "m")
+        {
+            factor = int64_t(60) * 1000 * 1000 * 1000;
+        }
+        else if (unit == "h")
+        {
+            factor = int64_t(3600) * 1000 * 1000 * 1000;
+        }
+        else
+        {
+            return false;
+        }
+
+        int64_t count;
+        if (!ParseCliInteger(text.substr(0, digits), count) || count > INT64_MAX / factor || count < INT64_MIN / factor)
+        {
+            return false;
+        }
+        std::chrono::nanoseconds nanoseconds(count * factor);
+        auto converted = std::chrono::duration_cast<std::chrono::duration<long double, Period>>(nanoseconds).count();
+        if (converted > static_cast<long double>(std::numeric_limits<Rep>::max()) ||
+            converted < static_cast<long double>(std::numeric_limits<Rep>::lowest()))
+        {
+            return false;
+        }
+        auto result = std::chrono::duration_cast<Duration>(nanoseconds);
+        if (std::chrono::duration_cast<std::chrono::nanoseconds>(result) != nanoseconds)
+        {
+            return false;
+        }
+        value = result;
+        return true;
+    }
+};
+
+// Every occurrence of the option appends to the list, and so does every comma-separated item of its value.
+template <class T, class Allocator>
+struct CliValue<std::vector<T, Allocator>>
+{
+    static constexpr bool kTakesValue = true;
+    static constexpr bool kNeedsValues = CliValue<T>::kNeedsValues;
+
+    static bool Parse(StringView text, std::vector<T, Allocator> &value, const void *values, size_t num_values)
+    {
+        size_t start = 0;
+        while (true)
+        {
+            auto comma = text.find(',', start);
+            T item;
+            if (!CliValue<T>::Parse(text.substr(start, comma - start), item, values, num_values))
+            {
+                return false;
+            }
+            value.push_back(std::move(item));
+            if (comma == StringView::npos)
+            {
+                return true;
+            }
+            start = comma + 1;
+        }
+    }
+};
+
+template <class T>
+struct CliElement
+{
+    using type = T;
+};
+
+template <class T, class Allocator>
+struct CliElement<std::vector<T, Allocator>>
+{
+    using type = T;
+};
+} // namespace detail
+
+/**
+ * An option of a CliParser: a short and/or long name, a destination and its usage text.
+ *
+ * The destination can be a bool, which makes the option a flag that takes no value, an integer, an enum together with
+ * a table of its names, a std::chrono::duration, a StringView into the arguments, a std::string, or a std::vector of
+ * any of those. The constructors are constexpr, so a table of options over static destinations is built at compile
+ * time, and one over local destinations costs a few stores:
+ *
+ * @code
+ * static const CliEnumValue<Mode> kModes[] = { { "fast", Mode::Fast }, { "safe", Mode::Safe } };
+ * const CliOption options[] = {
+ *     CliOption('p', "port", port, "-p --port <port>  // port to listen on"),
+ *     CliOption('t', "timeout", timeout, "-t --timeout <duration>  // e.g. 250ms"),
+ *     CliOption('m', "mode", mode, kModes, "-m --mode <fast|safe>"),
+ *     CliOption('v', "verbose", verbose, "-v --verbose"),
+ * };
+ * CliParser parser(options);
+ * @endcode
+ */
+class CliOption
 {
 public:
-    CliParser(void)
-        : name_("unknown")
-        , usage_guide_("Usage:\n")
+    /**
+     * @param short_option The character of the short option, or '\0' for none.
+     * @param long_option The name of the long option, or an empty one for none. Must outlive the option.
+     * @param dest Where the value of the option is stored.
+     * @param usage The line of usage text of the option. Must outlive the option.
+     */
+    template <class T>
+    constexpr CliOption(char short_option, StringView long_option, T &dest, StringView usage = StringView()) noexcept
+        : short_option_(short_option)
+        , long_option_(long_option)
+        , usage_(usage)
+        , dest_(&dest)
+        , values_(nullptr)
+        , num_values_(0)
+        , takes_value_(detail::CliValue<T>::kTakesValue)
+        , parse_(&Parse<T>)
     {
+        static_assert(!detail::CliValue<T>::kNeedsValues, "Enum options need a table of CliEnumValue");
     }
-    CliParser(std::string name)
-        : name_(name)
-        , usage_guide_("Usage:\n")
+
+    /**
+     * An enum option, or a list of them.
+     *
+     * @param values The accepted names and their values. Must outlive the option.
+     */
+    template <class T, class E, size_t N>
+    constexpr CliOption(char short_option, StringView long_option, T &dest, const CliEnumValue<E> (&values)[N],
+                        StringView usage = StringView()) noexcept
+        : short_option_(short_option)
+        , long_option_(long_option)
+        , usage_(usage)
+        , dest_(&dest)
+        , values_(values)
+        , num_values_(N)
+        , takes_value_(detail::CliValue<T>::kTakesValue)
+        , parse_(&Parse<T>)
     {
+        static_assert(std::is_same<typename detail::CliElement<T>::type, E>::value,
+                      "The names have to be of the enum of the destination");
     }
-    ~CliParser()
+
+    constexpr char GetShortOption() const noexcept
     {
+        return short_option_;
+    }
+
+    constexpr StringView GetLongOption() const noexcept
+    {
+        return long_option_;
+    }
+
+    constexpr StringView GetUsage() const noexcept
+    {
+        return usage_;
     }
 
     /**
-     * Adds an option to the command line interface argument parser.
+     * @return false for a flag, which is set without a value.
+     */
+    constexpr bool TakesValue() const noexcept
+    {
+        return takes_value_;
+    }
+
+    /**
+     * Parses a value into the destination.
      *
-     * @param short_option A single character representing the short option.
-     * @param long_option  A string representing the long option.
-     * @param dest         A reference to a string where the value of the option will be stored.
-     * @param usage        A string representing the usage of the option.
-     * @return A reference to the CliParser object.
+     * @return false if the value is not valid for the destination, which may be left partly written for a list.
      */
-    CliParser &AddOption(const char &short_option, const char *long_option, std::string &dest,
-                         const std::string &usage) noexcept
+    bool Assign(StringView value) const
     {
-        short_options_ += short_option;
-        short_options_ += ':';
+        return parse_(dest_, values_, num_values_, value);
+    }
 
-        struct option opt = { long_option, required_argument, nullptr, short_option };
-        long_options_.push_back(opt);
+private:
+    template <class T>
+    static bool Parse(void *dest, const void *values, size_t num_values, StringView text)
+    {
+        return detail::CliValue<T>::Parse(text, *static_cast<T *>(dest), values, num_values);
+    }
 
-        usage_guide_ += usage;
-        usage_guide_ += "\n";
+    char short_option_;
+    StringView long_option_;
+    StringView usage_;
+    void *dest_;
+    const void *values_;
+    size_t num_values_;
+    bool takes_value_;
+    bool (*parse_)(void *dest, const void *values, size_t num_values, StringView text);
+};
 
-        option_map_[short_option] = { opt, &dest, nullptr };
+/**
+ * A command line parser in the style of getopt_long: short options that can be grouped (`-vp 80`, `-p80`), long
+ * options that can be abbreviated to any unique prefix (`--port=80`, `--po 80`), and `--` to end the options.
+ * Arguments that are not options are skipped, or collected with SetPositionals().
+ *
+ * Unlike getopt_long it keeps no global state, so several parsers can run at once, and it neither copies nor allocates:
+ * values are views of argv, converted straight into the destinations of their options. A parser built over a table of
+ * CliOption does not allocate at all; AddOption() keeps its options in a vector. `key=value` config files go through
+ * the same options and conversions with ParseConfig().
+ */
+class CliParser
+{
+public:
+    CliParser(void)
+        : CliParser("unknown")
+    {
+    }
+    CliParser(std::string name)
+        : name_(std::move(name))
+        , table_(nullptr)
+        , table_size_(0)
+        , positionals_(nullptr)
+    {
+    }
 
-        return *this;
+    /**
+     * @param options The options, which must outlive the parser.
+     */
+    template <size_t N>
+    CliParser(std::string name, const CliOption (&options)[N])
+        : name_(std::move(name))
+        , table_(options)
+        , table_size_(N)
+        , positionals_(nullptr)
+    {
+    }
+
+    template <size_t N>
+    explicit CliParser(const CliOption (&options)[N])
+        : CliParser("unknown", options)
+    {
+    }
+
+    ~CliParser()
+    {
     }
 
     /**
@@ -55,76 +457,408 @@ public:
      *
      * @param short_option A single character representing the short option.
      * @param long_option  A string representing the long option.
-     * @param dest         A reference to a boolean where the value of the option will be stored.
+     * @param dest         A reference to where the value of the option will be stored, of any type CliOption takes.
+     *                     A bool makes the option a flag.
      * @param usage        A string representing the usage of the option.
      * @return A reference to the CliParser object.
      */
-    CliParser &AddOption(const char &short_option, const char *long_option, bool &dest,
-                         const std::string usage) noexcept
+    template <class T>
+    CliParser &AddOption(const char &short_option, const char *long_option, T &dest, const std::string &usage)
     {
-        short_options_ += short_option;
-
-        struct option opt = { long_option, no_argument, nullptr, short_option };
-        long_options_.push_back(opt);
-
-        usage_guide_ += usage;
-        usage_guide_ += "\n";
+        added_.push_back(CliOption(short_option, long_option, dest));
+        this->AppendUsage(usage);
+        return *this;
+    }
 
-        option_map_[short_option] = { opt, nullptr, &dest };
+    /**
+     * Adds an enum option, or a list of them, to the command line interface argument parser.
+     *
+     * @param values The accepted names and their values, which must outlive the parser.
+     */
+    template <class T, class E, size_t N>
+    CliParser &AddOption(const char &short_option, const char *long_option, T &dest, const CliEnumValue<E> (&values)[N],
+                         const std::string &usage)
+    {
+        added_.push_back(CliOption(short_option, long_option, dest, values));
+        this->AppendUsage(usage);
+        return *this;
+    }
 
+    /**
+     * Collects the arguments that are not options, in order, instead of skipping them.
+     */
+    CliParser &SetPositionals(std::vector<StringView> &dest)
+    {
+        positionals_ = &dest;
         return *this;
     }
 
     /**
-     * Parses the command line interface arguments.
+     * Parses the command line interface arguments. Prints the usage and exits on -h or --help, unless an option of
+     * its own uses them.
      *
      * @param argc The number of arguments.
      * @param argv The arguments.
+     * @throw std::runtime_error if an option is unknown or its value is missing or invalid.
      */
     void Parse(int argc, char **argv)
     {
-        auto help_flag = false;
-        this->AddOption('h', "help", help_flag, "-h --help  // print USAGE");
-        auto next_option = 0;
+        auto status = this->TryParse(argc, argv);
+        if (status)
+        {
+            return;
+        }
+        if (status.code() == CliParserErrorCode::HelpRequested)
+        {
+            std::cout << this->GetUsage() << std::endl;
+            std::exit(0);
+        }
 
-        do
+        std::cerr << status.message() << std::endl;
+        throw std::runtime_error("Invalid option.");
+    }
+
+    /**
+     * Parses the command line interface arguments without printing or exiting. The string destinations of the
+     * options hold views of argv.
+     *
+     * @return CliParserErrorCode::HelpRequested on -h or --help, or the error of the first argument that failed, with
+     *         the options before it already set.
+     */
+    Status TryParse(int argc, const char *const *argv)
+    {
+        auto options_done = false;
+        for (int i = 1; i < argc; ++i)
         {
-            next_option = getopt_long(argc, argv, short_options_.c_str(), long_options_.data(), nullptr);
+            StringView argument(argv[i]);
+            if (options_done || argument.size() < 2 || argument[0] != '-')
+            {
+                this->AddPositional(argument);
+                continue;
+            }
+            if (argument == "--")
+            {
+                options_done = true;
+                continue;
+            }
 
-            if (next_option != -1)
+            auto status = argument[1] == '-' ? this->ParseLongOption(argument.substr(2), argc, argv, i)
+                                             : this->ParseShortOptions(argument.substr(1), argc, argv, i);
+            if (!status)
             {
-                auto it = option_map_.find(next_option);
-                if (it != option_map_.end())
+                return status;
+            }
+        }
+        return Status(CliParserErrorCode::Success);
+    }
+
+    /**
+     * Parses a config file of `key=value` lines, where every key is the long name of an option, as if given as
+     * `--key=value`. A flag can also be given as a key alone. Blank lines and lines starting with `#` or `;` are
+     * skipped, whitespace around keys and values is trimmed, and a value can be quoted.
+     *
+     * @param text The contents of the file, which must outlive the string destinations of the options.
+     * @return The error of the first line that failed, with the options before it already set.
+     */
+    Status ParseConfig(StringView text)
+    {
+        size_t line_number = 0;
+        for (size_t start = 0; start < text.size();)
+        {
+            auto end = text.find('\n', start);
+            if (end == StringView::npos)
+            {
+                end = text.size();
+            }
+            auto line = Trim(text.substr(start, end - start));
+            start = end + 1;
+            ++line_number;
+            if (line.empty() || line[0] == '#' || line[0] == ';')
+            {
+                continue;
+            }
+
+            auto equals = line.find('=');
+            auto key = Trim(line.substr(0, equals));
+            auto *option = this->FindOption([key](const CliOption &o) { return o.GetLongOption() == key; });
+            if (key.empty() || option == nullptr)
+            {
+                return Status(CliParserErrorCode::UnknownOption, "Unknown key '%.*s' on line %zu",
+                              static_cast<int>(key.size()), key.data(), line_number);
+            }
+
+            if (equals == StringView::npos)
+            {
+                if (option->TakesValue())
                 {
-                    if (it->first == 'h')
-                    {
-                        std::cout << usage_guide_ << std::endl;
-                        std::exit(0);
-                    }
-                    if (std::get<0>(it->second).has_arg == required_argument)
-                    {
-                        *(std::string *)std::get<1>(it->second) = optarg;
-                    }
-                    else
-                    {
-                        *(bool *)std::get<2>(it->second) = true;
-                    }
-
-                    continue;
+                    return Status(CliParserErrorCode::MissingValue, "Key '%.*s' on line %zu requires a value",
+                                  static_cast<int>(key.size()), key.data(), line_number);
                 }
+                option->Assign("true");
+                continue;
+            }
 
-                std::cerr << "Invalid option (" << next_option << "," << std::hex << next_option << ")" << std::endl;
-                throw std::runtime_error("Invalid option.");
+            auto value = Unquote(Trim(line.substr(equals + 1)));
+            if (!option->Assign(value))
+            {
+                if (!option->TakesValue())
+                {
+                    return Status(CliParserErrorCode::UnexpectedValue,
+                                  "Key '%.*s' on line %zu takes no value but true or false, got '%.*s'",
+                                  static_cast<int>(key.size()), key.data(), line_number, static_cast<int>(value.size()),
+                                  value.data());
+                }
+                return Status(CliParserErrorCode::InvalidValue, "Invalid value '%.*s' for key '%.*s' on line %zu",
+                              static_cast<int>(value.size()), value.data(), static_cast<int>(key.size()), key.data(),
+                              line_number);
             }
+        }
+        return Status(CliParserErrorCode::Success);
+    }
+
+    /**
+     * Reads a config file and parses it with ParseConfig(). The parser keeps the contents, so the string
+     * destinations of the options stay valid as long as it lives.
+     */
+    Status ParseConfigFile(const std::string &path)
+    {
+        auto *file = std::fopen(path.c_str(), "rb");
+        if (file == nullptr)
+        {
+            return Status(CliParserErrorCode::CannotOpenFile, "Cannot open config file '%s'", path.c_str());
+        }
+
+        std::unique_ptr<std::string> contents(new std::string());
+        char buffer[4096];
+        size_t read;
+        while ((read = std::fread(buffer, 1, sizeof(buffer), file)) > 0)
+        {
+            contents->append(buffer, read);
+        }
+        std::fclose(file);
+
+        config_files_.push_back(std::move(contents));
+        return this->ParseConfig(*config_files_.back());
+    }
 
-        } while (next_option != -1);
+    /**
+     * @return The usage text printed for -h and --help.
+     */
+    std::string GetUsage() const
+    {
+        std::string usage = "Usage:\n";
+        for (size_t i = 0; i < table_size_; ++i)
+        {
+            auto line = table_[i].GetUsage();
+            if (!line.empty())
+            {
+                usage.append(line.data(), line.size());
+                usage += "\n";
+            }
+        }
+        usage += usage_guide_;
+        if (this->HasHelpOption())
+        {
+            usage += "-h --help  // print USAGE\n";
+        }
+        return usage;
     }
 
 private:
+    static bool IsSpace(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\r';
+    }
+
+    static StringView Trim(StringView text)
+    {
+        size_t begin = 0;
+        auto end = text.size();
+        while (begin < end && IsSpace(text[begin]))
+        {
+            ++begin;
+        }
+        while (end > begin && IsSpace(text[end - 1]))
+        {
+            --end;
+        }
+        return text.substr(begin, end - begin);
+    }
+
+    static StringView Unquote(StringView text)
+    {
+        if (text.size() >= 2 && text[0] == '"' && text[text.size() - 1] == '"')
+        {
+            return text.substr(1, text.size() - 2);
+        }
+        return text;
+    }
+
+    void AppendUsage(const std::string &usage)
+    {
+        usage_guide_ += usage;
+        usage_guide_ += "\n";
+    }
+
+    void AddPositional(StringView argument)
+    {
+        if (positionals_ != nullptr)
+        {
+            positionals_->push_back(argument);
+        }
+    }
+
+    // The table first, then the options added one by one.
+    template <class Match>
+    const CliOption *FindOption(Match &&match) const
+    {
+        for (size_t i = 0; i < table_size_; ++i)
+        {
+            if (match(table_[i]))
+            {
+                return &table_[i];
+            }
+        }
+        for (auto &option : added_)
+        {
+            if (match(option))
+            {
+                return &option;
+            }
+        }
+        return nullptr;
+    }
+
+    // -h and --help are built in unless an option of the parser's own uses either of them.
+    bool HasHelpOption() const
+    {
+        return this->FindOption([](const CliOption &o) {
+                   return o.GetShortOption() == 'h' || o.GetLongOption() == "help";
+               }) == nullptr;
+    }
+
+    Status ParseShortOptions(StringView group, int argc, const char *const *argv, int &index)
+    {
+        for (size_t i = 0; i < group.size(); ++i)
+        {
+            auto c = group[i];
+            auto *option = this->FindOption([c](const CliOption &o) { return o.GetShortOption() == c; });
+            if (option == nullptr)
+            {
+                if (c == 'h' && this->HasHelpOption())
+                {
+                    return Status(CliParserErrorCode::HelpRequested);
+                }
+                return Status(CliParserErrorCode::UnknownOption, "Unknown option '-%c'", c);
+            }
+
+            if (!option->TakesValue())
+            {
+                option->Assign("true");
+                continue;
+            }
+
+            // The rest of the group is the value, or else the next argument is.
+            StringView value;
+            if (i + 1 < group.size())
+            {
+                value = group.substr(i + 1);
+            }
+            else if (index + 1 < argc)
+            {
+                value = argv[++index];
+            }
+            else
+            {
+                return Status(CliParserErrorCode::MissingValue, "Option '-%c' requires a value", c);
+            }
+            if (!option->Assign(value))
+            {
+                return Status(CliParserErrorCode::InvalidValue, "Invalid value '%.*s' for option '-%c'",
+                              static_cast<int>(value.size()), value.data(), c);
+            }
+            return Status(CliParserErrorCode::Success);
+        }
+        return Status(CliParserErrorCode::Success);
+    }
+
+    Status ParseLongOption(StringView argument, int argc, const char *const *argv, int &index)
+    {
+        auto equals = argument.find('=');
+        auto name = argument.substr(0, equals);
+
+        // An exact match wins over prefixes of longer names. An empty name, as in `--=7`, matches neither, rather than an
+        // option without a long name.
+        auto *option =
+            this->FindOption([name](const CliOption &o) { return !name.empty() && o.GetLongOption() == name; });
+        if (option == nullptr && !name.empty())
+        {
+            size_t matches = 0;
+            this->FindOption([name, &matches, &option](const CliOption &o) {
+                if (o.GetLongOption().StartsWith(name))
+                {
+                    ++matches;
+                    option = &o;
+                }
+                return false;
+            });
+            if (matches > 1)
+            {
+                return Status(CliParserErrorCode::AmbiguousOption, "Option '--%.*s' is ambiguous",
+                              static_cast<int>(name.size()), name.data());
+            }
+        }
+        if (option == nullptr)
+        {
+            if (name == "help" && this->HasHelpOption())
+            {
+                return Status(CliParserErrorCode::HelpRequested);
+            }
+            return Status(CliParserErrorCode::UnknownOption, "Unknown option '--%.*s'", static_cast<int>(name.size()),
+                          name.data());
+        }
+
+        StringView value;
+        if (equals != StringView::npos)
+        {
+            // A flag can be given a value too, e.g. --verbose=false.
+            value = argument.substr(equals + 1);
+        }
+        else if (!option->TakesValue())
+        {
+            value = "true";
+        }
+        else if (index + 1 < argc)
+        {
+            value = argv[++index];
+        }
+        else
+        {
+            return Status(CliParserErrorCode::MissingValue, "Option '--%.*s' requires a value",
+                          static_cast<int>(name.size()), name.data());
+        }
+
+        if (!option->Assign(value))
+        {
+            if (!option->TakesValue())
+            {
+                return Status(CliParserErrorCode::UnexpectedValue,
+                              "Option '--%.*s' takes no value but true or false, got '%.*s'",
+                              static_cast<int>(name.size()), name.data(), static_cast<int>(value.size()), value.data());
+            }
+            return Status(CliParserErrorCode::InvalidValue, "Invalid value '%.*s' for option '--%.*s'",
+                          static_cast<int>(value.size()), value.data(), static_cast<int>(name.size()), name.data());
+        }
+        return Status(CliParserErrorCode::Success);
+    }
+
     std::string name_;
-    std::string short_options_;
-    std::vector<struct option> long_options_;
+    const CliOption *table_;
+    size_t table_size_;
+    std::vector<CliOption> added_;
     std::string usage_guide_;
-    std::unordered_map<char, std::tuple<struct option, std::string *, bool *>> option_map_;
+    std::vector<StringView> *positionals_;
+    // The contents of the config files read so far, which the string destinations may point into.
+    std::vector<std::unique_ptr<std::string>> config_files_;
 };
-} // namespace shkwon
\ No newline at end of file
+} // namespace shkwon
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <string>
+#include <system_error>
+
+#include "shkwon/status/success_condition.hpp"
+
+namespace shkwon
+{
+enum class CliParserErrorCode
+{
+    Success = 0,
+    UnknownOption = 1,
+    AmbiguousOption = 2,
+    MissingValue = 3,
+    UnexpectedValue = 4,
+    InvalidValue = 5,
+    HelpRequested = 6,
+    CannotOpenFile = 7,
+};
+
+class CliParserErrorCategory : public std::error_category
+{
+public:
+    const char *name() const noexcept override
+    {
+        return "CliParser";
+    }
+    std::string message(int value) const override
+    {
+        switch (static_cast<CliParserErrorCode>(value))
+        {
+        case CliParserErrorCode::Success:
+            return "Success";
+        case CliParserErrorCode::UnknownOption:
+            return "Unknown option";
+        case CliParserErrorCode::AmbiguousOption:
+            return "Ambiguous option";
+        case CliParserErrorCode::MissingValue:
+            return "Option requires a value";
+        case CliParserErrorCode::UnexpectedValue:
+            return "Option takes no value";
+        case CliParserErrorCode::InvalidValue:
+            return "Invalid option value";
+        case CliParserErrorCode::HelpRequested:
+            return "Help requested";
+        case CliParserErrorCode::CannotOpenFile:
+            return "Cannot open file";
+        default:
+            return "Unknown";
+        }
+    }
+    std::error_condition default_error_condition(int value) const noexcept override
+    {
+        if (static_cast<CliParserErrorCode>(value) == CliParserErrorCode::Success)
+        {
+            return make_error_condition(SuccessCondition::Success);
+        }
+        return std::error_condition(value, *this);
+    }
+};
+
+inline const std::error_category &GetCliParserErrorCategory() noexcept
+{
+    static const CliParserErrorCategory category;
+    return category;
+}
+
+inline std::error_code make_error_code(CliParserErrorCode value) noexcept
+{
+    return std::error_code(static_cast<int>(value), GetCliParserErrorCategory());
+}
+} // namespace shkwon
+
+namespace std
+{
+template <>
+struct is_error_code_enum<shkwon::CliParserErrorCode> : true_type
+{
+};
+} // namespace std
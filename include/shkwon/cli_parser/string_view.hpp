@@ -0,0 +1,138 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace shkwon
+{
+/**
+ * A non-owning view of a run of characters, standing in for std::string_view until the library moves past C++14. It
+ * has the subset of that interface the library uses, under the same names, so that it can be replaced by an alias.
+ *
+ * The characters are not necessarily null-terminated, and must outlive the view.
+ */
+class StringView
+{
+public:
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
+    constexpr StringView() noexcept
+        : data_(nullptr)
+        , size_(0)
+    {
+    }
+    constexpr StringView(const char *text) noexcept
+        : data_(text)
+        , size_(GetLength(text))
+    {
+    }
+    constexpr StringView(const char *text, size_t size) noexcept
+        : data_(text)
+        , size_(size)
+    {
+    }
+    StringView(const std::string &text) noexcept
+        : data_(text.data())
+        , size_(text.size())
+    {
+    }
+
+    constexpr const char *data() const noexcept
+    {
+        return data_;
+    }
+
+    constexpr size_t size() const noexcept
+    {
+        return size_;
+    }
+
+    constexpr bool empty() const noexcept
+    {
+        return size_ == 0;
+    }
+
+    constexpr const char *begin() const noexcept
+    {
+        return data_;
+    }
+
+    constexpr const char *end() const noexcept
+    {
+        return data_ + size_;
+    }
+
+    constexpr char operator[](size_t index) const noexcept
+    {
+        return data_[index];
+    }
+
+    /**
+     * @return The view of at most `count` characters from `position`, which must not be past the end.
+     */
+    constexpr StringView substr(size_t position, size_t count = npos) const noexcept
+    {
+        return StringView(data_ + position, count < size_ - position ? count : size_ - position);
+    }
+
+    /**
+     * @return The position of the first `c` from `position` on, or npos.
+     */
+    constexpr size_t find(char c, size_t position = 0) const noexcept
+    {
+        for (; position < size_; ++position)
+        {
+            if (data_[position] == c)
+            {
+                return position;
+            }
+        }
+        return npos;
+    }
+
+    constexpr bool StartsWith(StringView prefix) const noexcept
+    {
+        return prefix.size_ <= size_ && StringView(data_, prefix.size_) == prefix;
+    }
+
+    std::string ToString() const
+    {
+        return std::string(data_, size_);
+    }
+
+    friend constexpr bool operator==(StringView lhs, StringView rhs) noexcept
+    {
+        if (lhs.size_ != rhs.size_)
+        {
+            return false;
+        }
+        for (size_t i = 0; i < lhs.size_; ++i)
+        {
+            if (lhs.data_[i] != rhs.data_[i])
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    friend constexpr bool operator!=(StringView lhs, StringView rhs) noexcept
+    {
+        return !(lhs == rhs);
+    }
+
+private:
+    static constexpr size_t GetLength(const char *text) noexcept
+    {
+        size_t length = 0;
+        while (text != nullptr && text[length] != '\0')
+        {
+            ++length;
+        }
+        return length;
+    }
+
+    const char *data_;
+    size_t size_;
+};
+} // namespace shkwon
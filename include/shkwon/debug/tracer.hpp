@@ -0,0 +1,514 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "shkwon/timer/profile_clock.hpp"
+
+/**
+ * Records the rest of the enclosing scope as a slice named `name`, which must be a string literal, while the Tracer is
+ * recording. Expands to nothing unless SHKWON_ENABLE_TRACING is defined, which the SHKWON_ENABLE_TRACING CMake option
+ * does; so do the trace points in ThreadPool and TimeWheelScheduler.
+ */
+#if defined(SHKWON_ENABLE_TRACING)
+#define SHKWON_TRACE_CONCAT_IMPL(a, b) a##b
+#define SHKWON_TRACE_CONCAT(a, b) SHKWON_TRACE_CONCAT_IMPL(a, b)
+#define SHKWON_TRACE_SCOPE(name) ::shkwon::TraceScope SHKWON_TRACE_CONCAT(shkwon_trace_scope_, __LINE__)(name)
+#define SHKWON_TRACE_INSTANT(name) ::shkwon::Tracer::Get().Instant(name)
+#else
+#define SHKWON_TRACE_SCOPE(name) static_cast<void>(0)
+#define SHKWON_TRACE_INSTANT(name) static_cast<void>(0)
+#endif
+
+namespace shkwon
+{
+/**
+ * Records timestamped events from any thread and writes them out as a Chrome trace, which chrome://tracing and the
+ * Perfetto UI both open.
+ *
+ * Every thread writes into a ring buffer of its own, with one release store per event and no lock, so recording costs a
+ * clock read and a few stores. A full ring drops the event rather than wait. A background thread drains the rings
+ * periodically and writes the JSON, so the file is never written on the recording threads. Event names are not copied,
+ * so they must be string literals.
+ *
+ * Slices nest per thread. A flow links a slice on one thread to a later one on another, such as a job from the slice
+ * that queued it to the slice that ran it: BeginFlow() inside the first returns the ID to pass to EndFlow() inside the
+ * second.
+ *
+ * @code
+ * Tracer::Get().Start("trace.json");
+ * ...
+ * Tracer::Get().Stop();
+ * @endcode
+ */
+class Tracer
+{
+public:
+    /**
+     * The events a thread can hold before the background thread drains them.
+     */
+    static constexpr size_t kDefaultBufferEvents = size_t(1) << 14;
+
+    static Tracer &Get()
+    {
+        static Tracer tracer;
+        return tracer;
+    }
+
+    Tracer(const Tracer &) = delete;
+    Tracer &operator=(const Tracer &) = delete;
+
+    ~Tracer()
+    {
+        this->Stop();
+    }
+
+    /**
+     * Starts recording into a new trace file. Does nothing if already recording.
+     *
+     * @param path The file to write the trace to.
+     * @param flush_interval The time between two drains of the rings.
+     * @param buffer_events The size of the ring of every thread that starts recording from now on, rounded up to a
+     *                      power of two.
+     * @return false if the file cannot be opened.
+     */
+    bool Start(const std::string &path, std::chrono::nanoseconds flush_interval = std::chrono::milliseconds(100),
+               size_t buffer_events = kDefaultBufferEvents)
+    {
+        std::lock_guard<std::mutex> control(control_mutex_);
+        if (recording_.load(std::memory_order_relaxed))
+        {
+            return true;
+        }
+
+        auto *file = std::fopen(path.c_str(), "w");
+        if (file == nullptr)
+        {
+            return false;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            file_ = file;
+            first_event_ = true;
+            ++session_;
+            origin_ = ProfileClock::Now();
+            ns_per_tick_ = ProfileClock::GetNanosecondsPerTick();
+            buffer_events_ = RoundUpToPowerOfTwo(buffer_events);
+            stop_flag_ = false;
+            std::fputs("{\"traceEvents\":[\n", file_);
+        }
+        recording_.store(true, std::memory_order_release);
+        flusher_ = std::thread([this, flush_interval]() { this->Flush(flush_interval); });
+        return true;
+    }
+
+    /**
+     * Stops recording, writes out every event recorded so far and closes the file.
+     */
+    void Stop()
+    {
+        std::lock_guard<std::mutex> control(control_mutex_);
+        if (!recording_.exchange(false))
+        {
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_flag_ = true;
+        }
+        cv_.notify_all();
+        flusher_.join();
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        this->Drain();
+        std::fputs("\n]}\n", file_);
+        std::fclose(file_);
+        file_ = nullptr;
+    }
+
+    bool IsRecording() const noexcept
+    {
+        return recording_.load(std::memory_order_relaxed);
+    }
+
+    void Begin(const char *name)
+    {
+        this->Record('B', name, 0);
+    }
+
+    void End(const char *name)
+    {
+        this->Record('E', name, 0);
+    }
+
+    void Instant(const char *name)
+    {
+        this->Record('i', name, 0);
+    }
+
+    /**
+     * Starts a flow from the current slice of the calling thread.
+     *
+     * @return The ID of the flow, or 0 if not recording.
+     */
+    uint64_t BeginFlow(const char *name)
+    {
+        if (!IsRecording())
+        {
+            return 0;
+        }
+        auto &ring = GetThreadRing();
+        // Unique without a shared counter: the thread in the high bits, a count of its own flows in the low ones.
+        auto id = (static_cast<uint64_t>(ring.tid) << 40) | (++ring.flows & ((uint64_t(1) << 40) - 1));
+        ring.Push(TraceEvent{ ProfileClock::Now(), name, id, 's' });
+        return id;
+    }
+
+    /**
+     * Ends a flow at the current slice of the calling thread.
+     *
+     * @param id The ID returned by BeginFlow(). 0 does nothing.
+     */
+    void EndFlow(const char *name, uint64_t id)
+    {
+        if (id != 0)
+        {
+            this->Record('f', name, id);
+        }
+    }
+
+    /**
+     * Names the calling thread in the trace. The name is kept aside until the thread records its first event, so naming
+     * a thread that never records costs no ring.
+     */
+    void SetThreadName(const std::string &name)
+    {
+        auto &holder = GetThreadHolder();
+        holder.name = name;
+        if (holder.ring)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            holder.ring->name = name;
+            holder.ring->named_session = 0;
+        }
+    }
+
+    /**
+     * @return The number of events dropped so far because a ring was full.
+     */
+    uint64_t GetNumDropped()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto dropped = retired_dropped_;
+        for (auto &ring : rings_)
+        {
+            dropped += ring->dropped.load(std::memory_order_relaxed);
+        }
+        return dropped;
+    }
+
+private:
+    struct TraceEvent
+    {
+        uint64_t ticks;
+        const char *name;
+        uint64_t id;
+        char phase;
+    };
+
+    // Written by its own thread only and read by the flusher: a single producer, single consumer ring.
+    struct TraceRing
+    {
+        TraceRing(size_t size, uint32_t thread_id)
+            : events(new TraceEvent[size])
+            , mask(size - 1)
+            , head(0)
+            , tail(0)
+            , cached_tail(0)
+            , dropped(0)
+            , exited(false)
+            , tid(thread_id)
+            , flows(0)
+            , named_session(0)
+        {
+        }
+
+        void Push(const TraceEvent &event) noexcept
+        {
+            auto position = head.load(std::memory_order_relaxed);
+            if (position - cached_tail > mask)
+            {
+                cached_tail = tail.load(std::memory_order_acquire);
+                if (position - cached_tail > mask)
+                {
+                    dropped.store(dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                    return;
+                }
+            }
+            events[position & mask] = event;
+            head.store(position + 1, std::memory_order_release);
+        }
+
+        std::unique_ptr<TraceEvent[]> events;
+        size_t mask;
+        std::atomic<uint64_t> head;
+        std::atomic<uint64_t> tail;
+        // The owner's last look at tail, so that it only reads the flusher's cache line when the ring seems full.
+        uint64_t cached_tail;
+        std::atomic<uint64_t> dropped;
+        std::atomic<bool> exited;
+        uint32_t tid;
+        uint64_t flows;
+        // Guarded by mutex_. The name is written once per session, before the first events of the thread.
+        std::string name;
+        uint64_t named_session;
+    };
+
+    // The ring of a thread, registered on its first event, and the name of the thread until then. Gives the ring back
+    // when the thread exits.
+    struct RingHolder
+    {
+        ~RingHolder()
+        {
+            if (ring)
+            {
+                Tracer::Get().RetireRing(ring);
+            }
+        }
+
+        std::shared_ptr<TraceRing> ring;
+        std::string name;
+    };
+
+    Tracer()
+        : recording_(false)
+        , file_(nullptr)
+        , first_event_(true)
+        , session_(0)
+        , origin_(0)
+        , ns_per_tick_(1.0)
+        , buffer_events_(kDefaultBufferEvents)
+        , next_tid_(1)
+        , retired_dropped_(0)
+        , stop_flag_(false)
+    {
+        ProfileClock::Calibrate();
+    }
+
+    static size_t RoundUpToPowerOfTwo(size_t value)
+    {
+        size_t power = 1;
+        while (power < value)
+        {
+            power <<= 1;
+        }
+        return power;
+    }
+
+    static RingHolder &GetThreadHolder()
+    {
+        static thread_local RingHolder holder;
+        return holder;
+    }
+
+    TraceRing &GetThreadRing()
+    {
+        auto &holder = GetThreadHolder();
+        if (!holder.ring)
+        {
+            holder.ring = this->AddRing(holder.name);
+        }
+        return *holder.ring;
+    }
+
+    void Record(char phase, const char *name, uint64_t id)
+    {
+        if (!IsRecording())
+        {
+            return;
+        }
+        GetThreadRing().Push(TraceEvent{ ProfileClock::Now(), name, id, phase });
+    }
+
+    std::shared_ptr<TraceRing> AddRing(const std::string &name)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto ring = std::make_shared<TraceRing>(buffer_events_, next_tid_++);
+        ring->name = name;
+        rings_.push_back(ring);
+        return ring;
+    }
+
+    // Called by the thread of the ring as it exits. During a session the flusher still has to write out its events, so
+    // the ring is only marked and dropped by the next drain; otherwise there is nothing left to write and it goes now.
+    void RetireRing(const std::shared_ptr<TraceRing> &ring)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (file_ != nullptr)
+        {
+            ring->exited.store(true, std::memory_order_release);
+            return;
+        }
+
+        retired_dropped_ += ring->dropped.load(std::memory_order_relaxed);
+        rings_.erase(std::find(rings_.begin(), rings_.end(), ring));
+    }
+
+    void Flush(std::chrono::nanoseconds interval)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!cv_.wait_for(lock, interval, [this]() { return stop_flag_; }))
+        {
+            this->Drain();
+        }
+    }
+
+    // Writes out every event in the rings and drops the rings of threads that have exited. The caller holds mutex_.
+    void Drain()
+    {
+        for (auto it = rings_.begin(); it != rings_.end();)
+        {
+            auto &ring = **it;
+            // Read before the events, so that a ring found exited has no events left behind the ones drained here.
+            bool exited = ring.exited.load(std::memory_order_acquire);
+            if (!ring.name.empty() && ring.named_session != session_)
+            {
+                this->WriteThreadName(ring);
+                ring.named_session = session_;
+            }
+
+            auto head = ring.head.load(std::memory_order_acquire);
+            auto tail = ring.tail.load(std::memory_order_relaxed);
+            for (; tail != head; ++tail)
+            {
+                this->WriteEvent(ring.events[tail & ring.mask], ring.tid);
+            }
+            ring.tail.store(tail, std::memory_order_release);
+
+            if (exited)
+            {
+                retired_dropped_ += ring.dropped.load(std::memory_order_relaxed);
+                it = rings_.erase(it);
+                continue;
+            }
+            ++it;
+        }
+        std::fflush(file_);
+    }
+
+    void WriteSeparator()
+    {
+        if (!first_event_)
+        {
+            std::fputs(",\n", file_);
+        }
+        first_event_ = false;
+    }
+
+    void WriteEvent(const TraceEvent &event, uint32_t tid)
+    {
+        // Left over from before this session.
+        if (event.ticks < origin_)
+        {
+            return;
+        }
+
+        this->WriteSeparator();
+        auto us = static_cast<double>(event.ticks - origin_) * ns_per_tick_ / 1000.0;
+        std::fprintf(file_, "{\"name\":\"%s\",\"cat\":\"shkwon\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%u", event.name,
+                     event.phase, us, tid);
+        switch (event.phase)
+        {
+        case 's':
+            std::fprintf(file_, ",\"id\":%llu", static_cast<unsigned long long>(event.id));
+            break;
+        case 'f':
+            // Binds to the slice the event is in, rather than the next one to begin.
+            std::fprintf(file_, ",\"id\":%llu,\"bp\":\"e\"", static_cast<unsigned long long>(event.id));
+            break;
+        case 'i':
+            std::fputs(",\"s\":\"t\"", file_);
+            break;
+        default:
+            break;
+        }
+        std::fputc('}', file_);
+    }
+
+    void WriteThreadName(const TraceRing &ring)
+    {
+        this->WriteSeparator();
+        std::fprintf(file_, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"", ring.tid);
+        for (auto c : ring.name)
+        {
+            if (c == '"' || c == '\\')
+            {
+                std::fputc('\\', file_);
+            }
+            std::fputc(c, file_);
+        }
+        std::fputs("\"}}", file_);
+    }
+
+    std::atomic<bool> recording_;
+    // Serialises Start() and Stop().
+    std::mutex control_mutex_;
+
+    // Everything below is guarded by mutex_.
+    std::mutex mutex_;
+    FILE *file_;
+    bool first_event_;
+    uint64_t session_;
+    uint64_t origin_;
+    double ns_per_tick_;
+    size_t buffer_events_;
+    uint32_t next_tid_;
+    std::vector<std::shared_ptr<TraceRing>> rings_;
+    uint64_t retired_dropped_;
+    bool stop_flag_;
+    std::condition_variable cv_;
+    std::thread flusher_;
+};
+
+/**
+ * Records a slice for its own lifetime, if the tracer was recording when it began.
+ */
+class TraceScope
+{
+public:
+    explicit TraceScope(const char *name)
+        : name_(Tracer::Get().IsRecording() ? name : nullptr)
+    {
+        if (name_ != nullptr)
+        {
+            Tracer::Get().Begin(name_);
+        }
+    }
+
+    TraceScope(const TraceScope &) = delete;
+    TraceScope &operator=(const TraceScope &) = delete;
+
+    ~TraceScope()
+    {
+        if (name_ != nullptr)
+        {
+            Tracer::Get().End(name_);
+        }
+    }
+
+private:
+    const char *name_;
+};
+} // namespace shkwon
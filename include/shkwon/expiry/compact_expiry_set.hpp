@@ -0,0 +1,491 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "shkwon/expiry/expiry_reaper.hpp"
+
+namespace shkwon
+{
+/**
+ * What a full CompactExpirySet drops to make room for a new value.
+ */
+enum class ExpiryEviction
+{
+    // The value that expires first.
+    SoonestExpiry,
+    // The value that was inserted or looked up longest ago.
+    LeastRecentlyUsed,
+};
+
+/**
+ * An expiry set with a fixed cost per value and an optional capacity, for caches of millions of short values.
+ *
+ * The values lie side by side in one array, each with two 32-bit times in ticks of the resolution: when it expires and
+ * when it was last used. A flat open-addressing table of 32-bit indices finds them, with linear probing and no
+ * tombstones. Nothing else is allocated per value, so a 64-bit value costs 16 bytes in the array plus 6 to 12 bytes of
+ * table, where an ExpirySet spends well over a hundred bytes.
+ *
+ * Without time wheels, expired values are found lazily: a lookup checks the time of the value it finds, a full set
+ * evicts expired values first, and Reap() sweeps the array a bounded number of values at a time. A full set picks what
+ * to evict among a few values sampled at random, so the eviction order is close to the policy rather than exact.
+ *
+ * The times wrap around every 2^32 ticks, about 49 days at the default resolution, so the time to live is limited to
+ * 2^31 ticks, and a set that holds values longer than that should be swept at least that often, for instance by an
+ * ExpiryReaper. All calls are thread safe and serialised by one mutex.
+ *
+ * @code
+ * CompactExpirySet<uint64_t> seen(4000000, ExpiryEviction::LeastRecentlyUsed);
+ * if (!seen.Insert(flow_id, std::chrono::minutes(5))) { // seen before }
+ * @endcode
+ */
+template <class T, class Hash = std::hash<T>, class KeyEqual = std::equal_to<T>>
+class CompactExpirySet
+{
+public:
+    /**
+     * @param capacity The most values the set holds, after which inserting a new value evicts one. 0 means no limit;
+     *                 the set then grows as needed.
+     * @param eviction What a full set evicts.
+     * @param resolution The length of a tick, at least 1ns. A value lives at least its time to live and at most one tick
+     *                   longer.
+     * @param reaper An optional reaper to register with, which must outlive the set.
+     */
+    explicit CompactExpirySet(size_t capacity = 0, ExpiryEviction eviction = ExpiryEviction::SoonestExpiry,
+                              std::chrono::nanoseconds resolution = std::chrono::milliseconds(1),
+                              ExpiryReaper *reaper = nullptr)
+        : capacity_(capacity)
+        , eviction_(eviction)
+        , unit_(resolution)
+        , epoch_(std::chrono::steady_clock::now())
+        , index_mask_(0)
+        , index_shift_(0)
+        , sweep_cursor_(0)
+        , random_(0x9E3779B97F4A7C15ull)
+        , num_evicted_(0)
+        , reaper_(reaper)
+        , reaper_id_(0)
+    {
+        if (resolution.count() < 1)
+        {
+            throw std::invalid_argument("Expiry resolution must be at least 1ns.");
+        }
+        if (capacity >= kMaxCapacity)
+        {
+            throw std::invalid_argument("Expiry set capacity must be below 2^31.");
+        }
+
+        entries_.reserve(capacity);
+        this->ResizeIndex(capacity != 0 ? capacity : kInitialIndexSize / 2);
+
+        if (reaper_ != nullptr)
+        {
+            reaper_id_ = reaper_->Register([this]() { this->Reap(); });
+        }
+    }
+
+    CompactExpirySet(const CompactExpirySet &) = delete;
+    CompactExpirySet &operator=(const CompactExpirySet &) = delete;
+
+    ~CompactExpirySet()
+    {
+        if (reaper_ != nullptr)
+        {
+            reaper_->Unregister(reaper_id_);
+        }
+    }
+
+    /**
+     * Inserts a value, or gives the same value a new time to live. A full set evicts a value first.
+     *
+     * @param value The value to insert.
+     * @param ttl How long the value lives from now, at most 2^31 - 1 ticks. Zero or less expires it right away.
+     * @return true if the value was not in the set.
+     */
+    bool Insert(const T &value, std::chrono::nanoseconds ttl)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto now = GetTime();
+        if (ttl.count() <= 0)
+        {
+            return !this->EraseIfPresent(value, now);
+        }
+        auto expiry = GetExpiryAfter(ttl);
+
+        auto hash = hash_(value);
+        auto pos = this->FindSlot(value, hash);
+        if (pos != kNotFound)
+        {
+            auto &entry = entries_[index_[pos] - 1];
+            bool inserted = IsExpired(entry, now);
+            entry.expiry = expiry;
+            entry.last_used = now;
+            return inserted;
+        }
+
+        if (capacity_ != 0 && entries_.size() >= capacity_)
+        {
+            this->Evict(now);
+        }
+        else if (capacity_ == 0 && (entries_.size() + 1) * kMaxLoadDenominator > index_.size() * kMaxLoadNumerator)
+        {
+            this->ResizeIndex(entries_.size() * 2);
+        }
+
+        entries_.push_back(Entry{ value, expiry, now });
+        index_[this->FindEmptySlot(hash)] = static_cast<uint32_t>(entries_.size());
+        return true;
+    }
+
+    /**
+     * Checks for a value that has not expired. Counts as a use for ExpiryEviction::LeastRecentlyUsed.
+     */
+    bool Contains(const T &value)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto now = GetTime();
+        auto pos = this->FindSlot(value, hash_(value));
+        if (pos == kNotFound)
+        {
+            return false;
+        }
+
+        auto &entry = entries_[index_[pos] - 1];
+        if (IsExpired(entry, now))
+        {
+            this->EraseAt(pos);
+            return false;
+        }
+        if (eviction_ == ExpiryEviction::LeastRecentlyUsed)
+        {
+            entry.last_used = now;
+        }
+        return true;
+    }
+
+    /**
+     * @return true if the value was in the set.
+     */
+    bool Remove(const T &value)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto now = GetTime();
+        return this->EraseIfPresent(value, now);
+    }
+
+    /**
+     * Gives a value a new time to live, counted from now.
+     *
+     * @return false if the value is not in the set.
+     */
+    bool Refresh(const T &value, std::chrono::nanoseconds ttl)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto now = GetTime();
+        auto pos = this->FindSlot(value, hash_(value));
+        if (pos == kNotFound)
+        {
+            return false;
+        }
+
+        auto &entry = entries_[index_[pos] - 1];
+        bool expired = IsExpired(entry, now);
+        if (expired || ttl.count() <= 0)
+        {
+            this->EraseAt(pos);
+            return !expired;
+        }
+        entry.expiry = GetExpiryAfter(ttl);
+        entry.last_used = now;
+        return true;
+    }
+
+    /**
+     * Drops expired values, sweeping the array from where the last sweep stopped.
+     *
+     * @param max_scan The number of values to look at, so that the mutex is not held for long. The default sweeps the
+     *                 whole set.
+     * @return The number of values dropped.
+     */
+    size_t Reap(size_t max_scan = SIZE_MAX)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto now = GetTime();
+        size_t dropped = 0;
+        for (size_t scanned = std::min(max_scan, entries_.size()); scanned > 0 && !entries_.empty(); --scanned)
+        {
+            if (sweep_cursor_ >= entries_.size())
+            {
+                sweep_cursor_ = 0;
+            }
+            if (IsExpired(entries_[sweep_cursor_], now))
+            {
+                // The last value moves into the hole, so the cursor stays to look at it next.
+                this->EraseAt(this->FindRef(sweep_cursor_));
+                ++dropped;
+                continue;
+            }
+            ++sweep_cursor_;
+        }
+        return dropped;
+    }
+
+    void Clear()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        entries_.clear();
+        std::fill(index_.begin(), index_.end(), 0);
+        sweep_cursor_ = 0;
+    }
+
+    /**
+     * Counts the values that have not expired, which takes a pass over all of them.
+     */
+    size_t GetSize()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto now = GetTime();
+        size_t size = 0;
+        for (auto &entry : entries_)
+        {
+            size += IsExpired(entry, now) ? 0 : 1;
+        }
+        return size;
+    }
+
+    size_t GetCapacity() const noexcept
+    {
+        return capacity_;
+    }
+
+    /**
+     * @return How many values that had not expired yet were evicted to make room.
+     */
+    uint64_t GetNumEvicted()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return num_evicted_;
+    }
+
+private:
+    struct Entry
+    {
+        T value;
+        // Both in ticks since epoch_, wrapping around.
+        uint32_t expiry;
+        uint32_t last_used;
+    };
+
+    static constexpr size_t kNotFound = SIZE_MAX;
+    static constexpr size_t kMaxCapacity = size_t(1) << 31;
+    static constexpr size_t kInitialIndexSize = 16;
+    // The table is kept at most 7/10 full, which keeps the probes short.
+    static constexpr size_t kMaxLoadNumerator = 7;
+    static constexpr size_t kMaxLoadDenominator = 10;
+    static constexpr int kEvictionSamples = 8;
+    static constexpr int64_t kMaxTicks = INT32_MAX;
+
+    uint32_t GetTime() const
+    {
+        auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch_);
+        return static_cast<uint32_t>(static_cast<uint64_t>(elapsed.count() / unit_.count()));
+    }
+
+    // The current time plus `ttl`, rounded up to a tick once, so that no value expires early and none outlives its time
+    // to live by a tick or more. Rounding the time and the time to live up separately could add almost two.
+    uint32_t GetExpiryAfter(std::chrono::nanoseconds ttl) const
+    {
+        auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch_);
+        int64_t expiry;
+        if (ttl.count() / unit_.count() >= kMaxTicks)
+        {
+            expiry = elapsed.count() / unit_.count() + kMaxTicks;
+        }
+        else
+        {
+            expiry = (elapsed.count() + ttl.count() + unit_.count() - 1) / unit_.count();
+        }
+        return static_cast<uint32_t>(static_cast<uint64_t>(expiry));
+    }
+
+    // Compares the times as the distance between them, which stays right across a wrap around.
+    static bool IsExpired(const Entry &entry, uint32_t now)
+    {
+        return static_cast<int32_t>(entry.expiry - now) <= 0;
+    }
+
+    // The home slot takes the high bits of a multiplicative hash, which spreads even sequential keys.
+    size_t GetHome(size_t hash) const
+    {
+        return static_cast<size_t>((static_cast<uint64_t>(hash) * 0x9E3779B97F4A7C15ull) >> index_shift_);
+    }
+
+    // Returns the slot of the table that refers to the value, or kNotFound.
+    size_t FindSlot(const T &value, size_t hash) const
+    {
+        for (auto pos = GetHome(hash);; pos = (pos + 1) & index_mask_)
+        {
+            auto ref = index_[pos];
+            if (ref == 0)
+            {
+                return kNotFound;
+            }
+            if (equal_(entries_[ref - 1].value, value))
+            {
+                return pos;
+            }
+        }
+    }
+
+    size_t FindEmptySlot(size_t hash) const
+    {
+        auto pos = GetHome(hash);
+        while (index_[pos] != 0)
+        {
+            pos = (pos + 1) & index_mask_;
+        }
+        return pos;
+    }
+
+    // Returns the slot of the table that refers to the value at `dense` in the array.
+    size_t FindRef(size_t dense) const
+    {
+        auto ref = static_cast<uint32_t>(dense + 1);
+        auto pos = GetHome(hash_(entries_[dense].value));
+        while (index_[pos] != ref)
+        {
+            pos = (pos + 1) & index_mask_;
+        }
+        return pos;
+    }
+
+    // Returns whether the value was there and had not expired.
+    bool EraseIfPresent(const T &value, uint32_t now)
+    {
+        auto pos = this->FindSlot(value, hash_(value));
+        if (pos == kNotFound)
+        {
+            return false;
+        }
+        bool expired = IsExpired(entries_[index_[pos] - 1], now);
+        this->EraseAt(pos);
+        return !expired;
+    }
+
+    // Removes the value the slot refers to. The values behind it in the table shift back into the hole, so lookups
+    // never need tombstones, and the last value of the array moves into its place there.
+    void EraseAt(size_t pos)
+    {
+        auto dense = static_cast<size_t>(index_[pos] - 1);
+        auto hole = pos;
+        for (auto next = (hole + 1) & index_mask_; index_[next] != 0; next = (next + 1) & index_mask_)
+        {
+            auto home = GetHome(hash_(entries_[index_[next] - 1].value));
+            // The value may move back unless its home lies after the hole, up to where it is now.
+            if (((next - home) & index_mask_) >= ((next - hole) & index_mask_))
+            {
+                index_[hole] = index_[next];
+                hole = next;
+            }
+        }
+        index_[hole] = 0;
+
+        auto last = entries_.size() - 1;
+        if (dense != last)
+        {
+            index_[this->FindRef(last)] = static_cast<uint32_t>(dense + 1);
+            entries_[dense] = std::move(entries_[last]);
+        }
+        entries_.pop_back();
+    }
+
+    // Drops one value of a full set: an expired one if the samples find any, otherwise the one the policy picks.
+    void Evict(uint32_t now)
+    {
+        size_t victim = 0;
+        int64_t worst = INT64_MIN;
+        for (int i = 0; i < kEvictionSamples; ++i)
+        {
+            auto dense = static_cast<size_t>(this->NextRandom() % entries_.size());
+            auto &entry = entries_[dense];
+            if (IsExpired(entry, now))
+            {
+                victim = dense;
+                worst = INT64_MAX;
+                break;
+            }
+
+            // Higher is worse: the sooner the expiry, or the longer ago the last use.
+            auto score = eviction_ == ExpiryEviction::SoonestExpiry ? -static_cast<int64_t>(entry.expiry - now)
+                                                                     : static_cast<int64_t>(now - entry.last_used);
+            if (score > worst)
+            {
+                victim = dense;
+                worst = score;
+            }
+        }
+
+        if (worst != INT64_MAX)
+        {
+            ++num_evicted_;
+        }
+        this->EraseAt(this->FindRef(victim));
+    }
+
+    uint64_t NextRandom()
+    {
+        // xorshift64, plenty for picking samples.
+        random_ ^= random_ << 13;
+        random_ ^= random_ >> 7;
+        random_ ^= random_ << 17;
+        return random_;
+    }
+
+    // Makes the table big enough for `num_values` values and places every value again.
+    void ResizeIndex(size_t num_values)
+    {
+        size_t size = kInitialIndexSize;
+        int bits = 4;
+        while (size * kMaxLoadNumerator < num_values * kMaxLoadDenominator)
+        {
+            size <<= 1;
+            ++bits;
+        }
+
+        index_.assign(size, 0);
+        index_mask_ = size - 1;
+        index_shift_ = 64 - bits;
+        for (size_t dense = 0; dense < entries_.size(); ++dense)
+        {
+            index_[this->FindEmptySlot(hash_(entries_[dense].value))] = static_cast<uint32_t>(dense + 1);
+        }
+    }
+
+    size_t capacity_;
+    ExpiryEviction eviction_;
+    std::chrono::nanoseconds unit_;
+    std::chrono::steady_clock::time_point epoch_;
+
+    std::vector<Entry> entries_;
+    // 1 + the position of a value in entries_, or 0 for an empty slot.
+    std::vector<uint32_t> index_;
+    size_t index_mask_;
+    int index_shift_;
+    size_t sweep_cursor_;
+    uint64_t random_;
+    uint64_t num_evicted_;
+    Hash hash_;
+    KeyEqual equal_;
+    std::mutex mutex_;
+
+    ExpiryReaper *reaper_;
+    uint64_t reaper_id_;
+};
+} // namespace shkwon
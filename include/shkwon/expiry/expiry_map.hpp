@@ -0,0 +1,390 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "shkwon/expiry/expiry_reaper.hpp"
+#include "shkwon/time_wheel_scheduler/time_wheel.hpp"
+
+namespace shkwon
+{
+/**
+ * A hash map whose entries expire once their time to live has passed since they were inserted or last refreshed.
+ *
+ * Every key is indexed in a hash table, so finding, removing and refreshing an entry take O(1) however many entries
+ * there are. The entries double as the timers of a hierarchy of time wheels, the same machinery a TimeWheelScheduler
+ * orders its timers with: refreshing or removing an entry unlinks it from its slot in O(1), and the expired entries
+ * are dropped a whole slot at a time as the wheels move on.
+ *
+ * The map has no thread of its own. Every call moves the wheels on and drops a bounded number of expired entries, and
+ * lookups check the expiration time of what they find, so an expired entry is never seen and no call stalls the others
+ * for long. A map that may sit idle holding many expired entries can have an ExpiryReaper drop them in the background.
+ * All calls are thread safe and serialised by one mutex.
+ *
+ * @code
+ * ExpiryMap<uint64_t, Peer> peers;
+ * peers.Insert(id, peer, std::chrono::seconds(30));
+ * Peer peer;
+ * if (peers.Find(id, peer)) { ... }
+ * @endcode
+ */
+template <class K, class V, class Hash = std::hash<K>, class KeyEqual = std::equal_to<K>>
+class ExpiryMap
+{
+public:
+    /**
+     * @param resolution The granularity of expiry, at least 1ns. An entry lives at least its time to live and at most
+     *                   one resolution longer.
+     * @param horizon The longest time to live the wheels cover in one go. Entries that live longer are placed at the
+     *                horizon and placed again once they get there, so they still expire on time.
+     * @param reaper An optional reaper to register with, which must outlive the map.
+     */
+    explicit ExpiryMap(std::chrono::nanoseconds resolution = std::chrono::milliseconds(1),
+                       std::chrono::nanoseconds horizon = std::chrono::hours(1), ExpiryReaper *reaper = nullptr)
+        : unit_(resolution)
+        , horizon_(0)
+        , wheel_time_(0)
+        , reaper_(reaper)
+        , reaper_id_(0)
+    {
+        if (resolution.count() < 1 || horizon < resolution)
+        {
+            throw std::invalid_argument("Expiry resolution must be at least 1ns and no longer than the horizon.");
+        }
+        horizon_ = (horizon.count() + resolution.count() - 1) / resolution.count();
+        timewheels_ = MakeTimeWheelHierarchy(static_cast<uint64_t>(horizon_));
+        wheel_time_ = GetTime();
+
+        if (reaper_ != nullptr)
+        {
+            reaper_id_ = reaper_->Register([this]() { this->Reap(); });
+        }
+    }
+
+    ExpiryMap(const ExpiryMap &) = delete;
+    ExpiryMap &operator=(const ExpiryMap &) = delete;
+
+    ~ExpiryMap()
+    {
+        if (reaper_ != nullptr)
+        {
+            reaper_->Unregister(reaper_id_);
+        }
+    }
+
+    /**
+     * Inserts an entry, or replaces the value and the time to live of the entry with the same key.
+     *
+     * @param key The key of the entry.
+     * @param value The value of the entry.
+     * @param ttl How long the entry lives from now. Zero or less expires it right away.
+     * @return true if the key was not in the map.
+     */
+    bool Insert(const K &key, V value, std::chrono::nanoseconds ttl)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto now = this->Step();
+        return this->Emplace(key, std::move(value), GetExpiryAfter(ttl), now);
+    }
+
+    /**
+     * Inserts an entry, or replaces the value and the expiration time of the entry with the same key.
+     *
+     * @param key The key of the entry.
+     * @param value The value of the entry.
+     * @param expiration When the entry expires, on the steady clock.
+     * @return true if the key was not in the map.
+     */
+    bool InsertAt(const K &key, V value, std::chrono::steady_clock::time_point expiration)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto now = this->Step();
+        return this->Emplace(key, std::move(value), FromSteadyTime(expiration), now);
+    }
+
+    /**
+     * Copies out the value of an entry that has not expired.
+     *
+     * @param key The key to look up.
+     * @param value Receives the value. Left alone if the key is not in the map.
+     * @return true if the key is in the map.
+     */
+    bool Find(const K &key, V &value)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto now = this->Step();
+        auto it = this->FindLive(key, now);
+        if (it == entries_.end())
+        {
+            return false;
+        }
+        value = it->second.value;
+        return true;
+    }
+
+    bool Contains(const K &key)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto now = this->Step();
+        return this->FindLive(key, now) != entries_.end();
+    }
+
+    /**
+     * @return true if the key was in the map.
+     */
+    bool Remove(const K &key)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto now = this->Step();
+        auto it = this->FindLive(key, now);
+        if (it == entries_.end())
+        {
+            return false;
+        }
+        this->Erase(it);
+        return true;
+    }
+
+    /**
+     * Gives an entry a new time to live, counted from now.
+     *
+     * @param key The key of the entry.
+     * @param ttl How long the entry lives from now. Zero or less expires it right away.
+     * @return false if the key is not in the map.
+     */
+    bool Refresh(const K &key, std::chrono::nanoseconds ttl)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto now = this->Step();
+        auto it = this->FindLive(key, now);
+        if (it == entries_.end())
+        {
+            return false;
+        }
+        this->Schedule(it, GetExpiryAfter(ttl), now);
+        return true;
+    }
+
+    /**
+     * Drops the expired entries, a slot of the wheels at a time. The other calls do that too, a few slots per call, so
+     * this is only needed to give back memory early.
+     *
+     * @param max_entries Stops after the slot that brings the number of entries dropped to this many, so that the
+     *                    mutex is not held for long. Call again while it returns this many or more.
+     * @return The number of entries dropped.
+     */
+    size_t Reap(size_t max_entries = SIZE_MAX)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return this->AdvanceTo(GetTime(), max_entries);
+    }
+
+    void Clear()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto &entry : entries_)
+        {
+            TimerList::Unlink(&entry.second);
+        }
+        entries_.clear();
+    }
+
+    /**
+     * Drops every expired entry and counts the others.
+     *
+     * @return The number of entries that have not expired.
+     */
+    size_t GetSize()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        this->AdvanceTo(GetTime(), SIZE_MAX);
+        return entries_.size();
+    }
+
+    std::chrono::nanoseconds GetResolution() const
+    {
+        return unit_;
+    }
+
+private:
+    // How many expired entries a call other than Reap() drops at most, give or take a slot, before it gets on with its
+    // own work. Lookups check the expiration time themselves, so whatever is left is never seen.
+    static constexpr size_t kMaxDropsPerCall = 64;
+
+    // An entry is the timer of its own expiry. It stays where the hash map put it until it is erased, so the wheels
+    // can link it and the key it points to stays valid. The wheels need nothing but the links and the time it is placed
+    // at, so it is a bare TimerNode rather than a TimeoutJob with a task it would never run.
+    struct Entry : TimerNode
+    {
+        explicit Entry(V &&initial)
+            : value(std::move(initial))
+            , expiry(0)
+            , key(nullptr)
+        {
+        }
+
+        V value;
+        // When the entry expires, in ticks. Its timer may be placed earlier, at the horizon.
+        int64_t expiry;
+        const K *key;
+    };
+
+    using Iterator = typename std::unordered_map<K, Entry, Hash, KeyEqual>::iterator;
+
+    // The steady clock in ticks of the resolution, rounded down; the wheels run on it.
+    int64_t GetTime() const
+    {
+        auto now = std::chrono::steady_clock::now().time_since_epoch();
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(now).count() / unit_.count();
+    }
+
+    // The current time plus `ttl`, rounded up to a tick once, so that no entry expires early and none outlives its time
+    // to live by a tick or more. Rounding the time and the time to live up separately could add almost two.
+    int64_t GetExpiryAfter(std::chrono::nanoseconds ttl) const
+    {
+        if (ttl.count() <= 0)
+        {
+            return 0;
+        }
+        auto now = std::chrono::steady_clock::now().time_since_epoch();
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(now).count() + ttl.count();
+        return (ns + unit_.count() - 1) / unit_.count();
+    }
+
+    int64_t FromSteadyTime(std::chrono::steady_clock::time_point time) const
+    {
+        auto since_epoch = std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+        return since_epoch > 0 ? (since_epoch + unit_.count() - 1) / unit_.count() : 0;
+    }
+
+    // Does the share of dropping expired entries every call does, and returns the current time.
+    int64_t Step()
+    {
+        auto now = GetTime();
+        this->AdvanceTo(now, kMaxDropsPerCall);
+        return now;
+    }
+
+    // Finds an entry that has not expired. One the wheels have not got to yet is dropped on the way.
+    Iterator FindLive(const K &key, int64_t now)
+    {
+        auto it = entries_.find(key);
+        if (it != entries_.end() && it->second.expiry <= now)
+        {
+            this->Erase(it);
+            return entries_.end();
+        }
+        return it;
+    }
+
+    void Erase(Iterator it)
+    {
+        TimerList::Unlink(&it->second);
+        entries_.erase(it);
+    }
+
+    bool Emplace(const K &key, V &&value, int64_t expiry, int64_t now)
+    {
+        auto it = this->FindLive(key, now);
+        bool inserted = it == entries_.end();
+        if (inserted)
+        {
+            it = entries_
+                     .emplace(std::piecewise_construct, std::forward_as_tuple(key),
+                              std::forward_as_tuple(std::move(value)))
+                     .first;
+            it->second.key = &it->first;
+        }
+        else
+        {
+            it->second.value = std::move(value);
+        }
+        this->Schedule(it, expiry, now);
+        return inserted;
+    }
+
+    // Links an entry into the slot of its expiry, or of the horizon if that is further away. An entry that is already
+    // due is dropped right away.
+    void Schedule(Iterator it, int64_t expiry, int64_t now)
+    {
+        if (expiry <= now)
+        {
+            this->Erase(it);
+            return;
+        }
+        TimerList::Unlink(&it->second);
+        this->Place(it->second, expiry);
+    }
+
+    // The wheels may lag behind the clock, so the horizon is counted from where they are.
+    void Place(Entry &entry, int64_t expiry)
+    {
+        entry.expiry = expiry;
+        entry.when = std::max<int64_t>(std::min(expiry, wheel_time_ + horizon_), 1);
+        timewheels_.front()->AddTimer(&entry, wheel_time_);
+    }
+
+    // Moves the wheels forward to `now`, dropping the entries of every slot on the way and jumping over empty ones. Stops
+    // early, behind `now`, after the slot that brings the number of entries dropped to `budget`.
+    size_t AdvanceTo(int64_t now, size_t budget)
+    {
+        size_t dropped = 0;
+        auto least_timewheel = timewheels_.back().get();
+        while (wheel_time_ < now && dropped < budget)
+        {
+            auto elapsed = static_cast<uint64_t>(now - wheel_time_);
+            auto ticks = least_timewheel->GetTicksToNextEvent();
+            if (ticks == TimeWheel::kNoEvent)
+            {
+                // Nothing is placed against the old position, so the wheels need not move at all.
+                wheel_time_ = now;
+                break;
+            }
+            if (ticks > elapsed)
+            {
+                wheel_time_ = now;
+                least_timewheel->Advance(elapsed, wheel_time_);
+                break;
+            }
+
+            wheel_time_ += static_cast<int64_t>(ticks);
+            least_timewheel->Advance(ticks, wheel_time_);
+            auto slot = least_timewheel->PopCurrentSlot();
+            while (!slot.Empty())
+            {
+                auto *entry = static_cast<Entry *>(slot.PopFront());
+                if (entry->expiry > wheel_time_)
+                {
+                    // Placed at the horizon; there is still some way to go.
+                    this->Place(*entry, entry->expiry);
+                    continue;
+                }
+                entries_.erase(entries_.find(*entry->key));
+                ++dropped;
+            }
+        }
+        return dropped;
+    }
+
+    std::chrono::nanoseconds unit_;
+    // The reach of the wheels, in ticks.
+    int64_t horizon_;
+    std::vector<TimeWheelPtr> timewheels_;
+    // The time of the current slot of the least level wheel, in ticks.
+    int64_t wheel_time_;
+    std::unordered_map<K, Entry, Hash, KeyEqual> entries_;
+    std::mutex mutex_;
+
+    ExpiryReaper *reaper_;
+    uint64_t reaper_id_;
+};
+} // namespace shkwon
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+namespace shkwon
+{
+/**
+ * One background thread that drops the expired entries of any number of expiry containers.
+ *
+ * The containers expire their entries lazily, on every call, so the reaper is only needed to give back the memory of
+ * a container that goes quiet while holding many expired entries. Every interval it sweeps each registered container
+ * once, one after the other. It must outlive the containers registered with it.
+ */
+class ExpiryReaper
+{
+public:
+    /**
+     * Starts the reaper thread.
+     *
+     * @param interval The time between two sweeps.
+     */
+    explicit ExpiryReaper(std::chrono::nanoseconds interval = std::chrono::seconds(1))
+        : interval_(interval)
+        , stop_flag_(false)
+        , next_id_(1)
+    {
+        if (interval.count() <= 0)
+        {
+            throw std::invalid_argument("Reaper interval must be positive.");
+        }
+        thread_ = std::thread([this]() { this->Run(); });
+    }
+
+    ExpiryReaper(const ExpiryReaper &) = delete;
+    ExpiryReaper &operator=(const ExpiryReaper &) = delete;
+
+    ~ExpiryReaper()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_flag_ = true;
+        }
+        cv_.notify_all();
+        thread_.join();
+    }
+
+    /**
+     * Adds a sweep to every round.
+     *
+     * @param reap Drops the expired entries of one container. Called on the reaper thread.
+     * @return The ID to unregister the sweep with.
+     */
+    uint64_t Register(std::function<void()> reap)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto id = next_id_++;
+        reapers_.emplace(id, std::move(reap));
+        return id;
+    }
+
+    /**
+     * Removes a sweep. Once this returns, the sweep is not running and never runs again.
+     *
+     * @param id The ID returned by Register().
+     */
+    void Unregister(uint64_t id)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        reapers_.erase(id);
+    }
+
+private:
+    // The sweeps run under mutex_, which is what makes Unregister() wait for a running one.
+    void Run()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!stop_flag_)
+        {
+            if (cv_.wait_for(lock, interval_, [this]() { return stop_flag_; }))
+            {
+                break;
+            }
+            for (auto &reaper : reapers_)
+            {
+                reaper.second();
+            }
+        }
+    }
+
+    std::chrono::nanoseconds interval_;
+    bool stop_flag_;
+    uint64_t next_id_;
+    std::map<uint64_t, std::function<void()>> reapers_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::thread thread_;
+};
+} // namespace shkwon
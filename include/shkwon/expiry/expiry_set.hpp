@@ -0,0 +1,115 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+#include "shkwon/expiry/expiry_map.hpp"
+
+namespace shkwon
+{
+/**
+ * A hash set whose values expire once their time to live has passed, for deduplicating keys seen within a window.
+ *
+ * An ExpiryMap without values: inserting, finding, removing and refreshing a value take O(1), and expired values are
+ * dropped lazily on every call or, optionally, by an ExpiryReaper. All calls are thread safe and serialised by one
+ * mutex; ShardedExpirySet spreads the values over several sets for many threads.
+ *
+ * @code
+ * ExpirySet<uint64_t> seen;
+ * if (!seen.Insert(packet.sequence, std::chrono::seconds(5))) { // duplicate }
+ * @endcode
+ */
+template <class T, class Hash = std::hash<T>, class KeyEqual = std::equal_to<T>>
+class ExpirySet
+{
+public:
+    /**
+     * @param resolution The granularity of expiry, at least 1ns. A value lives at least its time to live and at most
+     *                   one resolution longer.
+     * @param horizon The longest time to live the time wheels cover in one go. Longer ones work, but take more steps.
+     * @param reaper An optional reaper to register with, which must outlive the set.
+     */
+    explicit ExpirySet(std::chrono::nanoseconds resolution = std::chrono::milliseconds(1),
+                       std::chrono::nanoseconds horizon = std::chrono::hours(1), ExpiryReaper *reaper = nullptr)
+        : values_(resolution, horizon, reaper)
+    {
+    }
+
+    /**
+     * Inserts a value, or gives the same value a new time to live.
+     *
+     * @param value The value to insert.
+     * @param ttl How long the value lives from now.
+     * @return true if the value was not in the set.
+     */
+    bool Insert(const T &value, std::chrono::nanoseconds ttl)
+    {
+        return values_.Insert(value, Empty(), ttl);
+    }
+
+    /**
+     * Inserts a value, or gives the same value a new expiration time.
+     *
+     * @param value The value to insert.
+     * @param expiration When the value expires, on the steady clock.
+     * @return true if the value was not in the set.
+     */
+    bool InsertAt(const T &value, std::chrono::steady_clock::time_point expiration)
+    {
+        return values_.InsertAt(value, Empty(), expiration);
+    }
+
+    bool Contains(const T &value)
+    {
+        return values_.Contains(value);
+    }
+
+    /**
+     * @return true if the value was in the set.
+     */
+    bool Remove(const T &value)
+    {
+        return values_.Remove(value);
+    }
+
+    /**
+     * Gives a value a new time to live, counted from now.
+     *
+     * @return false if the value is not in the set.
+     */
+    bool Refresh(const T &value, std::chrono::nanoseconds ttl)
+    {
+        return values_.Refresh(value, ttl);
+    }
+
+    /**
+     * Drops the expired values, a slot of the time wheels at a time.
+     *
+     * @param max_values Stops after the slot that brings the number of values dropped to this many.
+     * @return The number of values dropped.
+     */
+    size_t Reap(size_t max_values = SIZE_MAX)
+    {
+        return values_.Reap(max_values);
+    }
+
+    void Clear()
+    {
+        values_.Clear();
+    }
+
+    size_t GetSize()
+    {
+        return values_.GetSize();
+    }
+
+private:
+    struct Empty
+    {
+    };
+
+    ExpiryMap<T, Empty, Hash, KeyEqual> values_;
+};
+} // namespace shkwon
@@ -0,0 +1,206 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "shkwon/expiry/expiry_set.hpp"
+
+namespace shkwon
+{
+/**
+ * An ExpirySet split into independent shards, for many threads that look values up at once.
+ *
+ * Every shard is an ExpirySet of its own, with its own mutex, hash table and time wheels, on cache lines of its own. A
+ * value always goes to the same shard, picked from its hash, so threads working on different values rarely wait for
+ * each other, and dropping the expired values of one shard never holds up the others. Sweeps go one shard at a time,
+ * in steps of a bounded number of values, so even the shard being swept is only held for a step at a time.
+ * The interface is the same as ExpirySet's.
+ */
+template <class T, class Hash = std::hash<T>, class KeyEqual = std::equal_to<T>>
+class ShardedExpirySet
+{
+public:
+    /**
+     * The number of values a sweep drops from a shard at most, give or take a slot, before it lets go of its mutex.
+     */
+    static constexpr size_t kDefaultReapStep = 256;
+
+    /**
+     * @param num_shards The number of shards, rounded up to a power of two. 0 means one per hardware thread.
+     * @param resolution The granularity of expiry of every shard, as for ExpirySet.
+     * @param horizon The longest time to live the time wheels of every shard cover in one go.
+     * @param reaper An optional reaper to register with, which must outlive the set. It sweeps in default steps.
+     */
+    explicit ShardedExpirySet(size_t num_shards = 0,
+                              std::chrono::nanoseconds resolution = std::chrono::milliseconds(1),
+                              std::chrono::nanoseconds horizon = std::chrono::hours(1), ExpiryReaper *reaper = nullptr)
+        : shard_mask_(RoundUpToPowerOfTwo(num_shards != 0 ? num_shards : std::thread::hardware_concurrency()) - 1)
+        , reaper_(reaper)
+        , reaper_id_(0)
+    {
+        for (size_t i = 0; i <= shard_mask_; ++i)
+        {
+            shards_.push_back(std::make_unique<Shard>(resolution, horizon));
+        }
+
+        if (reaper_ != nullptr)
+        {
+            reaper_id_ = reaper_->Register([this]() { this->Reap(); });
+        }
+    }
+
+    ShardedExpirySet(const ShardedExpirySet &) = delete;
+    ShardedExpirySet &operator=(const ShardedExpirySet &) = delete;
+
+    ~ShardedExpirySet()
+    {
+        if (reaper_ != nullptr)
+        {
+            reaper_->Unregister(reaper_id_);
+        }
+    }
+
+    /**
+     * Inserts a value, or gives the same value a new time to live.
+     *
+     * @param value The value to insert.
+     * @param ttl How long the value lives from now.
+     * @return true if the value was not in the set.
+     */
+    bool Insert(const T &value, std::chrono::nanoseconds ttl)
+    {
+        return this->GetShard(value).Insert(value, ttl);
+    }
+
+    /**
+     * Inserts a value, or gives the same value a new expiration time.
+     *
+     * @param value The value to insert.
+     * @param expiration When the value expires, on the steady clock.
+     * @return true if the value was not in the set.
+     */
+    bool InsertAt(const T &value, std::chrono::steady_clock::time_point expiration)
+    {
+        return this->GetShard(value).InsertAt(value, expiration);
+    }
+
+    bool Contains(const T &value)
+    {
+        return this->GetShard(value).Contains(value);
+    }
+
+    /**
+     * @return true if the value was in the set.
+     */
+    bool Remove(const T &value)
+    {
+        return this->GetShard(value).Remove(value);
+    }
+
+    /**
+     * Gives a value a new time to live, counted from now.
+     *
+     * @return false if the value is not in the set.
+     */
+    bool Refresh(const T &value, std::chrono::nanoseconds ttl)
+    {
+        return this->GetShard(value).Refresh(value, ttl);
+    }
+
+    /**
+     * Drops every expired value, one shard after the other, taking the mutex of a shard once per step.
+     *
+     * @param max_step The number of values to drop from a shard per step. 0 is taken as 1.
+     * @return The number of values dropped.
+     */
+    size_t Reap(size_t max_step = kDefaultReapStep)
+    {
+        // A step of 0 drops nothing, which would never tell the loop below to stop.
+        max_step = std::max<size_t>(max_step, 1);
+        size_t dropped = 0;
+        for (auto &shard : shards_)
+        {
+            size_t step;
+            do
+            {
+                step = shard->set.Reap(max_step);
+                dropped += step;
+            } while (step >= max_step);
+        }
+        return dropped;
+    }
+
+    void Clear()
+    {
+        for (auto &shard : shards_)
+        {
+            shard->set.Clear();
+        }
+    }
+
+    /**
+     * Counts the values that have not expired, one shard after the other, so the count is only a snapshot of a set in
+     * use.
+     */
+    size_t GetSize()
+    {
+        size_t size = 0;
+        for (auto &shard : shards_)
+        {
+            size += shard->set.GetSize();
+        }
+        return size;
+    }
+
+    size_t GetNumShards() const noexcept
+    {
+        return shard_mask_ + 1;
+    }
+
+private:
+    static constexpr size_t kCacheLineSize = 64;
+
+    // The padding keeps the end of one shard off the cache line the next one starts on, wherever they are allocated.
+    struct Shard
+    {
+        Shard(std::chrono::nanoseconds resolution, std::chrono::nanoseconds horizon)
+            : set(resolution, horizon)
+        {
+        }
+
+        ExpirySet<T, Hash, KeyEqual> set;
+        char pad[kCacheLineSize];
+    };
+
+    static size_t RoundUpToPowerOfTwo(size_t value)
+    {
+        size_t power = 1;
+        while (power < value)
+        {
+            power <<= 1;
+        }
+        return power;
+    }
+
+    // The shards take the high bits of a multiplicative hash, so that they do not follow the buckets of the hash
+    // tables inside them, which use the low bits of the same hash.
+    ExpirySet<T, Hash, KeyEqual> &GetShard(const T &value)
+    {
+        auto hash = static_cast<uint64_t>(hash_(value)) * 0x9E3779B97F4A7C15ull;
+        return shards_[static_cast<size_t>(hash >> 32) & shard_mask_]->set;
+    }
+
+    size_t shard_mask_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+    Hash hash_;
+
+    ExpiryReaper *reaper_;
+    uint64_t reaper_id_;
+};
+} // namespace shkwon
@@ -0,0 +1,184 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+/**
+ * A reader/writer lock for data that is read far more often than it is written, with the same preference for writers
+ * as StarveFreeLock: once a writer waits, new readers wait behind it.
+ *
+ * Every reader counts itself in one of many reader slots, each on a cache line of its own, picked once per thread. A
+ * reader only writes to its own slot and reads the writer count, which stays in every core's cache while no writer is
+ * around, so readers on different cores never bounce a cache line between them. The price is paid by the writers: a
+ * writer raises the writer count and then waits for every slot to drain, which costs a pass over all the slots.
+ *
+ * Readers and writers that have to wait park on condition variables. Meets the SharedMutex requirements, so it works
+ * with std::unique_lock and std::shared_lock; a shared lock has to be released by the thread that took it.
+ */
+class BigReaderLock
+{
+public:
+    /**
+     * @param num_slots The number of reader slots, rounded up to a power of two. 0 means one per hardware thread.
+     *                  Threads beyond that share slots, which is correct but brings back some of the contention.
+     */
+    explicit BigReaderLock(size_t num_slots = 0)
+        : slot_mask_(RoundUpToPowerOfTwo(num_slots != 0 ? num_slots : std::thread::hardware_concurrency()) - 1)
+        , slots_(new Slot[slot_mask_ + 1])
+        , writers_(0)
+    {
+    }
+
+    BigReaderLock(const BigReaderLock &) = delete;
+    BigReaderLock &operator=(const BigReaderLock &) = delete;
+
+    void lock_shared() noexcept
+    {
+        auto &readers = GetSlot().readers;
+        while (true)
+        {
+            // Pairs with the writer raising writers_ before it reads the slots: either the writer sees this reader, or
+            // this reader sees the writer. Both sides need sequential consistency for that.
+            readers.fetch_add(1, std::memory_order_seq_cst);
+            if (writers_.load(std::memory_order_seq_cst) == 0)
+            {
+                return;
+            }
+
+            // Step back out of the writer's way, and wait for it to finish.
+            this->LeaveSlot(readers);
+            std::unique_lock<std::mutex> lock(park_mutex_);
+            readers_cv_.wait(lock, [this]() { return writers_.load(std::memory_order_seq_cst) == 0; });
+        }
+    }
+
+    bool try_lock_shared() noexcept
+    {
+        auto &readers = GetSlot().readers;
+        readers.fetch_add(1, std::memory_order_seq_cst);
+        if (writers_.load(std::memory_order_seq_cst) == 0)
+        {
+            return true;
+        }
+        this->LeaveSlot(readers);
+        return false;
+    }
+
+    void unlock_shared() noexcept
+    {
+        this->LeaveSlot(GetSlot().readers);
+    }
+
+    void lock() noexcept
+    {
+        // From here on new readers wait.
+        writers_.fetch_add(1, std::memory_order_seq_cst);
+        writer_mutex_.lock();
+
+        std::unique_lock<std::mutex> lock(park_mutex_);
+        drained_cv_.wait(lock, [this]() { return this->IsDrained(); });
+    }
+
+    bool try_lock() noexcept
+    {
+        writers_.fetch_add(1, std::memory_order_seq_cst);
+        if (writer_mutex_.try_lock())
+        {
+            if (this->IsDrained())
+            {
+                return true;
+            }
+            writer_mutex_.unlock();
+        }
+        this->ReleaseWriter();
+        return false;
+    }
+
+    void unlock() noexcept
+    {
+        writer_mutex_.unlock();
+        this->ReleaseWriter();
+    }
+
+    size_t GetNumSlots() const noexcept
+    {
+        return slot_mask_ + 1;
+    }
+
+private:
+    static constexpr size_t kCacheLineSize = 64;
+
+    // Slots are a whole cache line apart, so no two counters ever share a line.
+    struct Slot
+    {
+        std::atomic<int64_t> readers{ 0 };
+        char pad[kCacheLineSize - sizeof(std::atomic<int64_t>)];
+    };
+
+    static size_t RoundUpToPowerOfTwo(size_t value)
+    {
+        size_t power = 1;
+        while (power < value)
+        {
+            power <<= 1;
+        }
+        return power;
+    }
+
+    // Threads are numbered in the order they first take a shared lock, which spreads them evenly over the slots.
+    Slot &GetSlot() noexcept
+    {
+        static std::atomic<size_t> next_thread{ 0 };
+        thread_local size_t thread_index = next_thread.fetch_add(1, std::memory_order_relaxed);
+        return slots_[thread_index & slot_mask_];
+    }
+
+    void LeaveSlot(std::atomic<int64_t> &readers) noexcept
+    {
+        readers.fetch_sub(1, std::memory_order_seq_cst);
+        // A writer may be waiting for this slot to drain. It checks the slots under park_mutex_, so taking the mutex
+        // before notifying makes sure it does not miss this.
+        if (writers_.load(std::memory_order_seq_cst) != 0)
+        {
+            std::lock_guard<std::mutex> lock(park_mutex_);
+            drained_cv_.notify_all();
+        }
+    }
+
+    bool IsDrained() const noexcept
+    {
+        for (size_t i = 0; i <= slot_mask_; ++i)
+        {
+            if (slots_[i].readers.load(std::memory_order_seq_cst) != 0)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void ReleaseWriter() noexcept
+    {
+        if (writers_.fetch_sub(1, std::memory_order_seq_cst) == 1)
+        {
+            std::lock_guard<std::mutex> lock(park_mutex_);
+            readers_cv_.notify_all();
+        }
+    }
+
+    size_t slot_mask_;
+    std::unique_ptr<Slot[]> slots_;
+    // Writers waiting or writing.
+    std::atomic<uint32_t> writers_;
+    // Lets one writer at a time wait for the slots to drain.
+    std::mutex writer_mutex_;
+    // Only used to park and wake up threads.
+    std::mutex park_mutex_;
+    std::condition_variable readers_cv_;
+    std::condition_variable drained_cv_;
+};
@@ -0,0 +1,213 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace shkwon
+{
+/**
+ * A value that is read constantly and replaced rarely, read without any lock (RCU style).
+ *
+ * Readers get a view of the current version in a few wait-free atomic operations on a cache line of their own, and
+ * keep it consistent for as long as they hold it, however many new versions are published meanwhile. Writers copy,
+ * change and publish a whole new version, then wait until no reader can still see the old one before deleting it:
+ * every reader counts itself in a per-thread slot under one of two epochs, and a writer flips the epoch twice, waiting
+ * each time for the readers of the epoch it left to finish.
+ *
+ * Readers should not hold a view for long, since writers wait for them, and must not write through the snapshot while
+ * holding one.
+ *
+ * @code
+ * Snapshot<Config> config;
+ * if (config.Read()->verbose) { ... }
+ * config.Update([](Config &next) { next.verbose = true; });
+ * @endcode
+ */
+template <class T>
+class Snapshot
+{
+public:
+    /**
+     * Keeps a version visible while it lives. It can be released on any thread.
+     */
+    class View
+    {
+    public:
+        View(View &&other) noexcept
+            : value_(other.value_)
+            , readers_(other.readers_)
+        {
+            other.readers_ = nullptr;
+        }
+
+        View(const View &) = delete;
+        View &operator=(const View &) = delete;
+        View &operator=(View &&) = delete;
+
+        ~View()
+        {
+            if (readers_ != nullptr)
+            {
+                readers_->fetch_sub(1, std::memory_order_release);
+            }
+        }
+
+        const T &operator*() const noexcept
+        {
+            return *value_;
+        }
+
+        const T *operator->() const noexcept
+        {
+            return value_;
+        }
+
+    private:
+        friend class Snapshot;
+
+        View(const T *value, std::atomic<int64_t> *readers) noexcept
+            : value_(value)
+            , readers_(readers)
+        {
+        }
+
+        const T *value_;
+        std::atomic<int64_t> *readers_;
+    };
+
+    /**
+     * @param initial The first version.
+     * @param num_slots The number of reader slots, rounded up to a power of two. 0 means one per hardware thread.
+     */
+    explicit Snapshot(T initial = T(), size_t num_slots = 0)
+        : slot_mask_(RoundUpToPowerOfTwo(num_slots != 0 ? num_slots : std::thread::hardware_concurrency()) - 1)
+        , slots_(new Slot[slot_mask_ + 1])
+        , epoch_(0)
+        , current_(new T(std::move(initial)))
+    {
+    }
+
+    Snapshot(const Snapshot &) = delete;
+    Snapshot &operator=(const Snapshot &) = delete;
+
+    /**
+     * No view may outlive the snapshot.
+     */
+    ~Snapshot()
+    {
+        delete current_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Returns a view of the current version. Wait-free.
+     */
+    View Read() const noexcept
+    {
+        auto &slot = GetSlot();
+        // Pairs with Synchronize(): a writer that flips the epoch after this count is taken waits for it, and one that
+        // flipped before has published its version before, so this loads it.
+        auto &readers = slot.readers[epoch_.load(std::memory_order_seq_cst) & 1];
+        readers.fetch_add(1, std::memory_order_seq_cst);
+        return View(current_.load(std::memory_order_seq_cst), &readers);
+    }
+
+    /**
+     * Returns a copy of the current version.
+     */
+    T Load() const
+    {
+        return *Read();
+    }
+
+    /**
+     * Publishes a new version and deletes the old one once no reader can see it any more. Writers run one at a time.
+     *
+     * @param value The new version.
+     */
+    void Store(T value)
+    {
+        std::unique_ptr<T> next(new T(std::move(value)));
+        std::lock_guard<std::mutex> lock(writer_mutex_);
+        this->Publish(std::move(next));
+    }
+
+    /**
+     * Publishes a changed copy of the current version. Concurrent updates are applied one after the other, so none of
+     * them is lost.
+     *
+     * @param update Called with the copy to change.
+     */
+    template <class F>
+    void Update(F &&update)
+    {
+        std::lock_guard<std::mutex> lock(writer_mutex_);
+        std::unique_ptr<T> next(new T(*current_.load(std::memory_order_relaxed)));
+        std::forward<F>(update)(*next);
+        this->Publish(std::move(next));
+    }
+
+private:
+    static constexpr size_t kCacheLineSize = 64;
+
+    // One count of readers per epoch parity. Slots are a whole cache line apart, so no two threads share a line.
+    struct Slot
+    {
+        std::atomic<int64_t> readers[2] = { { 0 }, { 0 } };
+        char pad[kCacheLineSize - 2 * sizeof(std::atomic<int64_t>)];
+    };
+
+    static size_t RoundUpToPowerOfTwo(size_t value)
+    {
+        size_t power = 1;
+        while (power < value)
+        {
+            power <<= 1;
+        }
+        return power;
+    }
+
+    // Threads are numbered in the order they first read, which spreads them evenly over the slots.
+    Slot &GetSlot() const noexcept
+    {
+        static std::atomic<size_t> next_thread{ 0 };
+        thread_local size_t thread_index = next_thread.fetch_add(1, std::memory_order_relaxed);
+        return slots_[thread_index & slot_mask_];
+    }
+
+    // The caller holds writer_mutex_.
+    void Publish(std::unique_ptr<T> next)
+    {
+        std::unique_ptr<T> prev(current_.exchange(next.release(), std::memory_order_seq_cst));
+        this->Synchronize();
+    }
+
+    // Waits until every reader that may have loaded the previous version has let go of it. A reader reads the epoch
+    // before it counts itself, so it may count itself under an epoch a writer has already left; flipping twice waits
+    // for the readers of both parities, each time for the ones that were there before the flip only.
+    void Synchronize()
+    {
+        for (int flip = 0; flip < 2; ++flip)
+        {
+            auto parity = epoch_.fetch_add(1, std::memory_order_seq_cst) & 1;
+            for (size_t i = 0; i <= slot_mask_; ++i)
+            {
+                while (slots_[i].readers[parity].load(std::memory_order_seq_cst) != 0)
+                {
+                    std::this_thread::yield();
+                }
+            }
+        }
+    }
+
+    size_t slot_mask_;
+    std::unique_ptr<Slot[]> slots_;
+    std::atomic<uint64_t> epoch_;
+    std::atomic<T *> current_;
+    std::mutex writer_mutex_;
+};
+} // namespace shkwon
@@ -1,62 +1,169 @@
 #pragma once
 
+#include <atomic>
 #include <condition_variable>
+#include <cstdint>
 #include <mutex>
 
+/**
+ * A reader/writer lock that prefers writers: once a writer waits, new readers wait behind it, so a steady stream of
+ * readers cannot starve the writers.
+ *
+ * The reader count, the number of waiting writers and the writing flag share one atomic word. Readers and writers that
+ * find the lock free take and release it with a single atomic operation and never touch the mutex; only a thread that
+ * has to wait parks on a condition variable, and only a release that finds someone waiting takes the mutex to wake it.
+ *
+ * Meets the SharedMutex requirements, so it works with std::unique_lock and std::shared_lock.
+ */
 class StarveFreeLock
 {
 public:
     StarveFreeLock() noexcept
-        : reader_count_(0)
-        , writer_waiting_count_(0)
-        , writing_(false)
+        : state_(0)
     {
     }
 
+    StarveFreeLock(const StarveFreeLock &) = delete;
+    StarveFreeLock &operator=(const StarveFreeLock &) = delete;
+
     void lock_shared() noexcept
     {
-        std::unique_lock<std::mutex> lock(mutex_);
-        reader_cv_.wait(lock, [this]() { return writer_waiting_count_ == 0 && !writing_; });
-        ++reader_count_;
+        if (!try_lock_shared())
+        {
+            LockSharedSlow();
+        }
+    }
+
+    bool try_lock_shared() noexcept
+    {
+        auto state = state_.load(std::memory_order_relaxed);
+        while ((state & (kWriting | kWaitingWriterMask)) == 0)
+        {
+            if (state_.compare_exchange_weak(state, state + 1, std::memory_order_acquire, std::memory_order_relaxed))
+            {
+                return true;
+            }
+        }
+        return false;
     }
 
     void unlock_shared() noexcept
     {
-        std::unique_lock<std::mutex> lock(mutex_);
-        if (--reader_count_ == 0 && writer_waiting_count_ > 0)
+        auto prev = state_.fetch_sub(1, std::memory_order_release);
+        if ((prev & kReaderMask) == 1 && (prev & kWaitingWriterMask) != 0)
         {
+            std::lock_guard<std::mutex> lock(mutex_);
             writer_cv_.notify_one();
         }
     }
 
     void lock() noexcept
     {
-        std::unique_lock<std::mutex> lock(mutex_);
-        ++writer_waiting_count_;
-        writer_cv_.wait(lock, [this]() { return reader_count_ == 0 && !writing_; });
-        --writer_waiting_count_;
-        writing_ = true;
+        if (!try_lock())
+        {
+            LockSlow();
+        }
+    }
+
+    bool try_lock() noexcept
+    {
+        uint64_t expected = 0;
+        return state_.compare_exchange_strong(expected, kWriting, std::memory_order_acquire, std::memory_order_relaxed);
     }
 
     void unlock() noexcept
     {
-        std::unique_lock<std::mutex> lock(mutex_);
-        writing_ = false;
-        if (writer_waiting_count_ > 0)
+        uint64_t expected = kWriting;
+        if (state_.compare_exchange_strong(expected, 0, std::memory_order_release, std::memory_order_relaxed))
+        {
+            return;
+        }
+
+        // Someone is waiting. The parked readers are only let go once no writer is left waiting; until then their flag
+        // stays, so that the last writer still knows to wake them.
+        auto state = expected;
+        uint64_t next;
+        do
+        {
+            next = state & ~kWriting;
+            if ((state & kWaitingWriterMask) == 0)
+            {
+                next &= ~kReadersParked;
+            }
+        } while (!state_.compare_exchange_weak(state, next, std::memory_order_release, std::memory_order_relaxed));
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if ((state & kWaitingWriterMask) != 0)
         {
             writer_cv_.notify_one();
         }
-        else
+        else if ((state & kReadersParked) != 0)
         {
             reader_cv_.notify_all();
         }
     }
 
 private:
+    // Low 32 bits: active readers. Bits 32 to 61: waiting writers. Then the parked readers flag and the writing flag.
+    static constexpr uint64_t kReaderMask = 0xFFFFFFFFull;
+    static constexpr uint64_t kWaitingWriter = uint64_t(1) << 32;
+    static constexpr uint64_t kWaitingWriterMask = 0x3FFFFFFFull << 32;
+    static constexpr uint64_t kReadersParked = uint64_t(1) << 62;
+    static constexpr uint64_t kWriting = uint64_t(1) << 63;
+
+    // Whoever changes the state so that a parked thread may go on takes the mutex before notifying, and a thread only
+    // parks after checking the state under the mutex, so no wake-up is lost.
+    void LockSharedSlow() noexcept
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        auto state = state_.load(std::memory_order_relaxed);
+        while (true)
+        {
+            if ((state & (kWriting | kWaitingWriterMask)) == 0)
+            {
+                if (state_.compare_exchange_weak(state, state + 1, std::memory_order_acquire,
+                                                 std::memory_order_relaxed))
+                {
+                    return;
+                }
+                continue;
+            }
+
+            if ((state & kReadersParked) == 0 &&
+                !state_.compare_exchange_weak(state, state | kReadersParked, std::memory_order_relaxed))
+            {
+                continue;
+            }
+            reader_cv_.wait(lock);
+            state = state_.load(std::memory_order_relaxed);
+        }
+    }
+
+    void LockSlow() noexcept
+    {
+        // From here on new readers wait.
+        state_.fetch_add(kWaitingWriter, std::memory_order_relaxed);
+        std::unique_lock<std::mutex> lock(mutex_);
+        auto state = state_.load(std::memory_order_relaxed);
+        while (true)
+        {
+            if ((state & (kReaderMask | kWriting)) == 0)
+            {
+                if (state_.compare_exchange_weak(state, (state - kWaitingWriter) | kWriting, std::memory_order_acquire,
+                                                 std::memory_order_relaxed))
+                {
+                    return;
+                }
+                continue;
+            }
+
+            writer_cv_.wait(lock);
+            state = state_.load(std::memory_order_relaxed);
+        }
+    }
+
+    std::atomic<uint64_t> state_;
     std::mutex mutex_;
     std::condition_variable reader_cv_;
     std::condition_variable writer_cv_;
-    int reader_count_;
-    int writer_waiting_count_;
-    bool writing_;
 };
@@ -3,12 +3,24 @@
 
 #include "cli_parser/cli_parser.hpp"
 #include "debug/debug.hpp"
+#include "debug/tracer.hpp"
+#include "expiry/compact_expiry_set.hpp"
+#include "expiry/expiry_map.hpp"
+#include "expiry/expiry_reaper.hpp"
+#include "expiry/expiry_set.hpp"
+#include "expiry/sharded_expiry_set.hpp"
+#include "lock/big_reader_lock.hpp"
+#include "lock/snapshot.hpp"
 #include "lock/starve_free_lock.hpp"
 #include "status/status.hpp"
+#include "thread_pool/future.hpp"
+#include "thread_pool/parallel.hpp"
+#include "thread_pool/task_graph.hpp"
 #include "thread_pool/thread_pool.hpp"
+#include "thread_pool/work_stealing_thread_pool.hpp"
+#include "time_wheel_scheduler/sharded_time_wheel_scheduler.hpp"
 #include "time_wheel_scheduler/time_wheel_scheduler.hpp"
+#include "timer/profiler.hpp"
 #include "timer/timer.hpp"
 
-// #include <todo/expiry_set.hpp>
-
 #endif // _SHKWON_HPP
@@ -1,57 +1,143 @@
 #pragma once
 
+#include <atomic>
 #include <cstdarg>
+#include <cstddef>
+#include <cstdint>
 #include <cstdio>
+#include <cstring>
+#include <new>
 #include <string>
+#include <utility>
 
 #include "success_condition.hpp"
 
 namespace shkwon
 {
+/**
+ * A message that outlives every Status holding it, typically a string literal, so that a Status can point to it instead
+ * of copying it.
+ *
+ * @code
+ * return Status(ThreadPoolErrorCode::QueueFull, StaticMessage("ThreadPool job queue is full"));
+ * @endcode
+ */
+struct StaticMessage
+{
+    explicit constexpr StaticMessage(const char *message) noexcept
+        : text(message)
+    {
+    }
+
+    const char *text;
+};
+
+/**
+ * An error code with an optional message.
+ *
+ * Besides the error code, a Status is a single word: null without a message, the text itself for a StaticMessage, or a
+ * pointer to an immutable block shared by its copies, with the text stored inline. So a Status without a message or
+ * with a static one never allocates, and copying one at most bumps a reference count. A printf-style message is
+ * formatted into a stack buffer and allocated once, and Chain() links the new message to the old one rather than
+ * concatenating them, so the full message is only put together when message() or DebugString() asks for it.
+ */
 class [[nodiscard]] Status
 {
 public:
-    Status(const std::error_code &code, std::string message = "")
-        : code_(code)
-        , message_(std::move(message))
+    Status(const std::error_code &code) noexcept
+        : value_(code.value())
+        , shared_(false)
+        , category_(&code.category())
+        , message_(nullptr)
+    {
+    }
+    Status(const std::error_code &code, const std::string &message)
+        : Status(code)
+    {
+        if (!message.empty())
+        {
+            this->Adopt(Rep::Create(message.data(), message.size(), nullptr, false));
+        }
+    }
+    Status(const std::error_code &code, StaticMessage message) noexcept
+        : Status(code)
     {
+        message_ = message.text;
     }
     Status(const std::error_code &code, const char *message, ...)
-        : code_(code)
+        : Status(code)
     {
         va_list args;
         va_start(args, message);
+        this->Adopt(Rep::Format(message, args, nullptr, false));
+        va_end(args);
+    }
+    Status() noexcept
+        : Status(std::error_code())
+    {
+    }
+    Status(const Status &other) noexcept
+        : value_(other.value_)
+        , shared_(other.shared_)
+        , category_(other.category_)
+        , message_(other.message_)
+    {
+        Rep::Acquire(message_, shared_);
+    }
+    Status(Status &&other) noexcept
+        : value_(other.value_)
+        , shared_(other.shared_)
+        , category_(other.category_)
+        , message_(other.message_)
+    {
+        other.shared_ = false;
+        other.message_ = nullptr;
+    }
+    ~Status()
+    {
+        Rep::Release(message_, shared_);
+    }
 
-        char *buffer = nullptr;
-        if (vasprintf(&buffer, message, args) != -1)
-        {
-            message_ = std::string(buffer);
-            free(buffer);
-        }
-        else
+    Status &operator=(const Status &other) noexcept
+    {
+        Rep::Acquire(other.message_, other.shared_);
+        Rep::Release(message_, shared_);
+        value_ = other.value_;
+        shared_ = other.shared_;
+        category_ = other.category_;
+        message_ = other.message_;
+        return *this;
+    }
+
+    Status &operator=(Status &&other) noexcept
+    {
+        if (this != &other)
         {
-            message_ = "Error formatting message";
+            Rep::Release(message_, shared_);
+            value_ = other.value_;
+            shared_ = other.shared_;
+            category_ = other.category_;
+            message_ = other.message_;
+            other.shared_ = false;
+            other.message_ = nullptr;
         }
-
-        va_end(args);
+        return *this;
     }
-    Status() = default;
-    ~Status() = default;
 
     /**
-     * This operator returns true if the code_ member variable of the ::shkwon::Status object is set to
+     * This operator returns true if the error code of the ::shkwon::Status object is set to
      * SuccessCondition::Success/0, which means that the operation was successful. This operator is useful when the
      * ::shkwon::Status object is used as the return type of a method, making it more intuitive to check if the
      * operation was successful or not.
      */
     operator bool() const
     {
-        return (code_ == SuccessCondition::Success);
+        return (code() == SuccessCondition::Success);
     }
 
     std::error_code code() const
     {
-        return code_;
+        return std::error_code(value_, *category_);
     }
 
     /**
@@ -63,7 +149,7 @@ public:
     bool Is() const
     {
         static_assert(std::is_error_code_enum<ENUM>::value, "Must check against an error code enum");
-        return std::error_code(ENUM{}).category() == code_.category();
+        return std::error_code(ENUM{}).category() == *category_;
     }
 
     /**
@@ -76,25 +162,28 @@ public:
     bool Equivalent(const std::error_condition &condition) const
     {
         static_assert(std::is_error_condition_enum<ENUM>::value, "Must check against an error condition enum");
-        return code_.category().equivalent(static_cast<int>(code_.value()), condition);
+        return category_->equivalent(value_, condition);
     }
 
     /**
-     * @return The message associated with the status. Recommends using DebugString() instead for more information.
+     * @return The message associated with the status, put together from the messages it was chained from. Recommends
+     *         using DebugString() instead for more information.
      */
-    const std::string &message() const
+    std::string message() const
     {
-        return message_;
+        std::string result;
+        AppendMessage(result, message_, shared_);
+        return result;
     }
 
     /**
      * Extend a ::shkwon::Status with a new message.
      */
-    ::shkwon::Status Chain(std::string message) const
+    ::shkwon::Status Chain(const std::string &message) const
     {
-        message += " >> ";
-        message += message_;
-        return Status(code_, std::move(message));
+        Status chained(this->code());
+        chained.Adopt(Rep::Create(message.data(), message.size(), this, false));
+        return chained;
     }
 
     /**
@@ -102,32 +191,22 @@ public:
      */
     ::shkwon::Status Chain(const char *message, ...) const
     {
+        Status chained(this->code());
         va_list args;
         va_start(args, message);
-
-        char *buffer = nullptr;
-        if (vasprintf(&buffer, message, args) != -1)
-        {
-            std::string new_message = std::string(buffer);
-            free(buffer);
-            return Chain(std::move(new_message));
-        }
-        else
-        {
-            return Chain("Error formatting message");
-        }
-
+        chained.Adopt(Rep::Format(message, args, this, false));
         va_end(args);
+        return chained;
     }
 
     /**
      * Transform a ::shkwon::Status into a new code.
      */
-    ::shkwon::Status Chain(std::error_code code, std::string message) const
+    ::shkwon::Status Chain(std::error_code code, const std::string &message) const
     {
-        message += " >> ";
-        message += DebugString();
-        return Status(code, std::move(message));
+        Status chained(code);
+        chained.Adopt(Rep::Create(message.data(), message.size(), this, true));
+        return chained;
     }
 
     /**
@@ -135,11 +214,8 @@ public:
      */
     std::string DebugString() const
     {
-        std::string result = std::to_string(code_.value());
-        result += "(";
-        result += code_.message();
-        result += "): ";
-        result += message_;
+        std::string result;
+        AppendDebugString(result, this->code(), message_, shared_);
         return result;
     }
 
@@ -151,8 +227,153 @@ public:
     }
 
 private:
-    std::error_code code_;
-    std::string message_;
+    // A message, immutable once created and freed with the last Status that points to it, with its text stored right
+    // after it. A chained message keeps the Status it was chained from, its cause, whose message is appended after
+    // " >> ", along with its code if the chain changed the code.
+    struct Rep
+    {
+        static constexpr size_t kFormatBufferSize = 256;
+
+        Rep(size_t text_length, const Status *chained, bool with_code) noexcept
+            : refs(1)
+            , length(text_length)
+            , chained_from(chained != nullptr)
+            , cause_with_code(with_code)
+            , cause_shared(chained != nullptr && chained->shared_)
+            , cause_value(chained != nullptr ? chained->value_ : 0)
+            , cause_category(chained != nullptr ? chained->category_ : nullptr)
+            , cause(chained != nullptr ? chained->message_ : nullptr)
+        {
+            Acquire(cause, cause_shared);
+        }
+
+        ~Rep()
+        {
+            Release(cause, cause_shared);
+        }
+
+        char *GetText() noexcept
+        {
+            return reinterpret_cast<char *>(this + 1);
+        }
+
+        // Allocates the block and its text in one go. The caller writes the text.
+        static Rep *Allocate(size_t length, const Status *chained, bool with_code)
+        {
+            auto *rep = new (::operator new(sizeof(Rep) + length + 1)) Rep(length, chained, with_code);
+            rep->GetText()[length] = '\0';
+            return rep;
+        }
+
+        static Rep *Create(const char *text, size_t length, const Status *chained, bool with_code)
+        {
+            auto *rep = Allocate(length, chained, with_code);
+            std::memcpy(rep->GetText(), text, length);
+            return rep;
+        }
+
+        // Formats into a stack buffer first, so that the text is formatted twice only if it does not fit.
+        static Rep *Format(const char *format, va_list args, const Status *chained, bool with_code)
+        {
+            char buffer[kFormatBufferSize];
+            va_list retry;
+            va_copy(retry, args);
+            auto length = std::vsnprintf(buffer, sizeof(buffer), format, args);
+            Rep *rep;
+            if (length < 0)
+            {
+                rep = Create("Error formatting message", std::strlen("Error formatting message"), chained, with_code);
+            }
+            else if (static_cast<size_t>(length) < sizeof(buffer))
+            {
+                rep = Create(buffer, static_cast<size_t>(length), chained, with_code);
+            }
+            else
+            {
+                rep = Allocate(static_cast<size_t>(length), chained, with_code);
+                std::vsnprintf(rep->GetText(), static_cast<size_t>(length) + 1, format, retry);
+            }
+            va_end(retry);
+            return rep;
+        }
+
+        static void Acquire(const void *message, bool shared) noexcept
+        {
+            if (shared)
+            {
+                static_cast<const Rep *>(message)->refs.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        static void Release(const void *message, bool shared) noexcept
+        {
+            auto *rep = static_cast<const Rep *>(message);
+            if (shared && rep->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            {
+                rep->~Rep();
+                ::operator delete(const_cast<Rep *>(rep));
+            }
+        }
+
+        mutable std::atomic<uint32_t> refs;
+        size_t length;
+        bool chained_from;
+        bool cause_with_code;
+        bool cause_shared;
+        int cause_value;
+        const std::error_category *cause_category;
+        const void *cause;
+    };
+
+    // Takes over a new message. The caller has not set one yet.
+    void Adopt(Rep *rep) noexcept
+    {
+        message_ = rep;
+        shared_ = true;
+    }
+
+    static void AppendMessage(std::string &result, const void *message, bool shared)
+    {
+        while (message != nullptr)
+        {
+            if (!shared)
+            {
+                result += static_cast<const char *>(message);
+                return;
+            }
+
+            auto *rep = static_cast<const Rep *>(message);
+            result.append(reinterpret_cast<const char *>(rep + 1), rep->length);
+            if (!rep->chained_from)
+            {
+                return;
+            }
+            result += " >> ";
+            if (rep->cause_with_code)
+            {
+                AppendDebugString(result, std::error_code(rep->cause_value, *rep->cause_category), rep->cause,
+                                  rep->cause_shared);
+                return;
+            }
+            message = rep->cause;
+            shared = rep->cause_shared;
+        }
+    }
+
+    static void AppendDebugString(std::string &result, const std::error_code &code, const void *message, bool shared)
+    {
+        result += std::to_string(code.value());
+        result += "(";
+        result += code.message();
+        result += "): ";
+        AppendMessage(result, message, shared);
+    }
+
+    // The error code is kept as its parts, so that whether the message is shared fits in between them.
+    int value_;
+    bool shared_;
+    const std::error_category *category_;
+    const void *message_;
 };
 
 template <typename T>
@@ -164,4 +385,4 @@ struct [[nodiscard]] StatusOr : public std::pair<T, Status>
 
 } // namespace shkwon
 
-#include "result.hpp"
\ No newline at end of file
+#include "result.hpp"
@@ -34,8 +34,14 @@ public:
     }
 };
 
-const SuccessConditionCategory &success_condition_category{};
-std::error_condition make_error_condition(SuccessCondition value) noexcept
+inline const SuccessConditionCategory &GetSuccessConditionCategory() noexcept
 {
-    return std::error_condition{ static_cast<int>(value), success_condition_category };
+    static const SuccessConditionCategory category{};
+    return category;
+}
+
+static const SuccessConditionCategory &success_condition_category = GetSuccessConditionCategory();
+inline std::error_condition make_error_condition(SuccessCondition value) noexcept
+{
+    return std::error_condition{ static_cast<int>(value), GetSuccessConditionCategory() };
 }
\ No newline at end of file
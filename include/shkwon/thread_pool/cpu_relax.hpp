@@ -0,0 +1,17 @@
+#pragma once
+
+namespace shkwon
+{
+/**
+ * Hints the CPU that the caller is busy-waiting, which saves power and frees pipeline resources for a sibling
+ * hyper-thread.
+ */
+inline void CpuRelax() noexcept
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    asm volatile("yield" ::: "memory");
+#endif
+}
+} // namespace shkwon
@@ -0,0 +1,631 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "shkwon/thread_pool/task.hpp"
+
+namespace shkwon
+{
+/**
+ * Where continuations run: on a pool, or inline on the thread that completed their input.
+ *
+ * Wraps a reference to any pool with a Post() member (ThreadPool, WorkStealingThreadPool, ...). The pool has to
+ * outlive every future whose continuations may still be scheduled onto it.
+ */
+class Executor
+{
+public:
+    /**
+     * Constructs an inline executor.
+     */
+    Executor() noexcept
+        : pool_(nullptr)
+        , post_(nullptr)
+    {
+    }
+
+    template <class Pool, class = typename std::enable_if<!std::is_same<Pool, Executor>::value>::type>
+    Executor(Pool &pool) noexcept
+        : pool_(&pool)
+        , post_(&PostTo<Pool>)
+    {
+    }
+
+    /**
+     * Runs a job on the pool, or inline if this is an inline executor. A job the pool turns away before taking it
+     * (because the pool is shutting down) is run inline as well, so that a continuation is never lost. Only a pool
+     * that rejects a job after taking it, i.e. a bounded queue with Backpressure::Reject, makes this throw.
+     *
+     * @param job The job to run.
+     */
+    void Execute(Task job) const
+    {
+        if (post_)
+        {
+            try
+            {
+                post_(pool_, job);
+                return;
+            }
+            catch (...)
+            {
+                if (!job)
+                {
+                    throw;
+                }
+            }
+        }
+        job();
+    }
+
+    bool IsInline() const noexcept
+    {
+        return post_ == nullptr;
+    }
+
+private:
+    // The pools take the job by reference and only move it once they accept it, so a pool that throws before taking
+    // it leaves it in place to be run inline. A Task is passed on to the queue as it is, without wrapping it again.
+    template <class Pool>
+    static void PostTo(void *pool, Task &job)
+    {
+        static_cast<Pool *>(pool)->Post(std::move(job));
+    }
+
+    void *pool_;
+    void (*post_)(void *, Task &);
+};
+
+template <class T>
+class Future;
+
+template <class T>
+class Promise;
+
+namespace detail
+{
+struct Unit
+{
+};
+
+template <class T>
+using FutureStorage = typename std::conditional<std::is_void<T>::value, Unit, T>::type;
+
+/**
+ * The state shared by a Promise and its Futures: the result once it is there, and the continuations waiting for it.
+ */
+template <class T>
+class FutureState
+{
+public:
+    using Storage = FutureStorage<T>;
+
+    explicit FutureState(const Executor &executor)
+        : executor_(executor)
+        , ready_(false)
+        , has_value_(false)
+    {
+    }
+
+    FutureState(const FutureState &) = delete;
+    FutureState &operator=(const FutureState &) = delete;
+
+    ~FutureState()
+    {
+        if (has_value_)
+        {
+            GetValue().~Storage();
+        }
+    }
+
+    template <class... V>
+    void SetValue(V &&...value)
+    {
+        Complete([&]() {
+            ::new (&value_) Storage(std::forward<V>(value)...);
+            has_value_ = true;
+        });
+    }
+
+    void SetException(std::exception_ptr error)
+    {
+        Complete([&]() { error_ = std::move(error); });
+    }
+
+    bool IsReady() const noexcept
+    {
+        return ready_.load(std::memory_order_acquire);
+    }
+
+    void Wait()
+    {
+        if (IsReady())
+        {
+            return;
+        }
+        std::unique_lock<std::mutex> lock(mtx_);
+        cv_ready_.wait(lock, [this]() { return IsReady(); });
+    }
+
+    // Only call once the state is ready.
+    const Storage &GetValue() const noexcept
+    {
+        return *reinterpret_cast<const Storage *>(&value_);
+    }
+
+    Storage &GetValue() noexcept
+    {
+        return *reinterpret_cast<Storage *>(&value_);
+    }
+
+    const std::exception_ptr &GetException() const noexcept
+    {
+        return error_;
+    }
+
+    const Executor &GetExecutor() const noexcept
+    {
+        return executor_;
+    }
+
+    /**
+     * Schedules a continuation on `executor` once the state is ready, or right away if it already is.
+     */
+    void OnReady(const Executor &executor, Task continuation)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            if (!IsReady())
+            {
+                continuations_.push_back(Continuation{ executor, std::move(continuation) });
+                return;
+            }
+        }
+        executor.Execute(std::move(continuation));
+    }
+
+private:
+    struct Continuation
+    {
+        Executor executor;
+        Task job;
+    };
+
+    template <class Store>
+    void Complete(Store &&store)
+    {
+        std::vector<Continuation> continuations;
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            if (IsReady())
+            {
+                throw std::future_error(std::future_errc::promise_already_satisfied);
+            }
+            store();
+            ready_.store(true, std::memory_order_release);
+            continuations.swap(continuations_);
+        }
+        cv_ready_.notify_all();
+
+        for (auto &continuation : continuations)
+        {
+            continuation.executor.Execute(std::move(continuation.job));
+        }
+    }
+
+    Executor executor_;
+    std::atomic<bool> ready_;
+    bool has_value_;
+    typename std::aligned_storage<sizeof(Storage), alignof(Storage)>::type value_;
+    std::exception_ptr error_;
+    std::vector<Continuation> continuations_;
+    std::condition_variable cv_ready_;
+    std::mutex mtx_;
+};
+
+// Calls a continuation with the value of a ready state, or with nothing for Future<void>.
+template <class T>
+struct ContinuationCall
+{
+    template <class F>
+    using Result = typename std::result_of<F &(const T &)>::type;
+
+    template <class F>
+    static Result<F> Call(F &f, const FutureState<T> &state)
+    {
+        return f(state.GetValue());
+    }
+};
+
+template <>
+struct ContinuationCall<void>
+{
+    template <class F>
+    using Result = typename std::result_of<F &()>::type;
+
+    template <class F>
+    static Result<F> Call(F &f, const FutureState<void> &)
+    {
+        return f();
+    }
+};
+
+// Stores the result of `fn()` in the promise, or the exception it threw.
+template <class R, class Fn>
+void Fulfill(Promise<R> &promise, Fn &&fn, std::false_type /* is_void */)
+{
+    try
+    {
+        promise.SetValue(fn());
+    }
+    catch (...)
+    {
+        promise.SetException(std::current_exception());
+    }
+}
+
+template <class R, class Fn>
+void Fulfill(Promise<R> &promise, Fn &&fn, std::true_type /* is_void */)
+{
+    try
+    {
+        fn();
+        promise.SetValue();
+    }
+    catch (...)
+    {
+        promise.SetException(std::current_exception());
+    }
+}
+
+template <class R, class Fn>
+void Fulfill(Promise<R> &promise, Fn &&fn)
+{
+    Fulfill(promise, std::forward<Fn>(fn), std::is_void<R>());
+}
+} // namespace detail
+
+/**
+ * The producing side of a Future.
+ *
+ * Destroying a Promise that was never fulfilled completes its Future with a std::future_error (broken_promise).
+ */
+template <class T>
+class Promise
+{
+public:
+    /**
+     * @param executor Where continuations that do not name an executor of their own run.
+     */
+    explicit Promise(const Executor &executor = Executor())
+        : state_(std::make_shared<detail::FutureState<T>>(executor))
+    {
+    }
+
+    Promise(Promise &&) noexcept = default;
+    Promise &operator=(Promise &&other) noexcept
+    {
+        Abandon();
+        state_ = std::move(other.state_);
+        return *this;
+    }
+
+    ~Promise()
+    {
+        Abandon();
+    }
+
+    Future<T> GetFuture() const
+    {
+        return Future<T>(state_);
+    }
+
+    template <class... V>
+    void SetValue(V &&...value)
+    {
+        state_->SetValue(std::forward<V>(value)...);
+    }
+
+    void SetException(std::exception_ptr error)
+    {
+        state_->SetException(std::move(error));
+    }
+
+private:
+    void Abandon()
+    {
+        if (state_ && !state_->IsReady())
+        {
+            state_->SetException(std::make_exception_ptr(std::future_error(std::future_errc::broken_promise)));
+        }
+    }
+
+    std::shared_ptr<detail::FutureState<T>> state_;
+};
+
+/**
+ * A handle to a result that a pool job produces later.
+ *
+ * Unlike std::future, work can be chained onto a Future with Then() and combined with WhenAll()/WhenAny(), and the
+ * continuations are scheduled onto a pool once their input is ready, so no thread has to block in Get() to wait for an
+ * intermediate result. Futures are cheap to copy; every copy refers to the same result.
+ */
+template <class T>
+class Future
+{
+public:
+    Future() = default;
+
+    bool IsValid() const noexcept
+    {
+        return static_cast<bool>(state_);
+    }
+
+    bool IsReady() const noexcept
+    {
+        return state_->IsReady();
+    }
+
+    /**
+     * Blocks until the result is ready. Avoid this on a pool's own workers; chain a continuation instead.
+     */
+    void Wait() const
+    {
+        state_->Wait();
+    }
+
+    /**
+     * Waits for the result and returns it.
+     *
+     * @return The value (nothing for Future<void>). Rethrows the exception if the job failed.
+     */
+    const detail::FutureStorage<T> &Get() const
+    {
+        state_->Wait();
+        if (state_->GetException())
+        {
+            std::rethrow_exception(state_->GetException());
+        }
+        return state_->GetValue();
+    }
+
+    /**
+     * @return The exception the job failed with, or nullptr if it succeeded or is not done yet.
+     */
+    std::exception_ptr GetException() const
+    {
+        return IsReady() ? state_->GetException() : nullptr;
+    }
+
+    /**
+     * @return Where continuations attached with Then(f) run.
+     */
+    const Executor &GetExecutor() const noexcept
+    {
+        return state_->GetExecutor();
+    }
+
+    /**
+     * Runs `f(value)` (or `f()` for Future<void>) on `executor` once this future has a value.
+     *
+     * If this future holds an exception, `f` is skipped and the exception is passed on to the returned future. An
+     * exception thrown by `f` ends up in the returned future as well.
+     *
+     * @param executor Where `f` runs, and where continuations of the returned future run by default.
+     * @param f The continuation.
+     *
+     * @return A future for the result of `f`.
+     */
+    template <class F>
+    Future<typename detail::ContinuationCall<T>::template Result<typename std::decay<F>::type>> Then(
+        const Executor &executor, F &&f) const
+    {
+        using Function = typename std::decay<F>::type;
+        using R = typename detail::ContinuationCall<T>::template Result<Function>;
+
+        Promise<R> promise(executor);
+        auto future = promise.GetFuture();
+        auto state = state_;
+        state_->OnReady(executor, [state, fn = Function(std::forward<F>(f)), promise = std::move(promise)]() mutable {
+            if (state->GetException())
+            {
+                promise.SetException(state->GetException());
+                return;
+            }
+            detail::Fulfill(promise, [&]() { return detail::ContinuationCall<T>::Call(fn, *state); });
+        });
+        return future;
+    }
+
+    /**
+     * Like Then(executor, f), on the executor this future was created with.
+     */
+    template <class F>
+    Future<typename detail::ContinuationCall<T>::template Result<typename std::decay<F>::type>> Then(F &&f) const
+    {
+        return Then(GetExecutor(), std::forward<F>(f));
+    }
+
+    /**
+     * Runs `notify()` inline on the completing thread once this future is ready, whether it holds a value or an
+     * exception. Meant for cheap bookkeeping like WhenAll(); anything heavier belongs in Then().
+     *
+     * @param notify The callback.
+     */
+    void OnReady(Task notify) const
+    {
+        state_->OnReady(Executor(), std::move(notify));
+    }
+
+private:
+    friend class Promise<T>;
+
+    explicit Future(std::shared_ptr<detail::FutureState<T>> state)
+        : state_(std::move(state))
+    {
+    }
+
+    std::shared_ptr<detail::FutureState<T>> state_;
+};
+
+/**
+ * Runs `f(args...)` on a pool and returns a Future for its result.
+ *
+ * @param pool The pool to run the job on. Continuations of the returned future run there too unless told otherwise.
+ * @param f The callable to execute.
+ * @param args The arguments bound to the callable.
+ *
+ * @return A future for the result of the job.
+ */
+template <class Pool, class F, class... Args>
+Future<typename std::result_of<F(Args...)>::type> Async(Pool &pool, F &&f, Args &&...args)
+{
+    using R = typename std::result_of<F(Args...)>::type;
+
+    Promise<R> promise{ Executor(pool) };
+    auto future = promise.GetFuture();
+    pool.Post([job = std::bind(std::forward<F>(f), std::forward<Args>(args)...),
+               promise = std::move(promise)]() mutable { detail::Fulfill(promise, job); });
+    return future;
+}
+
+namespace detail
+{
+template <class T>
+struct WhenAllResult
+{
+    using type = std::vector<T>;
+
+    static void Set(Promise<type> &promise, const std::vector<Future<T>> &futures)
+    {
+        type values;
+        values.reserve(futures.size());
+        for (const auto &future : futures)
+        {
+            values.push_back(future.Get());
+        }
+        promise.SetValue(std::move(values));
+    }
+};
+
+template <>
+struct WhenAllResult<void>
+{
+    using type = void;
+
+    static void Set(Promise<void> &promise, const std::vector<Future<void>> &)
+    {
+        promise.SetValue();
+    }
+};
+} // namespace detail
+
+/**
+ * Combines futures into one that becomes ready once all of them have a value.
+ *
+ * The returned future fails as soon as any input fails, with that input's exception. It uses the executor of the
+ * first input (or an inline one for an empty list).
+ *
+ * @param futures The futures to wait for.
+ * @return A future for the values in input order; a Future<void> for void inputs.
+ */
+template <class T>
+Future<typename detail::WhenAllResult<T>::type> WhenAll(const std::vector<Future<T>> &futures)
+{
+    using Result = detail::WhenAllResult<T>;
+
+    struct State
+    {
+        State(const std::vector<Future<T>> &inputs)
+            : futures(inputs)
+            , promise(inputs.empty() ? Executor() : inputs.front().GetExecutor())
+            , remaining(inputs.size())
+            , done(false)
+        {
+        }
+
+        std::vector<Future<T>> futures;
+        Promise<typename Result::type> promise;
+        std::atomic<size_t> remaining;
+        std::atomic<bool> done;
+    };
+
+    auto state = std::make_shared<State>(futures);
+    auto combined = state->promise.GetFuture();
+    if (futures.empty())
+    {
+        Result::Set(state->promise, state->futures);
+        return combined;
+    }
+
+    for (size_t i = 0; i < futures.size(); ++i)
+    {
+        futures[i].OnReady([state, i]() {
+            auto error = state->futures[i].GetException();
+            if (error)
+            {
+                if (!state->done.exchange(true))
+                {
+                    state->promise.SetException(error);
+                }
+            }
+            else if (state->remaining.fetch_sub(1) == 1 && !state->done.exchange(true))
+            {
+                Result::Set(state->promise, state->futures);
+            }
+        });
+    }
+    return combined;
+}
+
+/**
+ * Combines futures into one that becomes ready as soon as any of them is ready, with a value or an exception.
+ *
+ * @param futures The futures to wait for. Must not be empty.
+ * @return A future for the index of the first input that became ready. It uses the executor of the first input.
+ */
+template <class T>
+Future<size_t> WhenAny(const std::vector<Future<T>> &futures)
+{
+    if (futures.empty())
+    {
+        throw std::invalid_argument("WhenAny needs at least one future.");
+    }
+
+    struct State
+    {
+        explicit State(const Executor &executor)
+            : promise(executor)
+            , done(false)
+        {
+        }
+
+        Promise<size_t> promise;
+        std::atomic<bool> done;
+    };
+
+    auto state = std::make_shared<State>(futures.front().GetExecutor());
+    auto first = state->promise.GetFuture();
+    for (size_t i = 0; i < futures.size(); ++i)
+    {
+        futures[i].OnReady([state, i]() {
+            if (!state->done.exchange(true))
+            {
+                state->promise.SetValue(i);
+            }
+        });
+    }
+    return first;
+}
+} // namespace shkwon
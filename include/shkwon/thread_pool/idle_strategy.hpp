@@ -0,0 +1,97 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <thread>
+
+#include "shkwon/thread_pool/cpu_relax.hpp"
+#include "shkwon/thread_pool/thread_pool_options.hpp"
+
+namespace shkwon
+{
+/**
+ * Per-worker state of an IdlePolicy.
+ *
+ * A worker that found nothing to do calls Wait() before it goes to sleep. Wait() polls a readiness predicate for as
+ * long as the policy allows, so that a job arriving shortly afterwards is picked up without a wake-up round trip.
+ */
+class IdleStrategy
+{
+public:
+    IdleStrategy(IdlePolicy policy, uint32_t spin_count, uint32_t yield_count)
+        : policy_(policy)
+        , max_spin_count_(spin_count)
+        , min_spin_count_(std::max<uint32_t>(1, spin_count / 64))
+        , spin_count_(spin_count)
+        , yield_count_(yield_count)
+    {
+    }
+
+    /**
+     * Polls `ready` until it returns true or the idle budget runs out.
+     *
+     * @param ready A predicate telling whether there may be work (or a reason to stop) now.
+     * @return true if `ready` returned true, false if the caller should go to sleep.
+     */
+    template <class Ready>
+    bool Wait(Ready &&ready)
+    {
+        if (policy_ == IdlePolicy::Park)
+        {
+            return false;
+        }
+
+        for (uint32_t i = 0; i < spin_count_; ++i)
+        {
+            CpuRelax();
+            if (ready())
+            {
+                Adapt(true);
+                return true;
+            }
+        }
+
+        for (uint32_t i = 0; i < yield_count_; ++i)
+        {
+            std::this_thread::yield();
+            if (ready())
+            {
+                Adapt(true);
+                return true;
+            }
+        }
+
+        Adapt(false);
+        return false;
+    }
+
+    uint32_t GetSpinCount() const noexcept
+    {
+        return spin_count_;
+    }
+
+private:
+    void Adapt(bool found_work) noexcept
+    {
+        if (policy_ != IdlePolicy::Adaptive)
+        {
+            return;
+        }
+
+        if (found_work)
+        {
+            spin_count_ = static_cast<uint32_t>(std::min<uint64_t>(max_spin_count_, uint64_t(spin_count_) * 2));
+        }
+        else
+        {
+            spin_count_ = std::max(min_spin_count_, spin_count_ / 2);
+        }
+    }
+
+    IdlePolicy policy_;
+    uint32_t max_spin_count_;
+    uint32_t min_spin_count_;
+    uint32_t spin_count_;
+    uint32_t yield_count_;
+};
+} // namespace shkwon
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+
+namespace shkwon
+{
+/**
+ * A single-use countdown latch, modelled after C++20's std::latch.
+ *
+ * Counting down is a single atomic operation unless it releases the latch, so many workers can report completion
+ * without contending on the internal mutex.
+ */
+class Latch
+{
+public:
+    /**
+     * Constructs a Latch that is released after `count` calls to CountDown().
+     *
+     * @param count The initial value of the counter.
+     */
+    explicit Latch(ptrdiff_t count)
+        : count_(count)
+    {
+    }
+
+    Latch(const Latch &) = delete;
+    Latch &operator=(const Latch &) = delete;
+
+    /**
+     * Decrements the counter, waking up every waiting thread once it reaches zero.
+     *
+     * @param n The value to subtract from the counter.
+     */
+    void CountDown(ptrdiff_t n = 1)
+    {
+        if (count_.fetch_sub(n, std::memory_order_acq_rel) == n)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            cv_.notify_all();
+        }
+    }
+
+    /**
+     * @return true if the counter has reached zero.
+     */
+    bool TryWait() const noexcept
+    {
+        return count_.load(std::memory_order_acquire) <= 0;
+    }
+
+    /**
+     * Blocks until the counter reaches zero.
+     */
+    void Wait()
+    {
+        if (TryWait())
+        {
+            return;
+        }
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this]() { return TryWait(); });
+    }
+
+private:
+    std::atomic<ptrdiff_t> count_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+};
+} // namespace shkwon
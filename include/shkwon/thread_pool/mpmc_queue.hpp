@@ -0,0 +1,177 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace shkwon
+{
+/**
+ * A lock-free bounded multi-producer/multi-consumer queue (Dmitry Vyukov's algorithm).
+ *
+ * Every cell carries a sequence number that tells producers and consumers whether the cell is free for the current lap
+ * of the ring, so a push or pop is a single compare-and-swap on the shared position in the common case. The enqueue
+ * and dequeue positions live on separate cache lines so that producers and consumers do not false-share.
+ */
+template <class T>
+class BoundedMpmcQueue
+{
+public:
+    /**
+     * Constructs a queue that can hold at least `capacity` elements.
+     *
+     * @param capacity The minimum capacity. It is rounded up to a power of two of at least 2.
+     */
+    explicit BoundedMpmcQueue(size_t capacity)
+        : mask_(RoundUpToPowerOfTwo(capacity) - 1)
+        , enqueue_pos_(0)
+        , dequeue_pos_(0)
+    {
+        buffer_.reset(new Cell[mask_ + 1]);
+        for (size_t i = 0; i <= mask_; ++i)
+        {
+            buffer_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    BoundedMpmcQueue(const BoundedMpmcQueue &) = delete;
+    BoundedMpmcQueue &operator=(const BoundedMpmcQueue &) = delete;
+
+    ~BoundedMpmcQueue()
+    {
+        auto end = enqueue_pos_.load(std::memory_order_relaxed);
+        for (auto pos = dequeue_pos_.load(std::memory_order_relaxed); pos != end; ++pos)
+        {
+            buffer_[pos & mask_].Get()->~T();
+        }
+    }
+
+    /**
+     * Pushes a value if there is free space. The argument is left untouched when the queue is full.
+     *
+     * @param value The value to push.
+     * @return true if the value was pushed, false if the queue was full.
+     */
+    template <class U>
+    bool TryPush(U &&value)
+    {
+        Cell *cell;
+        size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+        while (true)
+        {
+            cell = &buffer_[pos & mask_];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+            if (diff == 0)
+            {
+                if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false;
+            }
+            else
+            {
+                pos = enqueue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+
+        ::new (&cell->storage) T(std::forward<U>(value));
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Pops the oldest value if there is one.
+     *
+     * @param value Receives the popped value.
+     * @return true if a value was popped, false if the queue was empty.
+     */
+    bool TryPop(T &value)
+    {
+        Cell *cell;
+        size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+        while (true)
+        {
+            cell = &buffer_[pos & mask_];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0)
+            {
+                if (dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false;
+            }
+            else
+            {
+                pos = dequeue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+
+        value = std::move(*cell->Get());
+        cell->Get()->~T();
+        cell->sequence.store(pos + mask_ + 1, std::memory_order_release);
+        return true;
+    }
+
+    size_t GetCapacity() const noexcept
+    {
+        return mask_ + 1;
+    }
+
+    /**
+     * @return The number of queued elements. Only a snapshot while other threads are pushing or popping.
+     */
+    size_t GetSizeApprox() const noexcept
+    {
+        auto dequeue_pos = dequeue_pos_.load(std::memory_order_relaxed);
+        auto enqueue_pos = enqueue_pos_.load(std::memory_order_relaxed);
+        return (enqueue_pos > dequeue_pos) ? enqueue_pos - dequeue_pos : 0;
+    }
+
+private:
+    static constexpr size_t kCacheLineSize = 64;
+
+    struct Cell
+    {
+        T *Get() noexcept
+        {
+            return reinterpret_cast<T *>(&storage);
+        }
+
+        std::atomic<size_t> sequence;
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+    };
+
+    static size_t RoundUpToPowerOfTwo(size_t value)
+    {
+        size_t result = 2;
+        while (result < value)
+        {
+            result <<= 1;
+        }
+        return result;
+    }
+
+    char pad0_[kCacheLineSize];
+    std::unique_ptr<Cell[]> buffer_;
+    size_t mask_;
+    char pad1_[kCacheLineSize - sizeof(std::unique_ptr<Cell[]>) - sizeof(size_t)];
+    std::atomic<size_t> enqueue_pos_;
+    char pad2_[kCacheLineSize - sizeof(std::atomic<size_t>)];
+    std::atomic<size_t> dequeue_pos_;
+    char pad3_[kCacheLineSize - sizeof(std::atomic<size_t>)];
+};
+} // namespace shkwon
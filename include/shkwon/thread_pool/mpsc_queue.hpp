@@ -0,0 +1,185 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+namespace shkwon
+{
+/**
+ * An unbounded lock-free multi-producer/single-consumer queue (Dmitry Vyukov's intrusive algorithm).
+ *
+ * A push is a single exchange on the back of the queue followed by a store, so producers never wait for each other or
+ * for the consumer. The consumer owns the front and pops without any atomic read-modify-write. Every element lives in
+ * its own heap node.
+ *
+ * A producer that has done its exchange but not its store yet hides everything pushed after it until it finishes; the
+ * consumer then sees the queue as not empty but cannot pop, and simply tries again later.
+ */
+template <class T>
+class MpscQueue
+{
+public:
+    MpscQueue()
+        : back_(&stub_)
+        , front_(&stub_)
+    {
+    }
+
+    MpscQueue(const MpscQueue &) = delete;
+    MpscQueue &operator=(const MpscQueue &) = delete;
+
+    ~MpscQueue()
+    {
+        T value;
+        while (TryPop(value))
+        {
+        }
+    }
+
+    /**
+     * Pushes a value. Safe to call from any number of threads at once.
+     */
+    template <class U>
+    void Push(U &&value)
+    {
+        PushNode(new Node(std::forward<U>(value)));
+    }
+
+    /**
+     * Pushes every value in [first, last) with a single exchange, so that they stay together in the queue and producers
+     * pay for the shared back once per batch. Safe to call from any number of threads at once.
+     *
+     * @param first The first value to push.
+     * @param last One past the last value to push.
+     */
+    template <class InputIt>
+    void PushBatch(InputIt first, InputIt last)
+    {
+        Link *head = nullptr;
+        Link *tail = nullptr;
+        try
+        {
+            for (; first != last; ++first)
+            {
+                auto *node = new Node(*first);
+                if (tail == nullptr)
+                {
+                    head = node;
+                }
+                else
+                {
+                    tail->next.store(node, std::memory_order_relaxed);
+                }
+                tail = node;
+            }
+        }
+        catch (...)
+        {
+            while (head != nullptr)
+            {
+                auto *next = head->next.load(std::memory_order_relaxed);
+                delete static_cast<Node *>(head);
+                head = next;
+            }
+            throw;
+        }
+
+        if (head == nullptr)
+        {
+            return;
+        }
+        // The chain is published by the release store below, like a single node.
+        auto *prev = back_.exchange(tail, std::memory_order_seq_cst);
+        prev->next.store(head, std::memory_order_release);
+    }
+
+    /**
+     * Pops the oldest value. Only one thread may pop.
+     *
+     * @param value Receives the value.
+     * @return false if the queue is empty, or if the next value is still being pushed.
+     */
+    bool TryPop(T &value)
+    {
+        auto *front = front_;
+        auto *next = front->next.load(std::memory_order_acquire);
+        if (front == &stub_)
+        {
+            if (next == nullptr)
+            {
+                return false;
+            }
+            front_ = next;
+            front = next;
+            next = next->next.load(std::memory_order_acquire);
+        }
+
+        if (next == nullptr)
+        {
+            if (front != back_.load(std::memory_order_seq_cst))
+            {
+                // A producer is between its exchange and its store.
+                return false;
+            }
+
+            // `front` is the last node. Put the stub behind it so that it can be handed out.
+            PushNode(&stub_);
+            next = front->next.load(std::memory_order_acquire);
+            if (next == nullptr)
+            {
+                return false;
+            }
+        }
+
+        front_ = next;
+        auto *node = static_cast<Node *>(front);
+        value = std::move(node->value);
+        delete node;
+        return true;
+    }
+
+    /**
+     * Tells whether anything has been pushed that has not been popped yet, including pushes still in progress. Only the
+     * consuming thread may call this.
+     */
+    bool IsEmpty() const
+    {
+        return front_ == &stub_ && back_.load(std::memory_order_seq_cst) == &stub_;
+    }
+
+private:
+    struct Link
+    {
+        std::atomic<Link *> next{ nullptr };
+    };
+
+    struct Node : Link
+    {
+        template <class U>
+        explicit Node(U &&init)
+            : value(std::forward<U>(init))
+        {
+        }
+
+        T value;
+    };
+
+    void PushNode(Link *node)
+    {
+        node->next.store(nullptr, std::memory_order_relaxed);
+        auto *prev = back_.exchange(node, std::memory_order_seq_cst);
+        prev->next.store(node, std::memory_order_release);
+    }
+
+    static constexpr size_t kCacheLineSize = 64;
+
+    // Producers exchange on the back; the consumer walks from the front. The stub keeps the list from ever being empty.
+    // The padding keeps the two ends on separate cache lines.
+    char pad0_[kCacheLineSize];
+    std::atomic<Link *> back_;
+    char pad1_[kCacheLineSize - sizeof(std::atomic<Link *>)];
+    Link *front_;
+    Link stub_;
+};
+} // namespace shkwon
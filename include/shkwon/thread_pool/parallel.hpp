@@ -0,0 +1,197 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <vector>
+
+#include "shkwon/thread_pool/latch.hpp"
+
+namespace shkwon
+{
+namespace detail
+{
+/**
+ * Shared state of one ParallelFor/ParallelReduce call.
+ *
+ * Chunks are handed out through an atomic counter, so the calling thread and every helper job keep pulling chunks
+ * until none are left. The latch counts finished chunks rather than helpers, which means the caller never waits for a
+ * helper that has not started yet; it may not even start before the caller returns, which is why this state is
+ * reference counted and the chunk function is only touched while chunks remain.
+ */
+template <class ChunkFunction>
+class ChunkedJob
+{
+public:
+    ChunkedJob(size_t num_chunks, ChunkFunction &chunk_fn)
+        : num_chunks_(num_chunks)
+        , next_chunk_(0)
+        , finished_(static_cast<ptrdiff_t>(num_chunks))
+        , chunk_fn_(&chunk_fn)
+        , failed_(false)
+    {
+    }
+
+    void Run()
+    {
+        size_t chunk;
+        while ((chunk = next_chunk_.fetch_add(1, std::memory_order_relaxed)) < num_chunks_)
+        {
+            try
+            {
+                // Skip the remaining chunks once any of them failed.
+                if (!failed_.load(std::memory_order_relaxed))
+                {
+                    (*chunk_fn_)(chunk);
+                }
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(error_mtx_);
+                if (!error_)
+                {
+                    error_ = std::current_exception();
+                    failed_.store(true, std::memory_order_relaxed);
+                }
+            }
+            finished_.CountDown();
+        }
+    }
+
+    void Wait()
+    {
+        finished_.Wait();
+        if (error_)
+        {
+            std::rethrow_exception(error_);
+        }
+    }
+
+private:
+    size_t num_chunks_;
+    std::atomic<size_t> next_chunk_;
+    Latch finished_;
+    ChunkFunction *chunk_fn_;
+
+    std::atomic<bool> failed_;
+    std::mutex error_mtx_;
+    std::exception_ptr error_;
+};
+
+template <class Pool, class ChunkFunction>
+void RunChunks(Pool &pool, size_t num_chunks, ChunkFunction &chunk_fn)
+{
+    if (num_chunks == 0)
+    {
+        return;
+    }
+
+    auto job = std::make_shared<ChunkedJob<ChunkFunction>>(num_chunks, chunk_fn);
+    auto helper = [job]() { job->Run(); };
+    std::vector<decltype(helper)> helpers(std::min(num_chunks - 1, pool.GetNumThreads()), helper);
+    pool.PushBatch(helpers.begin(), helpers.end());
+
+    // The calling thread works on chunks too, so this is safe to call from one of the pool's own workers.
+    job->Run();
+    job->Wait();
+}
+
+template <class Pool, class Index>
+size_t ChunkCount(const Pool &pool, Index begin, Index end, Index &grain)
+{
+    static_assert(std::is_integral<Index>::value, "ParallelFor/ParallelReduce need an integral index type");
+
+    if (end <= begin)
+    {
+        return 0;
+    }
+
+    auto count = static_cast<size_t>(end - begin);
+    if (grain <= 0)
+    {
+        // Roughly four chunks per worker leaves room for load balancing without making the chunks too small. An elastic
+        // pool may currently have no workers at all.
+        grain = static_cast<Index>(std::max<size_t>(1, count / (4 * std::max<size_t>(1, pool.GetNumThreads()))));
+    }
+
+    auto chunk_size = static_cast<size_t>(grain);
+    return (count + chunk_size - 1) / chunk_size;
+}
+} // namespace detail
+
+/**
+ * Calls `fn(i)` for every i in [begin, end), splitting the range into contiguous chunks run on the pool.
+ *
+ * The calling thread takes part in the work and returns once every chunk is done. If `fn` throws, the remaining chunks
+ * are skipped and the first exception is rethrown in the calling thread.
+ *
+ * @param pool The pool to run the chunks on. Any pool with PushBatch() and GetNumThreads() works.
+ * @param begin The first index.
+ * @param end One past the last index.
+ * @param grain The number of indices per chunk. Zero or less picks a size based on the number of workers.
+ * @param fn The function to call for each index.
+ */
+template <class Pool, class Index, class Function>
+void ParallelFor(Pool &pool, Index begin, Index end, Index grain, Function &&fn)
+{
+    size_t num_chunks = detail::ChunkCount(pool, begin, end, grain);
+    auto chunk_fn = [&](size_t chunk) {
+        Index chunk_begin = begin + static_cast<Index>(chunk) * grain;
+        Index chunk_end = (end - chunk_begin > grain) ? chunk_begin + grain : end;
+        for (Index i = chunk_begin; i < chunk_end; ++i)
+        {
+            fn(i);
+        }
+    };
+    detail::RunChunks(pool, num_chunks, chunk_fn);
+}
+
+/**
+ * Folds `fn(i)` for every i in [begin, end) with `reduce`, splitting the range into contiguous chunks run on the pool.
+ *
+ * Each chunk is folded starting from `identity`, and the per-chunk results are then folded in index order on the
+ * calling thread, so `reduce` only needs to be associative, not commutative.
+ *
+ * @param pool The pool to run the chunks on. Any pool with PushBatch() and GetNumThreads() works.
+ * @param begin The first index.
+ * @param end One past the last index.
+ * @param grain The number of indices per chunk. Zero or less picks a size based on the number of workers.
+ * @param identity The identity element of `reduce`.
+ * @param fn The function mapping an index to a value.
+ * @param reduce The function combining two values.
+ *
+ * @return The reduced value, or `identity` if the range is empty.
+ */
+template <class Pool, class Index, class T, class Function, class Reduce>
+T ParallelReduce(Pool &pool, Index begin, Index end, Index grain, T identity, Function &&fn, Reduce &&reduce)
+{
+    size_t num_chunks = detail::ChunkCount(pool, begin, end, grain);
+    // Wrapped so that std::vector<bool> cannot pack neighbouring chunks' results into the same word.
+    struct Partial
+    {
+        T value;
+    };
+    std::vector<Partial> partials(num_chunks, Partial{ identity });
+    auto chunk_fn = [&](size_t chunk) {
+        Index chunk_begin = begin + static_cast<Index>(chunk) * grain;
+        Index chunk_end = (end - chunk_begin > grain) ? chunk_begin + grain : end;
+        T partial = identity;
+        for (Index i = chunk_begin; i < chunk_end; ++i)
+        {
+            partial = reduce(std::move(partial), fn(i));
+        }
+        partials[chunk].value = std::move(partial);
+    };
+    detail::RunChunks(pool, num_chunks, chunk_fn);
+
+    T result = std::move(identity);
+    for (auto &partial : partials)
+    {
+        result = reduce(std::move(result), std::move(partial.value));
+    }
+    return result;
+}
+} // namespace shkwon
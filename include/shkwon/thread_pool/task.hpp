@@ -0,0 +1,256 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace shkwon
+{
+/**
+ * A move-only, type-erased `void()` callable with small buffer optimization.
+ *
+ * Callables up to kInlineSize bytes that are nothrow move constructible are stored inline, so wrapping a typical
+ * lambda (or a std::packaged_task) costs no heap allocation. Larger callables fall back to a single heap allocation.
+ * Unlike std::function, move-only callables are accepted.
+ */
+class Task
+{
+public:
+    static constexpr size_t kInlineSize = 48;
+
+    Task() noexcept
+        : ops_(nullptr)
+    {
+    }
+
+    template <class F, class = typename std::enable_if<!std::is_same<typename std::decay<F>::type, Task>::value>::type>
+    Task(F &&f)
+        : ops_(nullptr)
+    {
+        using Callable = typename std::decay<F>::type;
+        using Storage = typename std::conditional<IsInlinable<Callable>::value, InlineOps<Callable>,
+                                                  HeapOps<Callable>>::type;
+        Storage::Construct(storage_, std::forward<F>(f));
+        ops_ = &Storage::kOps;
+    }
+
+    Task(Task &&other) noexcept
+        : ops_(other.ops_)
+    {
+        if (ops_ != nullptr)
+        {
+            ops_->move(storage_, other.storage_);
+            other.ops_ = nullptr;
+        }
+    }
+
+    Task &operator=(Task &&other) noexcept
+    {
+        if (this != &other)
+        {
+            Reset();
+            if (other.ops_ != nullptr)
+            {
+                other.ops_->move(storage_, other.storage_);
+                ops_ = other.ops_;
+                other.ops_ = nullptr;
+            }
+        }
+        return *this;
+    }
+
+    Task(const Task &) = delete;
+    Task &operator=(const Task &) = delete;
+
+    ~Task()
+    {
+        Reset();
+    }
+
+    explicit operator bool() const noexcept
+    {
+        return ops_ != nullptr;
+    }
+
+    void operator()()
+    {
+        ops_->invoke(storage_);
+    }
+
+    /**
+     * Destroys the stored callable, leaving the task empty.
+     */
+    void Reset() noexcept
+    {
+        if (ops_ != nullptr)
+        {
+            ops_->destroy(storage_);
+            ops_ = nullptr;
+        }
+    }
+
+private:
+    struct Ops
+    {
+        void (*invoke)(void *storage);
+        void (*move)(void *dst, void *src) noexcept;
+        void (*destroy)(void *storage) noexcept;
+    };
+
+    template <class F>
+    struct IsInlinable
+        : std::integral_constant<bool, sizeof(F) <= kInlineSize && alignof(F) <= alignof(std::max_align_t) &&
+                                           std::is_nothrow_move_constructible<F>::value>
+    {
+    };
+
+    template <class F>
+    struct InlineOps
+    {
+        template <class G>
+        static void Construct(void *storage, G &&f)
+        {
+            ::new (storage) F(std::forward<G>(f));
+        }
+        static void Invoke(void *storage)
+        {
+            (*static_cast<F *>(storage))();
+        }
+        static void Move(void *dst, void *src) noexcept
+        {
+            ::new (dst) F(std::move(*static_cast<F *>(src)));
+            static_cast<F *>(src)->~F();
+        }
+        static void Destroy(void *storage) noexcept
+        {
+            static_cast<F *>(storage)->~F();
+        }
+
+        static const Ops kOps;
+    };
+
+    template <class F>
+    struct HeapOps
+    {
+        template <class G>
+        static void Construct(void *storage, G &&f)
+        {
+            ::new (storage) F *(new F(std::forward<G>(f)));
+        }
+        static void Invoke(void *storage)
+        {
+            (**static_cast<F **>(storage))();
+        }
+        static void Move(void *dst, void *src) noexcept
+        {
+            ::new (dst) F *(*static_cast<F **>(src));
+        }
+        static void Destroy(void *storage) noexcept
+        {
+            delete *static_cast<F **>(storage);
+        }
+
+        static const Ops kOps;
+    };
+
+    alignas(std::max_align_t) unsigned char storage_[kInlineSize];
+    const Ops *ops_;
+};
+
+template <class F>
+const Task::Ops Task::InlineOps<F>::kOps = { &InlineOps<F>::Invoke, &InlineOps<F>::Move, &InlineOps<F>::Destroy };
+
+template <class F>
+const Task::Ops Task::HeapOps<F>::kOps = { &HeapOps<F>::Invoke, &HeapOps<F>::Move, &HeapOps<F>::Destroy };
+
+/**
+ * Binds a callable and its arguments into a Task.
+ */
+template <class F, class... Args>
+Task BindTask(F &&f, Args &&...args)
+{
+    return Task(std::bind(std::forward<F>(f), std::forward<Args>(args)...));
+}
+
+/**
+ * Passes a Task on as it is. Wrapping it in another Task would not fit into the inline buffer and cost an allocation.
+ */
+inline Task BindTask(Task &&task) noexcept
+{
+    return std::move(task);
+}
+
+/**
+ * A double-ended queue backed by a growable power-of-two ring buffer.
+ *
+ * The buffer only grows, so once a queue has reached its working size, pushing and popping never allocate. This is
+ * not thread-safe; callers are expected to guard it with their own lock. T must be default constructible and move
+ * assignable.
+ */
+template <class T>
+class RingDeque
+{
+public:
+    RingDeque()
+        : head_(0)
+        , size_(0)
+    {
+    }
+
+    bool empty() const noexcept
+    {
+        return size_ == 0;
+    }
+
+    size_t size() const noexcept
+    {
+        return size_;
+    }
+
+    void push_back(T value)
+    {
+        if (size_ == buffer_.size())
+        {
+            Grow();
+        }
+        buffer_[(head_ + size_) & (buffer_.size() - 1)] = std::move(value);
+        ++size_;
+    }
+
+    T pop_front() noexcept
+    {
+        T value = std::move(buffer_[head_]);
+        head_ = (head_ + 1) & (buffer_.size() - 1);
+        --size_;
+        return value;
+    }
+
+    T pop_back() noexcept
+    {
+        --size_;
+        return std::move(buffer_[(head_ + size_) & (buffer_.size() - 1)]);
+    }
+
+private:
+    void Grow()
+    {
+        std::vector<T> grown(buffer_.empty() ? 16 : buffer_.size() * 2);
+        for (size_t i = 0; i < size_; ++i)
+        {
+            grown[i] = std::move(buffer_[(head_ + i) & (buffer_.size() - 1)]);
+        }
+        buffer_.swap(grown);
+        head_ = 0;
+    }
+
+    std::vector<T> buffer_;
+    size_t head_;
+    size_t size_;
+};
+
+using TaskDeque = RingDeque<Task>;
+} // namespace shkwon
@@ -0,0 +1,187 @@
+#pragma once
+
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "shkwon/thread_pool/future.hpp"
+
+namespace shkwon
+{
+/**
+ * A set of jobs with dependencies between them, run on a pool without any thread blocking on a dependency.
+ *
+ * A job is only scheduled once every job it depends on has finished, by whichever worker finished the last of them.
+ * Dependencies can only name jobs that were added earlier, so a graph can never contain a cycle.
+ *
+ * @code
+ * TaskGraph graph;
+ * auto load = graph.Add([]() { ... });
+ * auto parse = graph.Add([]() { ... }, { load });
+ * auto index = graph.Add([]() { ... }, { load });
+ * graph.Add([]() { ... }, { parse, index });
+ * graph.Run(pool).Get();
+ * @endcode
+ */
+class TaskGraph
+{
+public:
+    using NodeId = size_t;
+
+    /**
+     * Adds a job to the graph.
+     *
+     * @param fn The job. It is copied for every Run().
+     * @param dependencies The jobs that have to finish before this one starts.
+     *
+     * @return The id to pass as a dependency of later jobs.
+     */
+    NodeId Add(std::function<void()> fn, const std::vector<NodeId> &dependencies = {})
+    {
+        NodeId id = nodes_.size();
+        for (NodeId dependency : dependencies)
+        {
+            if (dependency >= id)
+            {
+                throw std::out_of_range("TaskGraph dependency does not name an earlier job.");
+            }
+        }
+
+        nodes_.push_back(Node{ std::move(fn), {}, dependencies.size() });
+        for (NodeId dependency : dependencies)
+        {
+            nodes_[dependency].successors.push_back(id);
+        }
+        return id;
+    }
+
+    size_t GetSize() const noexcept
+    {
+        return nodes_.size();
+    }
+
+    /**
+     * Runs every job in the graph on `executor`.
+     *
+     * The graph is copied, so it may be changed, run again or destroyed while the run is in progress. Once a job
+     * throws, the jobs that have not started yet are skipped and the returned future fails with the first exception.
+     *
+     * @param executor Where the jobs run.
+     * @return A future that becomes ready once every job has finished or been skipped.
+     */
+    Future<void> Run(const Executor &executor) const
+    {
+        auto run = std::make_shared<RunState>(nodes_, executor);
+        auto done = run->promise.GetFuture();
+        if (nodes_.empty())
+        {
+            run->promise.SetValue();
+            return done;
+        }
+
+        for (NodeId id = 0; id < nodes_.size(); ++id)
+        {
+            if (nodes_[id].num_dependencies == 0)
+            {
+                Schedule(run, id);
+            }
+        }
+        return done;
+    }
+
+private:
+    struct Node
+    {
+        std::function<void()> fn;
+        std::vector<NodeId> successors;
+        size_t num_dependencies;
+    };
+
+    struct RunState
+    {
+        RunState(const std::vector<Node> &graph, const Executor &pool)
+            : nodes(graph)
+            , remaining(new std::atomic<size_t>[graph.size()])
+            , unfinished(graph.size())
+            , executor(pool)
+            , promise(pool)
+            , failed(false)
+        {
+            for (size_t i = 0; i < nodes.size(); ++i)
+            {
+                remaining[i].store(nodes[i].num_dependencies, std::memory_order_relaxed);
+            }
+        }
+
+        std::vector<Node> nodes;
+        // Unfinished dependencies per job.
+        std::unique_ptr<std::atomic<size_t>[]> remaining;
+        std::atomic<size_t> unfinished;
+        Executor executor;
+        Promise<void> promise;
+
+        std::atomic<bool> failed;
+        std::mutex error_mtx;
+        std::exception_ptr error;
+    };
+
+    static void Schedule(const std::shared_ptr<RunState> &run, NodeId id)
+    {
+        run->executor.Execute([run, id]() { RunNode(run, id); });
+    }
+
+    static void RunNode(const std::shared_ptr<RunState> &run, NodeId id)
+    {
+        auto &node = run->nodes[id];
+        try
+        {
+            if (!run->failed.load(std::memory_order_relaxed))
+            {
+                node.fn();
+            }
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(run->error_mtx);
+            if (!run->error)
+            {
+                run->error = std::current_exception();
+                run->failed.store(true, std::memory_order_relaxed);
+            }
+        }
+
+        // Skipped jobs still release their successors, so that every job is accounted for and the run completes.
+        for (NodeId successor : node.successors)
+        {
+            if (run->remaining[successor].fetch_sub(1, std::memory_order_acq_rel) == 1)
+            {
+                Schedule(run, successor);
+            }
+        }
+
+        if (run->unfinished.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            std::exception_ptr error;
+            {
+                std::lock_guard<std::mutex> lock(run->error_mtx);
+                error = run->error;
+            }
+            if (error)
+            {
+                run->promise.SetException(error);
+            }
+            else
+            {
+                run->promise.SetValue();
+            }
+        }
+    }
+
+    std::vector<Node> nodes_;
+};
+} // namespace shkwon
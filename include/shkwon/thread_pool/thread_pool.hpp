@@ -1,41 +1,177 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <functional>
 #include <future>
+#include <list>
+#include <memory>
 #include <mutex>
-#include <queue>
+#include <stdexcept>
+#include <string>
 #include <thread>
 #include <vector>
 
+#include "shkwon/debug/tracer.hpp"
+#include "shkwon/status/status.hpp"
+#include "shkwon/thread_pool/cpu_relax.hpp"
+#include "shkwon/thread_pool/idle_strategy.hpp"
+#include "shkwon/thread_pool/mpmc_queue.hpp"
+#include "shkwon/thread_pool/task.hpp"
+#include "shkwon/thread_pool/thread_pool_error_code.hpp"
+#include "shkwon/thread_pool/thread_pool_metrics.hpp"
+#include "shkwon/thread_pool/thread_pool_options.hpp"
+#include "shkwon/thread_pool/worker_placement.hpp"
+
 namespace shkwon
 {
-class ThreadPool
+/**
+ * A thread pool whose workers share one set of priority-lane queues. Use it through the ThreadPool and
+ * InstrumentedThreadPool aliases.
+ *
+ * @tparam Metrics The metrics policy, NoThreadPoolMetrics or ThreadPoolMetrics. See NoThreadPoolMetrics for what a
+ *         policy provides.
+ */
+template <class Metrics>
+class BasicThreadPool
 {
 public:
-    ThreadPool(size_t num_threads)
-        : num_threads_(num_threads)
+    BasicThreadPool(size_t num_threads)
+        : BasicThreadPool(ThreadPoolOptions(num_threads))
+    {
+    }
+    explicit BasicThreadPool(const ThreadPoolOptions &options)
+        : options_(options)
+        , metrics_(GetMaxThreads())
         , stop_all_(false)
+        , live_workers_(0)
+        , pending_jobs_(0)
+        , idle_workers_(0)
+        , blocked_producers_(0)
+        , dropped_jobs_(0)
     {
-        worker_threads_.reserve(num_threads_);
-        for (size_t i = 0; i < num_threads_; ++i)
+        if (options_.queue == ThreadPoolQueue::BoundedLockFree)
+        {
+            for (auto &ring : rings_)
+            {
+                ring.reset(new BoundedMpmcQueue<QueuedTask>(options_.queue_capacity));
+            }
+        }
+
+        // Plan for the largest size the pool can grow to, so that every worker slot has a fixed placement.
+        auto nodes = (options_.numa_placement == NumaPlacement::None) ? std::vector<NumaNode>() : GetNumaNodes();
+        auto plan_options = options_;
+        plan_options.num_threads = GetMaxThreads();
+        placements_ = PlanWorkerPlacement(plan_options, nodes);
+        try
+        {
+            {
+                std::lock_guard<std::mutex> lock(mtx_workers_);
+                for (size_t i = 0; i < options_.num_threads; ++i)
+                {
+                    SpawnWorker();
+                }
+            }
+            if (IsElastic())
+            {
+                supervisor_ = std::thread([this]() { this->SupervisorThread(); });
+            }
+        }
+        catch (...)
         {
-            worker_threads_.emplace_back([this]() { this->WorkerThread(); });
+            Shutdown();
+            throw;
         }
     }
-    ~ThreadPool()
+    ~BasicThreadPool()
     {
-        stop_all_ = true;
-        cv_job_q_.notify_all();
+        Shutdown();
+    }
+
+    template <class F, class... Args>
+    std::future<typename std::result_of<F(Args...)>::type> Push(F &&f, Args &&...args)
+    {
+        if (stop_all_)
+        {
+            throw std::runtime_error("ThreadPool 사용 중지됨");
+        }
 
-        for (auto &t : worker_threads_)
+        using return_type = typename std::result_of<F(Args...)>::type;
+        std::packaged_task<return_type()> job(std::bind(std::forward<F>(f), std::forward<Args>(args)...));
+        std::future<return_type> job_result_future = job.get_future();
+        if (!Enqueue(Task(std::move(job))))
         {
-            t.join();
+            throw std::runtime_error("ThreadPool 작업 큐 가득 참");
         }
+
+        return job_result_future;
     }
 
+    /**
+     * Submits a job without creating a future for its result.
+     *
+     * Small callables are stored inline in the queued Task, so a fire-and-forget job does not allocate once the queue
+     * has grown to its working size. Exceptions thrown by the job are not caught and terminate the program.
+     *
+     * @param f The callable to execute.
+     * @param args The arguments bound to the callable.
+     */
     template <class F, class... Args>
-    std::future<typename std::result_of<F(Args...)>::type> Push(F &&f, Args &&...args)
+    typename std::enable_if<!std::is_same<typename std::decay<F>::type, JobOptions>::value>::type Post(F &&f,
+                                                                                                      Args &&...args)
+    {
+        if (stop_all_)
+        {
+            throw std::runtime_error("ThreadPool 사용 중지됨");
+        }
+
+        if (!Enqueue(BindTask(std::forward<F>(f), std::forward<Args>(args)...)))
+        {
+            throw std::runtime_error("ThreadPool 작업 큐 가득 참");
+        }
+    }
+
+    /**
+     * Submits a job without creating a future for its result, reporting failures instead of throwing.
+     *
+     * @param f The callable to execute.
+     * @param args The arguments bound to the callable.
+     *
+     * @return ThreadPoolErrorCode::QueueFull if the bounded queue is full and the pool uses Backpressure::Reject,
+     *         ThreadPoolErrorCode::Stopped if the pool is shutting down, a successful status otherwise.
+     */
+    template <class F, class... Args>
+    typename std::enable_if<!std::is_same<typename std::decay<F>::type, JobOptions>::value, Status>::type TryPost(
+        F &&f, Args &&...args)
+    {
+        if (stop_all_)
+        {
+            return Status(ThreadPoolErrorCode::Stopped, StaticMessage("ThreadPool is stopped"));
+        }
+
+        if (!Enqueue(BindTask(std::forward<F>(f), std::forward<Args>(args)...)))
+        {
+            return Status(ThreadPoolErrorCode::QueueFull, StaticMessage("ThreadPool job queue is full"));
+        }
+        return Status(ThreadPoolErrorCode::Success);
+    }
+
+    /**
+     * Submits a job with a priority and/or a deadline. See JobOptions.
+     *
+     * Jobs with the default options take the same path as Push(f, args...). A job with a deadline is wrapped in a
+     * deadline check, which may not fit into the Task's inline buffer.
+     *
+     * @param job_options The priority lane and deadline of the job.
+     * @param f The callable to execute.
+     * @param args The arguments bound to the callable.
+     *
+     * @return A future for the result of the job.
+     */
+    template <class F, class... Args>
+    std::future<typename std::result_of<F(Args...)>::type> Push(const JobOptions &job_options, F &&f, Args &&...args)
     {
         if (stop_all_)
         {
@@ -43,43 +179,617 @@ public:
         }
 
         using return_type = typename std::result_of<F(Args...)>::type;
-        auto job = std::make_shared<std::packaged_task<return_type()>>(
-            std::bind(std::forward<F>(f), std::forward<Args>(args)...));
-        std::future<return_type> job_result_future = job->get_future();
+        std::packaged_task<return_type()> job(std::bind(std::forward<F>(f), std::forward<Args>(args)...));
+        std::future<return_type> job_result_future = job.get_future();
+        if (!Enqueue(WithDeadline(Task(std::move(job)), job_options), job_options.priority))
         {
-            std::lock_guard<std::mutex> lock(mtx_job_q_);
-            jobs_.push([job]() { (*job)(); });
+            throw std::runtime_error("ThreadPool 작업 큐 가득 참");
         }
-        cv_job_q_.notify_one();
 
         return job_result_future;
     }
 
+    /**
+     * Submits a fire-and-forget job with a priority and/or a deadline. See JobOptions.
+     *
+     * @param job_options The priority lane and deadline of the job.
+     * @param f The callable to execute.
+     * @param args The arguments bound to the callable.
+     */
+    template <class F, class... Args>
+    void Post(const JobOptions &job_options, F &&f, Args &&...args)
+    {
+        if (stop_all_)
+        {
+            throw std::runtime_error("ThreadPool 사용 중지됨");
+        }
+
+        Task job = BindTask(std::forward<F>(f), std::forward<Args>(args)...);
+        if (!Enqueue(WithDeadline(std::move(job), job_options), job_options.priority))
+        {
+            throw std::runtime_error("ThreadPool 작업 큐 가득 참");
+        }
+    }
+
+    /**
+     * Submits a fire-and-forget job with a priority and/or a deadline, reporting failures instead of throwing. See
+     * TryPost(f, args...) and JobOptions.
+     *
+     * @param job_options The priority lane and deadline of the job.
+     * @param f The callable to execute.
+     * @param args The arguments bound to the callable.
+     *
+     * @return The same statuses as TryPost(f, args...).
+     */
+    template <class F, class... Args>
+    Status TryPost(const JobOptions &job_options, F &&f, Args &&...args)
+    {
+        if (stop_all_)
+        {
+            return Status(ThreadPoolErrorCode::Stopped, StaticMessage("ThreadPool is stopped"));
+        }
+
+        Task job = BindTask(std::forward<F>(f), std::forward<Args>(args)...);
+        if (!Enqueue(WithDeadline(std::move(job), job_options), job_options.priority))
+        {
+            return Status(ThreadPoolErrorCode::QueueFull, StaticMessage("ThreadPool job queue is full"));
+        }
+        return Status(ThreadPoolErrorCode::Success);
+    }
+
+    /**
+     * Submits every callable in [first, last) as a fire-and-forget job.
+     *
+     * With the unbounded queue, all jobs are queued under a single lock acquisition, and only as many sleeping workers
+     * as there are new jobs are woken up. With the bounded queue, every job is subject to the backpressure policy.
+     *
+     * @param first The first callable to submit.
+     * @param last One past the last callable to submit.
+     *
+     * @return The number of jobs queued. Less than the length of the range only with Backpressure::Reject.
+     */
+    template <class InputIt>
+    size_t PushBatch(InputIt first, InputIt last)
+    {
+        if (stop_all_)
+        {
+            throw std::runtime_error("ThreadPool 사용 중지됨");
+        }
+
+        size_t count = 0;
+        size_t idle = 0;
+        if (rings_[0])
+        {
+            for (; first != last && Enqueue(Task(*first)); ++first)
+            {
+                ++count;
+            }
+            return count;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mtx_job_q_);
+            auto &lane = jobs_[static_cast<size_t>(JobPriority::Normal)];
+            for (; first != last; ++first, ++count)
+            {
+                lane.push_back(MakeQueuedTask(Task(*first)));
+            }
+            pending_jobs_.fetch_add(static_cast<int64_t>(count));
+            idle = idle_workers_.load();
+        }
+
+        if (idle == 0)
+        {
+            return count;
+        }
+        if (count >= idle)
+        {
+            cv_job_q_.notify_all();
+            return count;
+        }
+        for (size_t i = 0; i < count; ++i)
+        {
+            cv_job_q_.notify_one();
+        }
+        return count;
+    }
+
+    /**
+     * @return The current number of workers. Changes over time for an elastic pool.
+     */
+    size_t GetNumThreads() const
+    {
+        return live_workers_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @return The number of workers an elastic pool can grow to, or the fixed size of any other pool.
+     */
+    size_t GetMaxThreads() const
+    {
+        return std::max(options_.num_threads, options_.max_threads);
+    }
+
+    /**
+     * @return The number of jobs waiting for a worker. Only a snapshot while jobs are being submitted or run.
+     */
+    size_t GetQueueDepth() const
+    {
+        auto pending = pending_jobs_.load(std::memory_order_relaxed);
+        return (pending > 0) ? static_cast<size_t>(pending) : 0;
+    }
+
+    /**
+     * @return The number of jobs dropped because they had not started by their deadline.
+     */
+    uint64_t GetNumDroppedJobs() const
+    {
+        return dropped_jobs_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Copies the pool's metrics. Only available with a recording metrics policy such as ThreadPoolMetrics, and safe to
+     * call from any thread while the pool is running.
+     *
+     * @return The per-worker counters, the merged histograms, and the current size and queue depth.
+     */
+    ThreadPoolMetricsSnapshot GetMetrics() const
+    {
+        static_assert(Metrics::kEnabled, "GetMetrics() needs a pool with a recording metrics policy");
+
+        auto snapshot = metrics_.Snapshot();
+        snapshot.num_threads = GetNumThreads();
+        snapshot.queue_depth = GetQueueDepth();
+        return snapshot;
+    }
+
 private:
-    void WorkerThread()
+#if defined(SHKWON_ENABLE_TRACING)
+    // Carries the flow from the slice that queued the job to the one that runs it.
+    struct QueuedTask : Metrics::QueuedTask
+    {
+        uint64_t trace_id = 0;
+    };
+#else
+    using QueuedTask = typename Metrics::QueuedTask;
+#endif
+    using Timestamp = typename Metrics::Timestamp;
+
+    struct Worker
+    {
+        explicit Worker(size_t slot)
+            : index(slot)
+            , exited(false)
+        {
+        }
+
+        size_t index;
+        std::thread thread;
+        // Set by the worker once it has left WorkerThread(), so that the supervisor can join it.
+        std::atomic<bool> exited;
+    };
+
+    // How many times a worker has served a higher lane while a lower one had jobs waiting.
+    struct LaneAging
+    {
+        uint32_t passed_over[kNumJobPriorities] = {};
+    };
+
+    Task WithDeadline(Task job, const JobOptions &job_options)
+    {
+        if (job_options.deadline == std::chrono::steady_clock::time_point::max())
+        {
+            return job;
+        }
+
+        return Task([this, deadline = job_options.deadline, job = std::move(job)]() mutable {
+            if (std::chrono::steady_clock::now() > deadline)
+            {
+                dropped_jobs_.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            job();
+        });
+    }
+
+    void Shutdown()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mtx_job_q_);
+            stop_all_ = true;
+        }
+        cv_job_q_.notify_all();
+
+        {
+            std::lock_guard<std::mutex> lock(mtx_workers_);
+        }
+        cv_supervisor_.notify_all();
+        if (supervisor_.joinable())
+        {
+            supervisor_.join();
+        }
+
+        std::lock_guard<std::mutex> lock(mtx_workers_);
+        for (auto &worker : workers_)
+        {
+            worker.thread.join();
+        }
+    }
+
+    bool IsElastic() const
+    {
+        return options_.max_threads > options_.num_threads;
+    }
+
+    // Starts a worker in the lowest free slot. The caller holds mtx_workers_.
+    void SpawnWorker()
+    {
+        size_t index = 0;
+        while (std::any_of(workers_.begin(), workers_.end(), [index](const Worker &w) { return w.index == index; }))
+        {
+            ++index;
+        }
+
+        workers_.emplace_back(index);
+        auto &worker = workers_.back();
+        try
+        {
+            worker.thread = std::thread([this, &worker]() { this->WorkerThread(worker); });
+        }
+        catch (...)
+        {
+            workers_.pop_back();
+            throw;
+        }
+        live_workers_.fetch_add(1);
+        ApplyWorkerPlacement(worker.thread, index, placements_[index], options_);
+    }
+
+    // Joins the workers that retired after their keep-alive ran out. The caller holds mtx_workers_.
+    void ReapWorkers()
     {
+        for (auto it = workers_.begin(); it != workers_.end();)
+        {
+            if (it->exited.load(std::memory_order_acquire))
+            {
+                it->thread.join();
+                it = workers_.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+
+    // Grows an elastic pool. Only samples the job and idle counters, so submissions never pay for resizing.
+    void SupervisorThread()
+    {
+        auto backlog_since = std::chrono::steady_clock::time_point::max();
+        std::unique_lock<std::mutex> lock(mtx_workers_);
+        while (!cv_supervisor_.wait_for(lock, options_.resize_interval, [this]() { return stop_all_.load(); }))
+        {
+            ReapWorkers();
+
+            auto pending = pending_jobs_.load(std::memory_order_relaxed);
+            if (pending <= 0 || idle_workers_.load(std::memory_order_relaxed) > 0)
+            {
+                backlog_since = std::chrono::steady_clock::time_point::max();
+                continue;
+            }
+
+            auto now = std::chrono::steady_clock::now();
+            backlog_since = std::min(backlog_since, now);
+            auto depth = static_cast<size_t>(pending);
+            if (live_workers_.load() > 0 && depth < options_.grow_queue_depth &&
+                now - backlog_since < options_.grow_wait)
+            {
+                continue;
+            }
+
+            // Retiring workers keep their slot until they are reaped, so count slots rather than live workers.
+            size_t grow = std::max<size_t>(1, depth / std::max<size_t>(1, options_.grow_queue_depth));
+            grow = std::min(grow, GetMaxThreads() - workers_.size());
+            try
+            {
+                for (size_t i = 0; i < grow; ++i)
+                {
+                    SpawnWorker();
+                }
+            }
+            catch (...)
+            {
+                // Out of threads or the placement failed. Keep going with the workers we have.
+            }
+            // Give the new workers a chance to catch up before growing again.
+            backlog_since = now;
+        }
+    }
+
+    QueuedTask MakeQueuedTask(Task &&job)
+    {
+        QueuedTask queued;
+        queued.task = std::move(job);
+        metrics_.OnEnqueue(queued);
+#if defined(SHKWON_ENABLE_TRACING)
+        queued.trace_id = Tracer::Get().BeginFlow("job");
+#endif
+        return queued;
+    }
+
+    bool Enqueue(Task &&task, JobPriority priority = JobPriority::Normal)
+    {
+        SHKWON_TRACE_SCOPE("ThreadPool::Push");
+        auto lane = static_cast<size_t>(priority);
+        auto job = MakeQueuedTask(std::move(task));
+        if (!rings_[0])
+        {
+            size_t idle;
+            {
+                std::lock_guard<std::mutex> lock(mtx_job_q_);
+                jobs_[lane].push_back(std::move(job));
+                pending_jobs_.fetch_add(1);
+                idle = idle_workers_.load();
+            }
+            if (idle > 0)
+            {
+                cv_job_q_.notify_one();
+            }
+            return true;
+        }
+
+        auto &ring = *rings_[lane];
+        if (!ring.TryPush(std::move(job)) && !WaitForRoom(ring, job))
+        {
+            return false;
+        }
+
+        // Pairs with the idle_workers_ increment in NextJob: either the sleeping worker sees the new job count, or we
+        // see the sleeper and wake it up.
+        pending_jobs_.fetch_add(1);
+        if (idle_workers_.load() > 0)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mtx_job_q_);
+            }
+            cv_job_q_.notify_one();
+        }
+        return true;
+    }
+
+    // Applies the backpressure policy once a bounded queue turned out to be full.
+    bool WaitForRoom(BoundedMpmcQueue<QueuedTask> &ring, QueuedTask &job)
+    {
+        if (options_.backpressure == Backpressure::Reject)
+        {
+            return false;
+        }
+
+        if (options_.backpressure == Backpressure::SpinThenBlock)
+        {
+            for (uint32_t i = 0; i < options_.backpressure_spin_count; ++i)
+            {
+                CpuRelax();
+                if (ring.TryPush(std::move(job)))
+                {
+                    return true;
+                }
+            }
+        }
+
+        // Pairs with the fence in WakeProducers, the same way pending_jobs_ pairs with idle_workers_.
+        blocked_producers_.fetch_add(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        {
+            std::unique_lock<std::mutex> lock(mtx_job_q_);
+            cv_not_full_.wait(lock, [&ring, &job]() { return ring.TryPush(std::move(job)); });
+        }
+        blocked_producers_.fetch_sub(1);
+        return true;
+    }
+
+    void WakeProducers()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (blocked_producers_.load(std::memory_order_relaxed) > 0)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mtx_job_q_);
+            }
+            // Blocked producers may be waiting on different lanes, so wake them all up to re-check.
+            cv_not_full_.notify_all();
+        }
+    }
+
+    // Pops from the highest non-empty lane, unless a lower lane has been passed over often enough.
+    template <class TryPopLane, class LaneHasJobs>
+    bool DequeueByPriority(LaneAging &aging, TryPopLane &&try_pop, LaneHasJobs &&has_jobs)
+    {
+        if (options_.priority_aging_limit > 0)
+        {
+            for (size_t lane = kNumJobPriorities - 1; lane > 0; --lane)
+            {
+                if (aging.passed_over[lane] >= options_.priority_aging_limit && try_pop(lane))
+                {
+                    aging.passed_over[lane] = 0;
+                    return true;
+                }
+            }
+        }
+
+        for (size_t lane = 0; lane < kNumJobPriorities; ++lane)
+        {
+            if (try_pop(lane))
+            {
+                aging.passed_over[lane] = 0;
+                for (size_t lower = lane + 1; lower < kNumJobPriorities; ++lower)
+                {
+                    if (has_jobs(lower))
+                    {
+                        ++aging.passed_over[lower];
+                    }
+                }
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool TryDequeue(QueuedTask &job, LaneAging &aging)
+    {
+        if (rings_[0])
+        {
+            bool popped = DequeueByPriority(
+                aging, [this, &job](size_t lane) { return rings_[lane]->TryPop(job); },
+                [this](size_t lane) { return rings_[lane]->GetSizeApprox() > 0; });
+            if (!popped)
+            {
+                return false;
+            }
+
+            pending_jobs_.fetch_sub(1);
+            WakeProducers();
+            return true;
+        }
+
+        std::lock_guard<std::mutex> lock(mtx_job_q_);
+        bool popped = DequeueByPriority(
+            aging,
+            [this, &job](size_t lane) {
+                if (jobs_[lane].empty())
+                {
+                    return false;
+                }
+                job = jobs_[lane].pop_front();
+                return true;
+            },
+            [this](size_t lane) { return !jobs_[lane].empty(); });
+        if (!popped)
+        {
+            return false;
+        }
+
+        pending_jobs_.fetch_sub(1);
+        return true;
+    }
+
+    // Blocks until a job is available. Returns false once the pool is stopping and every job has been run, or when an
+    // idle worker of an elastic pool retires.
+    bool NextJob(QueuedTask &job, LaneAging &aging, IdleStrategy &idle, size_t worker)
+    {
+        auto has_work = [this]() { return pending_jobs_.load(std::memory_order_relaxed) > 0 || stop_all_; };
+        bool waited = false;
+        Timestamp idle_since;
         while (true)
         {
+            if (TryDequeue(job, aging))
+            {
+                if (waited)
+                {
+                    metrics_.OnIdleEnd(worker, idle_since);
+                }
+                return true;
+            }
+            if (!waited)
+            {
+                idle_since = metrics_.Now();
+                waited = true;
+            }
+
+            // Poll the job count rather than the queue, so that spinning workers stay off the queue lock.
+            if (!stop_all_ && idle.Wait(has_work))
+            {
+                continue;
+            }
+
             std::unique_lock<std::mutex> lock(mtx_job_q_);
-            cv_job_q_.wait(lock, [this]() { return !jobs_.empty() || stop_all_; });
-            if (stop_all_ && jobs_.empty())
+            if (stop_all_ && pending_jobs_.load() <= 0)
             {
-                return;
+                return false;
             }
 
-            std::function<void()> job = std::move(jobs_.front());
-            jobs_.pop();
-            lock.unlock();
+            auto woken = [this]() { return pending_jobs_.load() > 0 || stop_all_; };
+            idle_workers_.fetch_add(1);
+            bool has_job = true;
+            if (IsElastic())
+            {
+                has_job = cv_job_q_.wait_for(lock, options_.keep_alive, woken);
+            }
+            else
+            {
+                cv_job_q_.wait(lock, woken);
+            }
+            idle_workers_.fetch_sub(1);
 
-            job();
+            // Both the check and the decrement happen under the queue lock, so idle workers cannot all retire at once
+            // and take the pool below num_threads.
+            if (!has_job && live_workers_.load() > options_.num_threads)
+            {
+                live_workers_.fetch_sub(1);
+                return false;
+            }
         }
     }
 
-    size_t num_threads_;
-    bool stop_all_;
-    std::vector<std::thread> worker_threads_;
-    std::queue<std::function<void()>> jobs_;
+    void WorkerThread(Worker &self)
+    {
+        LaneAging aging;
+        IdleStrategy idle(options_.idle_policy, options_.idle_spin_count, options_.idle_yield_count);
+#if defined(SHKWON_ENABLE_TRACING)
+        Tracer::Get().SetThreadName("ThreadPool worker " + std::to_string(self.index));
+#endif
+        while (true)
+        {
+            QueuedTask job;
+            if (!NextJob(job, aging, idle, self.index))
+            {
+                self.exited.store(true, std::memory_order_release);
+                return;
+            }
+
+            auto started = metrics_.OnJobStart(self.index, job);
+            {
+                SHKWON_TRACE_SCOPE("job");
+#if defined(SHKWON_ENABLE_TRACING)
+                Tracer::Get().EndFlow("job", job.trace_id);
+#endif
+                job.task();
+            }
+            metrics_.OnJobEnd(self.index, started);
+        }
+    }
+
+    ThreadPoolOptions options_;
+    Metrics metrics_;
+    std::atomic<bool> stop_all_;
+
+    // Workers that are running or have retired but not been joined yet, guarded by mtx_workers_. A std::list so that
+    // a worker can hold on to its own entry.
+    std::list<Worker> workers_;
+    std::vector<WorkerPlacement> placements_;
+    std::atomic<size_t> live_workers_;
+    std::thread supervisor_;
+    std::condition_variable cv_supervisor_;
+    std::mutex mtx_workers_;
+
+    // One queue per JobPriority. ThreadPoolQueue::Unbounded uses jobs_, guarded by mtx_job_q_, and
+    // ThreadPoolQueue::BoundedLockFree uses rings_.
+    RingDeque<QueuedTask> jobs_[kNumJobPriorities];
+    std::unique_ptr<BoundedMpmcQueue<QueuedTask>> rings_[kNumJobPriorities];
+
+    // Number of queued jobs, readable without the queue lock. Signed because with the lock-free queue a worker may
+    // pop a job before its producer has counted it.
+    std::atomic<int64_t> pending_jobs_;
+    std::atomic<size_t> idle_workers_;
+    std::atomic<size_t> blocked_producers_;
+    std::atomic<uint64_t> dropped_jobs_;
+
     std::condition_variable cv_job_q_;
+    std::condition_variable cv_not_full_;
     std::mutex mtx_job_q_;
 };
+
+using ThreadPool = BasicThreadPool<NoThreadPoolMetrics>;
+// A ThreadPool that records the counters and histograms returned by GetMetrics().
+using InstrumentedThreadPool = BasicThreadPool<ThreadPoolMetrics>;
 } // namespace shkwon
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <string>
+#include <system_error>
+
+#include "shkwon/status/success_condition.hpp"
+
+namespace shkwon
+{
+enum class ThreadPoolErrorCode
+{
+    Success = 0,
+    QueueFull = 1,
+    Stopped = 2,
+};
+
+class ThreadPoolErrorCategory : public std::error_category
+{
+public:
+    const char *name() const noexcept override
+    {
+        return "ThreadPool";
+    }
+    std::string message(int value) const override
+    {
+        switch (static_cast<ThreadPoolErrorCode>(value))
+        {
+        case ThreadPoolErrorCode::Success:
+            return "Success";
+        case ThreadPoolErrorCode::QueueFull:
+            return "Job queue is full";
+        case ThreadPoolErrorCode::Stopped:
+            return "Thread pool is stopped";
+        default:
+            return "Unknown";
+        }
+    }
+    std::error_condition default_error_condition(int value) const noexcept override
+    {
+        if (static_cast<ThreadPoolErrorCode>(value) == ThreadPoolErrorCode::Success)
+        {
+            return make_error_condition(SuccessCondition::Success);
+        }
+        return std::error_condition(value, *this);
+    }
+};
+
+inline const std::error_category &GetThreadPoolErrorCategory() noexcept
+{
+    static const ThreadPoolErrorCategory category;
+    return category;
+}
+
+inline std::error_code make_error_code(ThreadPoolErrorCode value) noexcept
+{
+    return std::error_code(static_cast<int>(value), GetThreadPoolErrorCategory());
+}
+} // namespace shkwon
+
+namespace std
+{
+template <>
+struct is_error_code_enum<shkwon::ThreadPoolErrorCode> : true_type
+{
+};
+} // namespace std
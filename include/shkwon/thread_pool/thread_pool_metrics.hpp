@@ -0,0 +1,420 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "shkwon/thread_pool/task.hpp"
+
+namespace shkwon
+{
+/**
+ * A log-linear (HDR-style) histogram of durations in nanoseconds.
+ *
+ * Every power of two is split into kSubBuckets equal buckets, so any recorded value is off by at most 1/kSubBuckets
+ * of itself, across the whole 64-bit range. Only one thread may record into a histogram, but any thread may read it
+ * while it is being recorded into.
+ */
+class LatencyHistogram
+{
+public:
+    static constexpr size_t kSubBucketBits = 3;
+    static constexpr size_t kSubBuckets = size_t(1) << kSubBucketBits;
+    static constexpr size_t kNumBuckets = (64 - kSubBucketBits + 1) * kSubBuckets;
+
+    LatencyHistogram()
+    {
+        for (auto &count : counts_)
+        {
+            count.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    void Record(uint64_t value) noexcept
+    {
+        // Single writer, so a relaxed load/store pair is enough and saves the locked instruction of fetch_add().
+        auto &count = counts_[GetBucketIndex(value)];
+        count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    uint64_t GetBucketCount(size_t index) const noexcept
+    {
+        return counts_[index].load(std::memory_order_relaxed);
+    }
+
+    static size_t GetBucketIndex(uint64_t value) noexcept
+    {
+        if (value < kSubBuckets)
+        {
+            return static_cast<size_t>(value);
+        }
+
+        auto msb = static_cast<size_t>(63 - __builtin_clzll(value));
+        auto shift = msb - kSubBucketBits;
+        return (shift + 1) * kSubBuckets + static_cast<size_t>((value >> shift) - kSubBuckets);
+    }
+
+    /**
+     * @param index A bucket index.
+     * @return The smallest value that falls into the bucket.
+     */
+    static uint64_t GetBucketLowerBound(size_t index) noexcept
+    {
+        if (index < kSubBuckets)
+        {
+            return index;
+        }
+
+        auto shift = index / kSubBuckets - 1;
+        return static_cast<uint64_t>(kSubBuckets + index % kSubBuckets) << shift;
+    }
+
+    /**
+     * @param index A bucket index.
+     * @return The largest value that falls into the bucket.
+     */
+    static uint64_t GetBucketUpperBound(size_t index) noexcept
+    {
+        return (index + 1 < kNumBuckets) ? GetBucketLowerBound(index + 1) - 1 : UINT64_MAX;
+    }
+
+private:
+    std::atomic<uint64_t> counts_[kNumBuckets];
+};
+
+/**
+ * A point-in-time copy of one or more merged LatencyHistograms.
+ */
+struct HistogramSnapshot
+{
+    HistogramSnapshot()
+        : counts(LatencyHistogram::kNumBuckets, 0)
+        , count(0)
+    {
+    }
+
+    void Merge(const LatencyHistogram &histogram)
+    {
+        for (size_t i = 0; i < counts.size(); ++i)
+        {
+            auto bucket = histogram.GetBucketCount(i);
+            counts[i] += bucket;
+            count += bucket;
+        }
+    }
+
+    /**
+     * @param quantile The quantile in [0, 1], e.g. 0.99 for the 99th percentile.
+     * @return The upper bound of the bucket the quantile falls into, in nanoseconds, or 0 if nothing was recorded.
+     */
+    uint64_t GetPercentile(double quantile) const
+    {
+        if (count == 0)
+        {
+            return 0;
+        }
+
+        auto rank = static_cast<uint64_t>(quantile * static_cast<double>(count));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < counts.size(); ++i)
+        {
+            seen += counts[i];
+            if (seen > rank || seen == count)
+            {
+                return LatencyHistogram::GetBucketUpperBound(i);
+            }
+        }
+        return UINT64_MAX;
+    }
+
+    /**
+     * @return An estimate of the sum of all recorded values in nanoseconds, taking the middle of each bucket.
+     */
+    double GetSum() const
+    {
+        double sum = 0;
+        for (size_t i = 0; i < counts.size(); ++i)
+        {
+            if (counts[i] != 0)
+            {
+                double lower = static_cast<double>(LatencyHistogram::GetBucketLowerBound(i));
+                double upper = static_cast<double>(LatencyHistogram::GetBucketUpperBound(i));
+                sum += static_cast<double>(counts[i]) * (lower + upper) / 2;
+            }
+        }
+        return sum;
+    }
+
+    // Per-bucket counts, indexed like LatencyHistogram.
+    std::vector<uint64_t> counts;
+    uint64_t count;
+};
+
+struct WorkerMetricsSnapshot
+{
+    uint64_t jobs_executed;
+    // Jobs taken from another worker's queue. Always zero for ThreadPool, whose workers share their queues.
+    uint64_t steals;
+    std::chrono::nanoseconds idle_time;
+};
+
+struct ThreadPoolMetricsSnapshot
+{
+    size_t num_threads;
+    size_t queue_depth;
+    // One entry per worker slot. Slots of an elastic pool keep their counters when their worker retires.
+    std::vector<WorkerMetricsSnapshot> workers;
+    // Time from submission until a worker picked the job up.
+    HistogramSnapshot queue_latency;
+    // Time the job itself ran for.
+    HistogramSnapshot run_time;
+};
+
+/**
+ * Metrics policy of BasicThreadPool and BasicWorkStealingThreadPool that records nothing.
+ *
+ * It also documents what a metrics policy provides. Every hook is an empty inline function and Timestamp and
+ * QueuedTask carry no extra data, so a pool built with this policy compiles to the same code as one without hooks.
+ */
+struct NoThreadPoolMetrics
+{
+    static constexpr bool kEnabled = false;
+
+    struct Timestamp
+    {
+    };
+
+    // What the pool keeps in its queues: the job plus whatever the policy needs to know about it.
+    struct QueuedTask
+    {
+        Task task;
+    };
+
+    explicit NoThreadPoolMetrics(size_t /* num_workers */)
+    {
+    }
+
+    Timestamp Now() const noexcept
+    {
+        return {};
+    }
+
+    // Called right before a job is queued.
+    void OnEnqueue(QueuedTask & /* job */) noexcept
+    {
+    }
+
+    // Called right before a worker runs a job. Returns the time the job started.
+    Timestamp OnJobStart(size_t /* worker */, const QueuedTask & /* job */) noexcept
+    {
+        return {};
+    }
+
+    void OnJobEnd(size_t /* worker */, Timestamp /* started */) noexcept
+    {
+    }
+
+    // Called when a worker finds a job after it had found its queues empty at `idle_since`.
+    void OnIdleEnd(size_t /* worker */, Timestamp /* idle_since */) noexcept
+    {
+    }
+
+    void OnSteal(size_t /* worker */) noexcept
+    {
+    }
+};
+
+/**
+ * Metrics policy of BasicThreadPool and BasicWorkStealingThreadPool that records per-worker counters and histograms.
+ *
+ * Every worker writes only to its own slot, so recording never contends with other workers. The counters of a slot
+ * sit on their own cache line; the histograms are only read by Snapshot().
+ */
+class ThreadPoolMetrics
+{
+public:
+    static constexpr bool kEnabled = true;
+
+    using Timestamp = std::chrono::steady_clock::time_point;
+
+    struct QueuedTask
+    {
+        Task task;
+        Timestamp enqueued;
+    };
+
+    explicit ThreadPoolMetrics(size_t num_workers)
+        : num_workers_(num_workers)
+        , slots_(new Slot[num_workers])
+    {
+    }
+
+    Timestamp Now() const noexcept
+    {
+        return std::chrono::steady_clock::now();
+    }
+
+    void OnEnqueue(QueuedTask &job) noexcept
+    {
+        job.enqueued = Now();
+    }
+
+    Timestamp OnJobStart(size_t worker, const QueuedTask &job) noexcept
+    {
+        auto &slot = slots_[worker];
+        auto now = Now();
+        Increment(slot.jobs_executed, 1);
+        slot.queue_latency.Record(ToNanoseconds(now - job.enqueued));
+        return now;
+    }
+
+    void OnJobEnd(size_t worker, Timestamp started) noexcept
+    {
+        slots_[worker].run_time.Record(ToNanoseconds(Now() - started));
+    }
+
+    void OnIdleEnd(size_t worker, Timestamp idle_since) noexcept
+    {
+        Increment(slots_[worker].idle_ns, ToNanoseconds(Now() - idle_since));
+    }
+
+    void OnSteal(size_t worker) noexcept
+    {
+        Increment(slots_[worker].steals, 1);
+    }
+
+    /**
+     * Copies the current counters. Safe to call from any thread while the pool is running; the copy is not atomic
+     * across workers.
+     *
+     * @return The per-worker counters and the histograms merged over all workers. The pool fills in num_threads and
+     *         queue_depth.
+     */
+    ThreadPoolMetricsSnapshot Snapshot() const
+    {
+        ThreadPoolMetricsSnapshot snapshot;
+        snapshot.num_threads = 0;
+        snapshot.queue_depth = 0;
+        snapshot.workers.reserve(num_workers_);
+        for (size_t i = 0; i < num_workers_; ++i)
+        {
+            const auto &slot = slots_[i];
+            snapshot.workers.push_back(WorkerMetricsSnapshot{
+                slot.jobs_executed.load(std::memory_order_relaxed), slot.steals.load(std::memory_order_relaxed),
+                std::chrono::nanoseconds(slot.idle_ns.load(std::memory_order_relaxed)) });
+            snapshot.queue_latency.Merge(slot.queue_latency);
+            snapshot.run_time.Merge(slot.run_time);
+        }
+        return snapshot;
+    }
+
+private:
+    struct Slot
+    {
+        Slot()
+            : jobs_executed(0)
+            , steals(0)
+            , idle_ns(0)
+        {
+        }
+
+        // Keeps the counters off the cache line of the previous slot's run_time histogram.
+        char padding0[64];
+        std::atomic<uint64_t> jobs_executed;
+        std::atomic<uint64_t> steals;
+        std::atomic<uint64_t> idle_ns;
+        char padding1[64 - 3 * sizeof(std::atomic<uint64_t>)];
+        LatencyHistogram queue_latency;
+        LatencyHistogram run_time;
+    };
+
+    static void Increment(std::atomic<uint64_t> &counter, uint64_t value) noexcept
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+
+    static uint64_t ToNanoseconds(std::chrono::steady_clock::duration duration) noexcept
+    {
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+        return (ns > 0) ? static_cast<uint64_t>(ns) : 0;
+    }
+
+    size_t num_workers_;
+    std::unique_ptr<Slot[]> slots_;
+};
+
+/**
+ * Formats a snapshot in the Prometheus text exposition format.
+ *
+ * Durations are exported in seconds. The histograms are exported with one bucket per power of two from about 1µs to
+ * about 69s, which keeps the series count small while the bucket bounds stay the same from scrape to scrape.
+ *
+ * @param snapshot The snapshot to format.
+ * @param name The metric name prefix, e.g. "myapp_thread_pool".
+ * @return The formatted metrics, one sample per line.
+ */
+inline std::string FormatPrometheus(const ThreadPoolMetricsSnapshot &snapshot, const std::string &name)
+{
+    std::string text;
+    auto type = [&](const char *suffix, const char *kind) { text += "# TYPE " + name + suffix + " " + kind + "\n"; };
+    auto sample = [&](const std::string &suffix, const std::string &labels, double value) {
+        char number[32];
+        std::snprintf(number, sizeof(number), "%.15g", value);
+        text += name + suffix + labels + " " + number + "\n";
+    };
+
+    type("_threads", "gauge");
+    sample("_threads", "", static_cast<double>(snapshot.num_threads));
+    type("_queue_depth", "gauge");
+    sample("_queue_depth", "", static_cast<double>(snapshot.queue_depth));
+
+    type("_jobs_executed_total", "counter");
+    for (size_t i = 0; i < snapshot.workers.size(); ++i)
+    {
+        sample("_jobs_executed_total", "{worker=\"" + std::to_string(i) + "\"}",
+               static_cast<double>(snapshot.workers[i].jobs_executed));
+    }
+    type("_steals_total", "counter");
+    for (size_t i = 0; i < snapshot.workers.size(); ++i)
+    {
+        sample("_steals_total", "{worker=\"" + std::to_string(i) + "\"}",
+               static_cast<double>(snapshot.workers[i].steals));
+    }
+    type("_idle_seconds_total", "counter");
+    for (size_t i = 0; i < snapshot.workers.size(); ++i)
+    {
+        sample("_idle_seconds_total", "{worker=\"" + std::to_string(i) + "\"}",
+               static_cast<double>(snapshot.workers[i].idle_time.count()) / 1e9);
+    }
+
+    auto histogram = [&](const char *suffix, const HistogramSnapshot &values) {
+        type(suffix, "histogram");
+        uint64_t cumulative = 0;
+        size_t bucket = 0;
+        for (size_t exponent = 10; exponent <= 36; ++exponent)
+        {
+            // Everything below 2^exponent ns lives in the buckets before this index.
+            auto end = LatencyHistogram::GetBucketIndex(uint64_t(1) << exponent);
+            for (; bucket < end; ++bucket)
+            {
+                cumulative += values.counts[bucket];
+            }
+            char bound[32];
+            std::snprintf(bound, sizeof(bound), "%.9g", static_cast<double>(uint64_t(1) << exponent) / 1e9);
+            sample(std::string(suffix) + "_bucket", std::string("{le=\"") + bound + "\"}",
+                   static_cast<double>(cumulative));
+        }
+        sample(std::string(suffix) + "_bucket", "{le=\"+Inf\"}", static_cast<double>(values.count));
+        sample(std::string(suffix) + "_sum", "", values.GetSum() / 1e9);
+        sample(std::string(suffix) + "_count", "", static_cast<double>(values.count));
+    };
+    histogram("_queue_latency_seconds", snapshot.queue_latency);
+    histogram("_run_time_seconds", snapshot.run_time);
+    return text;
+}
+} // namespace shkwon
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace shkwon
+{
+/**
+ * The data structure a ThreadPool keeps its pending jobs in.
+ */
+enum class ThreadPoolQueue
+{
+    // A growable ring buffer guarded by a mutex. Never full, but every access is serialized.
+    Unbounded,
+    // A fixed-size lock-free ring (BoundedMpmcQueue). Predictable memory and lock-free submission, but it can fill up.
+    BoundedLockFree,
+};
+
+/**
+ * What a submission does when a bounded job queue is full.
+ */
+enum class Backpressure
+{
+    // Sleep until a worker makes room.
+    Block,
+    // Retry for a while before falling back to Block, which avoids a sleep/wake-up round trip for short bursts.
+    SpinThenBlock,
+    // Give up immediately. TryPost() reports ThreadPoolErrorCode::QueueFull, the other submit calls throw.
+    Reject,
+};
+
+/**
+ * What a worker does when it finds the job queue empty.
+ */
+enum class IdlePolicy
+{
+    // Go to sleep right away. Costs no CPU while idle, but every new job pays for a wake-up.
+    Park,
+    // Poll with a pause instruction, then yield, then sleep. Trades CPU for wake-up latency.
+    SpinThenPark,
+    // Like SpinThenPark, but each worker grows its spin budget when spinning found a job and shrinks it when it had to
+    // sleep anyway, so the budget follows how quickly jobs have been arriving.
+    Adaptive,
+};
+
+/**
+ * How workers are placed on the machine's NUMA nodes.
+ */
+enum class NumaPlacement
+{
+    // Ignore NUMA. Workers may run on any CPU in cpu_set (or any CPU at all if it is empty).
+    None,
+    // Deal workers out to the nodes round-robin, so that every node gets about the same number of workers.
+    Spread,
+    // Fill a node with as many workers as it has CPUs before moving on to the next one.
+    Pack,
+};
+
+/**
+ * Priority lanes of a ThreadPool. Workers serve higher lanes first.
+ */
+enum class JobPriority
+{
+    High = 0,
+    Normal = 1,
+    Low = 2,
+};
+
+constexpr size_t kNumJobPriorities = 3;
+
+/**
+ * Per-job dispatch settings for ThreadPool::Push/Post/TryPost.
+ */
+struct JobOptions
+{
+    JobPriority priority = JobPriority::Normal;
+    // A job that has not started by this point in time is dropped instead of being run. A dropped Push()ed job leaves
+    // its future with a std::future_error (broken_promise).
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+};
+
+struct ThreadPoolOptions
+{
+    ThreadPoolOptions() = default;
+    explicit ThreadPoolOptions(size_t threads)
+        : num_threads(threads)
+    {
+    }
+
+    // The number of workers the pool starts with. An elastic pool never shrinks below it.
+    size_t num_threads = 1;
+
+    // Upper bound for an elastic ThreadPool. Anything not above num_threads keeps the pool at a fixed size.
+    size_t max_threads = 0;
+    // An elastic pool adds workers when this many jobs are queued and no worker is idle...
+    size_t grow_queue_depth = 16;
+    // ...or when jobs have been queued with no idle worker for this long.
+    std::chrono::milliseconds grow_wait = std::chrono::milliseconds(10);
+    // How often an elastic pool checks whether it needs more workers. Submissions never resize the pool themselves.
+    std::chrono::milliseconds resize_interval = std::chrono::milliseconds(2);
+    // How long a worker above num_threads may stay idle before it exits.
+    std::chrono::milliseconds keep_alive = std::chrono::milliseconds(10000);
+
+    ThreadPoolQueue queue = ThreadPoolQueue::Unbounded;
+    // Only used by ThreadPoolQueue::BoundedLockFree, per priority lane. Rounded up to a power of two.
+    size_t queue_capacity = 4096;
+    Backpressure backpressure = Backpressure::Block;
+    // Number of retries before Backpressure::SpinThenBlock blocks.
+    uint32_t backpressure_spin_count = 1024;
+    // A queued lower-priority job is run once a worker has passed it over for this many higher-priority jobs, so that a
+    // flood of high-priority work cannot starve the lower lanes. Zero disables aging.
+    uint32_t priority_aging_limit = 16;
+
+    IdlePolicy idle_policy = IdlePolicy::Park;
+    // Number of polls before a spinning worker starts yielding. The upper bound of the budget for IdlePolicy::Adaptive.
+    uint32_t idle_spin_count = 4096;
+    // Number of polls with std::this_thread::yield() between spinning and sleeping.
+    uint32_t idle_yield_count = 16;
+
+    // CPUs the workers may run on. Empty means no restriction.
+    std::vector<int> cpu_set;
+    // With Spread or Pack, every worker is bound to the CPUs of its node (restricted to cpu_set if that is given).
+    NumaPlacement numa_placement = NumaPlacement::None;
+    // Workers are named "<thread_name>-<index>", truncated to the 15 characters Linux allows. Empty leaves them unnamed.
+    std::string thread_name;
+    // SCHED_FIFO priority (1-99) for the workers. Zero keeps the default time-sharing policy.
+    int realtime_priority = 0;
+};
+} // namespace shkwon
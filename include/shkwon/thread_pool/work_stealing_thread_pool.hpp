@@ -0,0 +1,464 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "shkwon/thread_pool/task.hpp"
+#include "shkwon/thread_pool/thread_pool_metrics.hpp"
+#include "shkwon/thread_pool/thread_pool_options.hpp"
+#include "shkwon/thread_pool/worker_placement.hpp"
+
+namespace shkwon
+{
+/**
+ * A thread pool in which every worker owns its own job deque.
+ *
+ * Jobs pushed from one of the pool's worker threads go to that worker's deque, and jobs pushed from any other thread
+ * are spread round-robin across the workers. A worker pops its own deque from the back (most recently pushed first)
+ * and, once it runs dry, steals from the front of the other workers' deques. The public interface matches ThreadPool,
+ * so the two can be swapped without touching the call sites. When workers are bound to NUMA nodes, jobs can be
+ * directed at a node with PushOnNode()/PostOnNode(), and thieves prefer victims on their own node. Use it through the
+ * WorkStealingThreadPool and InstrumentedWorkStealingThreadPool aliases.
+ *
+ * @tparam Metrics The metrics policy, NoThreadPoolMetrics or ThreadPoolMetrics.
+ */
+template <class Metrics>
+class BasicWorkStealingThreadPool
+{
+public:
+    BasicWorkStealingThreadPool(size_t num_threads)
+        : BasicWorkStealingThreadPool(ThreadPoolOptions(num_threads))
+    {
+    }
+
+    /**
+     * Constructs a pool from options. Only num_threads and the worker placement settings (cpu_set, numa_placement,
+     * thread_name, realtime_priority) apply; the queue, backpressure and idle settings are specific to ThreadPool.
+     *
+     * @param options The pool options.
+     */
+    explicit BasicWorkStealingThreadPool(const ThreadPoolOptions &options)
+        : num_threads_(options.num_threads)
+        , metrics_(options.num_threads)
+        , stop_all_(false)
+        , pending_jobs_(0)
+        , idle_workers_(0)
+        , next_queue_(0)
+    {
+        if (num_threads_ == 0)
+        {
+            throw std::invalid_argument("WorkStealingThreadPool needs at least one worker thread.");
+        }
+
+        auto nodes = (options.numa_placement == NumaPlacement::None) ? std::vector<NumaNode>() : GetNumaNodes();
+        placements_ = PlanWorkerPlacement(options, nodes);
+        for (size_t i = 0; i < num_threads_; ++i)
+        {
+            int node = placements_[i].numa_node;
+            if (node < 0)
+            {
+                continue;
+            }
+            if (static_cast<size_t>(node) >= node_workers_.size())
+            {
+                node_workers_.resize(node + 1);
+            }
+            node_workers_[node].push_back(i);
+        }
+
+        // Thieves look at the workers on their own node first, so that stolen jobs stay close to their data.
+        steal_order_.resize(num_threads_);
+        for (size_t thief = 0; thief < num_threads_; ++thief)
+        {
+            for (size_t i = 1; i < num_threads_; ++i)
+            {
+                steal_order_[thief].push_back((thief + i) % num_threads_);
+            }
+            std::stable_partition(steal_order_[thief].begin(), steal_order_[thief].end(), [&](size_t victim) {
+                return placements_[victim].numa_node == placements_[thief].numa_node;
+            });
+        }
+
+        queues_.reserve(num_threads_);
+        for (size_t i = 0; i < num_threads_; ++i)
+        {
+            queues_.emplace_back(new WorkQueue());
+        }
+
+        worker_threads_.reserve(num_threads_);
+        try
+        {
+            for (size_t i = 0; i < num_threads_; ++i)
+            {
+                worker_threads_.emplace_back([this, i]() { this->WorkerThread(i); });
+                ApplyWorkerPlacement(worker_threads_.back(), i, placements_[i], options);
+            }
+        }
+        catch (...)
+        {
+            Shutdown();
+            throw;
+        }
+    }
+    ~BasicWorkStealingThreadPool()
+    {
+        Shutdown();
+    }
+
+    template <class F, class... Args>
+    std::future<typename std::result_of<F(Args...)>::type> Push(F &&f, Args &&...args)
+    {
+        if (stop_all_)
+        {
+            throw std::runtime_error("WorkStealingThreadPool 사용 중지됨");
+        }
+
+        using return_type = typename std::result_of<F(Args...)>::type;
+        std::packaged_task<return_type()> job(std::bind(std::forward<F>(f), std::forward<Args>(args)...));
+        std::future<return_type> job_result_future = job.get_future();
+        Enqueue(Task(std::move(job)));
+
+        return job_result_future;
+    }
+
+    /**
+     * Submits a job without creating a future for its result. See ThreadPool::Post.
+     *
+     * @param f The callable to execute.
+     * @param args The arguments bound to the callable.
+     */
+    template <class F, class... Args>
+    void Post(F &&f, Args &&...args)
+    {
+        if (stop_all_)
+        {
+            throw std::runtime_error("WorkStealingThreadPool 사용 중지됨");
+        }
+
+        Enqueue(BindTask(std::forward<F>(f), std::forward<Args>(args)...));
+    }
+
+    /**
+     * Submits a job that should preferably run on a worker bound to the given NUMA node.
+     *
+     * The job is queued on one of that node's workers. It can still be stolen by a worker on another node once every
+     * worker on its own node is busy. Without a worker on the node, this behaves like Push().
+     *
+     * @param node The preferred NUMA node.
+     * @param f The callable to execute.
+     * @param args The arguments bound to the callable.
+     *
+     * @return A future for the result of the job.
+     */
+    template <class F, class... Args>
+    std::future<typename std::result_of<F(Args...)>::type> PushOnNode(int node, F &&f, Args &&...args)
+    {
+        if (stop_all_)
+        {
+            throw std::runtime_error("WorkStealingThreadPool 사용 중지됨");
+        }
+
+        using return_type = typename std::result_of<F(Args...)>::type;
+        std::packaged_task<return_type()> job(std::bind(std::forward<F>(f), std::forward<Args>(args)...));
+        std::future<return_type> job_result_future = job.get_future();
+        Enqueue(Task(std::move(job)), node);
+
+        return job_result_future;
+    }
+
+    /**
+     * Submits a fire-and-forget job that should preferably run on a worker bound to the given NUMA node. See
+     * PushOnNode.
+     *
+     * @param node The preferred NUMA node.
+     * @param f The callable to execute.
+     * @param args The arguments bound to the callable.
+     */
+    template <class F, class... Args>
+    void PostOnNode(int node, F &&f, Args &&...args)
+    {
+        if (stop_all_)
+        {
+            throw std::runtime_error("WorkStealingThreadPool 사용 중지됨");
+        }
+
+        Enqueue(BindTask(std::forward<F>(f), std::forward<Args>(args)...), node);
+    }
+
+    /**
+     * Submits every callable in [first, last) as a fire-and-forget job. See ThreadPool::PushBatch.
+     *
+     * The whole batch lands on a single deque under one lock acquisition; idle workers spread it by stealing.
+     *
+     * @param first The first callable to submit.
+     * @param last One past the last callable to submit.
+     *
+     * @return The number of jobs queued.
+     */
+    template <class InputIt>
+    size_t PushBatch(InputIt first, InputIt last)
+    {
+        if (stop_all_)
+        {
+            throw std::runtime_error("WorkStealingThreadPool 사용 중지됨");
+        }
+
+        size_t count = 0;
+        auto &queue = *queues_[SelectQueue(-1)];
+        {
+            std::lock_guard<std::mutex> lock(queue.mtx);
+            for (; first != last; ++first, ++count)
+            {
+                queue.jobs.push_back(MakeQueuedTask(Task(*first)));
+            }
+        }
+        if (count == 0)
+        {
+            return 0;
+        }
+
+        pending_jobs_.fetch_add(static_cast<int64_t>(count));
+        WakeWorkers(count);
+        return count;
+    }
+
+    size_t GetNumThreads() const
+    {
+        return num_threads_;
+    }
+
+    /**
+     * @param index The index of a worker.
+     * @return The NUMA node the worker is bound to, or -1 if it is not bound to one.
+     */
+    int GetWorkerNumaNode(size_t index) const
+    {
+        return placements_[index].numa_node;
+    }
+
+    /**
+     * @return The number of jobs waiting for a worker, over all deques. Only a snapshot while jobs are being submitted
+     *         or run.
+     */
+    size_t GetQueueDepth() const
+    {
+        auto pending = pending_jobs_.load(std::memory_order_relaxed);
+        return (pending > 0) ? static_cast<size_t>(pending) : 0;
+    }
+
+    /**
+     * Copies the pool's metrics. See ThreadPool::GetMetrics.
+     *
+     * @return The per-worker counters, the merged histograms, and the current size and queue depth.
+     */
+    ThreadPoolMetricsSnapshot GetMetrics() const
+    {
+        static_assert(Metrics::kEnabled, "GetMetrics() needs a pool with a recording metrics policy");
+
+        auto snapshot = metrics_.Snapshot();
+        snapshot.num_threads = num_threads_;
+        snapshot.queue_depth = GetQueueDepth();
+        return snapshot;
+    }
+
+private:
+    using QueuedTask = typename Metrics::QueuedTask;
+
+    // Padded so that neighbouring workers' locks never end up on the same cache line.
+    struct WorkQueue
+    {
+        std::mutex mtx;
+        RingDeque<QueuedTask> jobs;
+        char padding[64];
+    };
+
+    struct WorkerContext
+    {
+        const BasicWorkStealingThreadPool *pool;
+        size_t index;
+    };
+
+    static WorkerContext &CurrentWorker()
+    {
+        static thread_local WorkerContext context = { nullptr, 0 };
+        return context;
+    }
+
+    void Shutdown()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mtx_idle_);
+            stop_all_ = true;
+        }
+        cv_idle_.notify_all();
+
+        for (auto &t : worker_threads_)
+        {
+            t.join();
+        }
+    }
+
+    // Jobs submitted by a worker stay on its own deque unless they are meant for another node; everything else is
+    // spread round-robin, over the workers of the requested node if there are any.
+    size_t SelectQueue(int node)
+    {
+        const auto &context = CurrentWorker();
+        if (context.pool == this && (node < 0 || placements_[context.index].numa_node == node))
+        {
+            return context.index;
+        }
+
+        auto next = next_queue_.fetch_add(1, std::memory_order_relaxed);
+        if (node >= 0 && static_cast<size_t>(node) < node_workers_.size() && !node_workers_[node].empty())
+        {
+            return node_workers_[node][next % node_workers_[node].size()];
+        }
+        return next % num_threads_;
+    }
+
+    QueuedTask MakeQueuedTask(Task &&job)
+    {
+        QueuedTask queued;
+        queued.task = std::move(job);
+        metrics_.OnEnqueue(queued);
+        return queued;
+    }
+
+    void Enqueue(Task job, int node = -1)
+    {
+        auto queued = MakeQueuedTask(std::move(job));
+        auto &queue = *queues_[SelectQueue(node)];
+        {
+            std::lock_guard<std::mutex> lock(queue.mtx);
+            queue.jobs.push_back(std::move(queued));
+        }
+
+        pending_jobs_.fetch_add(1);
+        WakeWorkers(1);
+    }
+
+    // Must be called after pending_jobs_ has been increased. Pairs with the idle_workers_ increment in WorkerThread:
+    // either the sleeping worker sees the new job count, or we see the sleeper and wake it up.
+    void WakeWorkers(size_t count)
+    {
+        size_t idle = idle_workers_.load();
+        if (idle == 0)
+        {
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mtx_idle_);
+        }
+        if (count >= idle)
+        {
+            cv_idle_.notify_all();
+            return;
+        }
+        for (size_t i = 0; i < count; ++i)
+        {
+            cv_idle_.notify_one();
+        }
+    }
+
+    bool PopLocal(size_t index, QueuedTask &job)
+    {
+        auto &queue = *queues_[index];
+        std::lock_guard<std::mutex> lock(queue.mtx);
+        if (queue.jobs.empty())
+        {
+            return false;
+        }
+
+        job = queue.jobs.pop_back();
+        return true;
+    }
+
+    bool Steal(size_t thief, QueuedTask &job)
+    {
+        for (size_t victim : steal_order_[thief])
+        {
+            auto &queue = *queues_[victim];
+            std::lock_guard<std::mutex> lock(queue.mtx);
+            if (!queue.jobs.empty())
+            {
+                job = queue.jobs.pop_front();
+                metrics_.OnSteal(thief);
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    void WorkerThread(size_t index)
+    {
+        CurrentWorker() = { this, index };
+
+        bool waited = false;
+        typename Metrics::Timestamp idle_since;
+        while (true)
+        {
+            QueuedTask job;
+            if (PopLocal(index, job) || Steal(index, job))
+            {
+                pending_jobs_.fetch_sub(1);
+                if (waited)
+                {
+                    metrics_.OnIdleEnd(index, idle_since);
+                    waited = false;
+                }
+
+                auto started = metrics_.OnJobStart(index, job);
+                job.task();
+                metrics_.OnJobEnd(index, started);
+                continue;
+            }
+            if (!waited)
+            {
+                idle_since = metrics_.Now();
+                waited = true;
+            }
+
+            std::unique_lock<std::mutex> lock(mtx_idle_);
+            if (stop_all_ && pending_jobs_.load() <= 0)
+            {
+                return;
+            }
+
+            idle_workers_.fetch_add(1);
+            cv_idle_.wait(lock, [this]() { return pending_jobs_.load() > 0 || stop_all_; });
+            idle_workers_.fetch_sub(1);
+        }
+    }
+
+    size_t num_threads_;
+    Metrics metrics_;
+    std::atomic<bool> stop_all_;
+    std::vector<std::thread> worker_threads_;
+    std::vector<std::unique_ptr<WorkQueue>> queues_;
+    std::vector<WorkerPlacement> placements_;
+    // Worker indices by NUMA node id.
+    std::vector<std::vector<size_t>> node_workers_;
+    std::vector<std::vector<size_t>> steal_order_;
+
+    // Signed because a thief may pop a job before its producer has counted it.
+    std::atomic<int64_t> pending_jobs_;
+    std::atomic<size_t> idle_workers_;
+    std::atomic<size_t> next_queue_;
+    std::condition_variable cv_idle_;
+    std::mutex mtx_idle_;
+};
+
+using WorkStealingThreadPool = BasicWorkStealingThreadPool<NoThreadPoolMetrics>;
+// A WorkStealingThreadPool that records the counters and histograms returned by GetMetrics().
+using InstrumentedWorkStealingThreadPool = BasicWorkStealingThreadPool<ThreadPoolMetrics>;
+} // namespace shkwon
@@ -0,0 +1,226 @@
+#pragma once
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "shkwon/thread_pool/thread_pool_options.hpp"
+
+namespace shkwon
+{
+struct NumaNode
+{
+    int id;
+    std::vector<int> cpus;
+};
+
+/**
+ * Where a single worker thread should run.
+ */
+struct WorkerPlacement
+{
+    // The NUMA node the worker is bound to, or -1 if it is not bound to one.
+    int numa_node;
+    // The CPUs the worker may run on. Empty means no restriction.
+    std::vector<int> cpus;
+};
+
+/**
+ * Parses a Linux CPU list such as "0-3,8,10-11".
+ *
+ * @param list The list to parse.
+ * @return The CPUs in the list, in the order they appear.
+ */
+inline std::vector<int> ParseCpuList(const std::string &list)
+{
+    std::vector<int> cpus;
+    std::stringstream stream(list);
+    std::string range;
+    while (std::getline(stream, range, ','))
+    {
+        int first = 0;
+        int last = 0;
+        char dash = 0;
+        std::stringstream range_stream(range);
+        if (!(range_stream >> first))
+        {
+            continue;
+        }
+        last = (range_stream >> dash >> last && dash == '-') ? last : first;
+        for (int cpu = first; cpu <= last; ++cpu)
+        {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+/**
+ * Reads the NUMA topology from sysfs.
+ *
+ * @return The online NUMA nodes and their CPUs. Machines without NUMA information are reported as a single node 0
+ *         holding every CPU.
+ */
+inline std::vector<NumaNode> GetNumaNodes()
+{
+    std::vector<NumaNode> nodes;
+
+    std::ifstream online("/sys/devices/system/node/online");
+    std::string online_list;
+    if (std::getline(online, online_list))
+    {
+        for (int id : ParseCpuList(online_list))
+        {
+            std::ifstream cpulist("/sys/devices/system/node/node" + std::to_string(id) + "/cpulist");
+            std::string cpus;
+            if (std::getline(cpulist, cpus) && !ParseCpuList(cpus).empty())
+            {
+                nodes.push_back(NumaNode{ id, ParseCpuList(cpus) });
+            }
+        }
+    }
+
+    if (nodes.empty())
+    {
+        NumaNode node{ 0, {} };
+        for (unsigned cpu = 0; cpu < std::max(1u, std::thread::hardware_concurrency()); ++cpu)
+        {
+            node.cpus.push_back(static_cast<int>(cpu));
+        }
+        nodes.push_back(node);
+    }
+    return nodes;
+}
+
+/**
+ * Decides on which node and CPUs each worker of a pool runs.
+ *
+ * @param options The pool options. Uses num_threads, cpu_set and numa_placement.
+ * @param nodes The machine's NUMA nodes, as returned by GetNumaNodes().
+ * @return One placement per worker.
+ */
+inline std::vector<WorkerPlacement> PlanWorkerPlacement(const ThreadPoolOptions &options,
+                                                        const std::vector<NumaNode> &nodes)
+{
+    std::vector<WorkerPlacement> plan(options.num_threads, WorkerPlacement{ -1, options.cpu_set });
+    if (options.numa_placement == NumaPlacement::None)
+    {
+        return plan;
+    }
+
+    // Only keep the CPUs the pool is allowed to use.
+    std::vector<NumaNode> usable;
+    for (const auto &node : nodes)
+    {
+        NumaNode allowed{ node.id, {} };
+        for (int cpu : node.cpus)
+        {
+            if (options.cpu_set.empty() ||
+                std::find(options.cpu_set.begin(), options.cpu_set.end(), cpu) != options.cpu_set.end())
+            {
+                allowed.cpus.push_back(cpu);
+            }
+        }
+        if (!allowed.cpus.empty())
+        {
+            usable.push_back(allowed);
+        }
+    }
+    if (usable.empty())
+    {
+        return plan;
+    }
+
+    size_t node = 0;
+    size_t workers_on_node = 0;
+    for (size_t i = 0; i < plan.size(); ++i)
+    {
+        if (options.numa_placement == NumaPlacement::Spread)
+        {
+            node = i % usable.size();
+        }
+        else if (workers_on_node == usable[node].cpus.size())
+        {
+            // Pack: this node is full, move on. Once every node is full, start over with the first one.
+            node = (node + 1) % usable.size();
+            workers_on_node = 0;
+        }
+
+        plan[i].numa_node = usable[node].id;
+        plan[i].cpus = usable[node].cpus;
+        ++workers_on_node;
+    }
+    return plan;
+}
+
+/**
+ * Applies a placement, a name and a scheduling priority to a worker thread.
+ *
+ * @param thread The worker thread.
+ * @param index The index of the worker in its pool, appended to the thread name.
+ * @param placement Where the worker may run.
+ * @param options The pool options. Uses thread_name and realtime_priority.
+ *
+ * @throws std::system_error if the operating system refuses one of the settings.
+ */
+inline void ApplyWorkerPlacement(std::thread &thread, size_t index, const WorkerPlacement &placement,
+                                 const ThreadPoolOptions &options)
+{
+#if defined(__linux__)
+    auto handle = thread.native_handle();
+
+    if (!placement.cpus.empty())
+    {
+        cpu_set_t cpu_set;
+        CPU_ZERO(&cpu_set);
+        for (int cpu : placement.cpus)
+        {
+            CPU_SET(cpu, &cpu_set);
+        }
+        int error = pthread_setaffinity_np(handle, sizeof(cpu_set), &cpu_set);
+        if (error != 0)
+        {
+            throw std::system_error(error, std::system_category(), "pthread_setaffinity_np");
+        }
+    }
+
+    if (!options.thread_name.empty())
+    {
+        // Linux limits thread names to 15 characters plus the terminator.
+        auto name = (options.thread_name + "-" + std::to_string(index)).substr(0, 15);
+        int error = pthread_setname_np(handle, name.c_str());
+        if (error != 0)
+        {
+            throw std::system_error(error, std::system_category(), "pthread_setname_np");
+        }
+    }
+
+    if (options.realtime_priority > 0)
+    {
+        sched_param param{};
+        param.sched_priority = options.realtime_priority;
+        int error = pthread_setschedparam(handle, SCHED_FIFO, &param);
+        if (error != 0)
+        {
+            throw std::system_error(error, std::system_category(), "pthread_setschedparam");
+        }
+    }
+#else
+    if (!placement.cpus.empty() || !options.thread_name.empty() || options.realtime_priority > 0)
+    {
+        throw std::system_error(std::make_error_code(std::errc::not_supported), "worker placement");
+    }
+    (void)thread;
+    (void)index;
+#endif
+}
+} // namespace shkwon
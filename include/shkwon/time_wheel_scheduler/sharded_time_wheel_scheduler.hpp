@@ -0,0 +1,414 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "shkwon/time_wheel_scheduler/time_wheel_scheduler.hpp"
+
+namespace shkwon
+{
+/**
+ * A TimeWheelScheduler split into independent shards for high timer insert rates.
+ *
+ * Every shard has its own wheel hierarchy, command queue, slab and thread. A new timer goes to the shard of the calling
+ * thread, so producers on different cores rarely touch the same queue or slab, and the handle remembers its shard for
+ * resetting and cancelling.
+ * The interface is the same as TimeWheelScheduler's.
+ *
+ * @code
+ * ShardedTimeWheelScheduler scheduler(4, 10);
+ * scheduler.AppendTimeWheel(60, 1000, "second");
+ * scheduler.AppendTimeWheel(100, 10, "millisecond");
+ * scheduler.Start();
+ * auto timer = scheduler.CreateTimerAfter(500, []() { ... });
+ * scheduler.CancelTimer(timer);
+ * @endcode
+ */
+class ShardedTimeWheelScheduler
+{
+public:
+    /**
+     * Constructs a sharded scheduler.
+     *
+     * @param num_shards The number of shards. 0 means one per hardware thread.
+     * @param interval The tick of every shard in milliseconds, as for TimeWheelScheduler.
+     * @param mode Whether the shards wake up on every tick or only when a timer is due.
+     */
+    explicit ShardedTimeWheelScheduler(size_t num_shards = 0, uint32_t interval = 50,
+                                       TimerTickMode mode = TimerTickMode::Periodic)
+    {
+        this->MakeShards(num_shards, [&]() { return std::make_unique<TimeWheelScheduler>(interval, mode); });
+    }
+
+    /**
+     * Constructs a sharded scheduler whose shards build their own wheels from a resolution and a horizon, as
+     * TimeWheelScheduler does.
+     *
+     * @param num_shards The number of shards. 0 means one per hardware thread.
+     * @param resolution The length of a tick of every shard.
+     * @param horizon The longest delay to support.
+     * @param mode Whether the shards wake up on every tick or only when a timer is due.
+     */
+    ShardedTimeWheelScheduler(size_t num_shards, std::chrono::nanoseconds resolution, std::chrono::nanoseconds horizon,
+                              TimerTickMode mode = TimerTickMode::Periodic)
+    {
+        this->MakeShards(num_shards,
+                         [&]() { return std::make_unique<TimeWheelScheduler>(resolution, horizon, mode); });
+    }
+
+    /**
+     * Appends a time wheel with the specified number of slots and interval to every shard.
+     *
+     * @param total_slot_num The total number of slots in the time wheel.
+     * @param interval The interval (in milliseconds) between each slot in the time wheel.
+     * @param name An optional name for the time wheel.
+     */
+    void AppendTimeWheel(uint32_t total_slot_num, uint32_t interval, const std::string &name = "")
+    {
+        for (auto &shard : shards_)
+        {
+            shard->AppendTimeWheel(total_slot_num, interval, name);
+        }
+    }
+
+    /**
+     * Sets how expired timers run in every shard. Has to be called before Start().
+     *
+     * @param execution Whether callbacks are posted one by one, posted in batches, or run on the shard threads.
+     */
+    void SetExecution(TimerExecution execution)
+    {
+        for (auto &shard : shards_)
+        {
+            shard->SetExecution(execution);
+        }
+    }
+
+    /**
+     * Makes every shard post its callbacks to `executor` instead of a ThreadPool of its own. Has to be called before
+     * Start().
+     *
+     * @param executor The executor for the callbacks. It has to outlive the shard threads.
+     */
+    void SetExecutor(const Executor &executor)
+    {
+        for (auto &shard : shards_)
+        {
+            shard->SetExecutor(executor);
+        }
+    }
+
+    /**
+     * Creates a timer that will execute the given task at the specified time, in the calling thread's shard.
+     *
+     * @param when The time at which the task will be executed in milliseconds since the Epoch.
+     * @param task The task to execute when the timer expires.
+     *
+     * @return A handle to the new timer. Empty if the timer creation fails.
+     */
+    template <class F>
+    TimerHandle CreateTimerAt(int64_t when, F &&task)
+    {
+        return this->GetLocalShard().CreateTimerAt(when, std::forward<F>(task));
+    }
+
+    /**
+     * Creates a timer that will execute the given task after the specified number of milliseconds, in the calling
+     * thread's shard.
+     *
+     * @param delay The time in milliseconds to wait before executing the task.
+     * @param task The task to execute when the timer expires.
+     *
+     * @return A handle to the new timer. Empty if the timer creation fails.
+     */
+    template <class F>
+    TimerHandle CreateTimerAfter(int64_t delay, F &&task)
+    {
+        return this->GetLocalShard().CreateTimerAfter(delay, std::forward<F>(task));
+    }
+
+    /**
+     * Creates a timer that will execute the given task after the specified delay, in the calling thread's shard.
+     *
+     * @param delay The time to wait before executing the task, rounded up to whole ticks.
+     * @param task The task to execute when the timer expires.
+     *
+     * @return A handle to the new timer. Empty if the timer creation fails.
+     */
+    template <class Rep, class Period, class F>
+    TimerHandle CreateTimerAfter(std::chrono::duration<Rep, Period> delay, F &&task)
+    {
+        return this->GetLocalShard().CreateTimerAfter(delay, std::forward<F>(task));
+    }
+
+    /**
+     * Creates a timer that executes the given task every specified number of milliseconds, in the calling thread's
+     * shard.
+     *
+     * @param interval The time in milliseconds between periodic task executions.
+     * @param task The task to execute.
+     *
+     * @return A handle to the new timer. Empty if the timer creation fails.
+     */
+    template <class F>
+    TimerHandle CreateTimerEvery(int64_t interval, F &&task)
+    {
+        return this->GetLocalShard().CreateTimerEvery(interval, std::forward<F>(task));
+    }
+
+    /**
+     * Creates a timer that executes the given task at a fixed interval, in the calling thread's shard.
+     *
+     * @param interval The time between periodic task executions, rounded up to whole ticks.
+     * @param task The task to execute.
+     *
+     * @return A handle to the new timer. Empty if the timer creation fails.
+     */
+    template <class Rep, class Period, class F>
+    TimerHandle CreateTimerEvery(std::chrono::duration<Rep, Period> interval, F &&task)
+    {
+        return this->GetLocalShard().CreateTimerEvery(interval, std::forward<F>(task));
+    }
+
+    /**
+     * Resets the timer to expire at the specified time, in the shard it was created in.
+     *
+     * @param timer The timer to reset.
+     * @param when The time at which the timer should expire, in milliseconds since epoch.
+     *
+     * @return false if the timer has already fired (for a one-shot timer) or has been cancelled.
+     */
+    bool ResetTimerAt(const TimerHandle &timer, int64_t when)
+    {
+        auto *shard = this->GetShard(timer);
+        return shard != nullptr && shard->ResetTimerAt(timer, when);
+    }
+
+    /**
+     * Resets the timer to expire after the specified delay, in the shard it was created in.
+     *
+     * @param timer The timer to reset.
+     * @param delay The time in milliseconds to wait before the timer expires.
+     *
+     * @return false if the timer has already fired (for a one-shot timer) or has been cancelled.
+     */
+    bool ResetTimerAfter(const TimerHandle &timer, int64_t delay)
+    {
+        auto *shard = this->GetShard(timer);
+        return shard != nullptr && shard->ResetTimerAfter(timer, delay);
+    }
+
+    /**
+     * Resets the timer to expire after the specified delay, in the shard it was created in.
+     *
+     * @param timer The timer to reset.
+     * @param delay The time to wait before the timer expires, rounded up to whole ticks.
+     *
+     * @return false if the timer has already fired (for a one-shot timer) or has been cancelled.
+     */
+    template <class Rep, class Period>
+    bool ResetTimerAfter(const TimerHandle &timer, std::chrono::duration<Rep, Period> delay)
+    {
+        auto *shard = this->GetShard(timer);
+        return shard != nullptr && shard->ResetTimerAfter(timer, delay);
+    }
+
+    /**
+     * Cancels a timer in the shard it was created in.
+     *
+     * @param timer The timer to cancel.
+     *
+     * @return false if the timer has already fired (for a one-shot timer) or has been cancelled.
+     */
+    bool CancelTimer(const TimerHandle &timer)
+    {
+        auto *shard = this->GetShard(timer);
+        return shard != nullptr && shard->CancelTimer(timer);
+    }
+
+    /**
+     * Creates a batch of timers in the calling thread's shard. See TimeWheelScheduler::CreateTimersAt().
+     *
+     * @param first The first timer to create, a pair of the time in milliseconds since the Epoch and the task.
+     * @param last One past the last timer to create.
+     *
+     * @return The handles of the new timers, in the order of the range.
+     */
+    template <class ForwardIt>
+    std::vector<TimerHandle> CreateTimersAt(ForwardIt first, ForwardIt last)
+    {
+        return this->GetLocalShard().CreateTimersAt(first, last);
+    }
+
+    /**
+     * Creates a batch of timers in the calling thread's shard. See TimeWheelScheduler::CreateTimersAfter().
+     *
+     * @param first The first timer to create, a pair of the delay and the task.
+     * @param last One past the last timer to create.
+     *
+     * @return The handles of the new timers, in the order of the range.
+     */
+    template <class ForwardIt>
+    std::vector<TimerHandle> CreateTimersAfter(ForwardIt first, ForwardIt last)
+    {
+        return this->GetLocalShard().CreateTimersAfter(first, last);
+    }
+
+    /**
+     * Cancels every timer in [first, last), with one batch per shard.
+     *
+     * @param first The first handle.
+     * @param last One past the last handle.
+     *
+     * @return The number of timers that were cancelled.
+     */
+    template <class InputIt>
+    size_t CancelTimers(InputIt first, InputIt last)
+    {
+        size_t count = 0;
+        auto batches = this->SplitByShard(first, last);
+        for (size_t i = 0; i < batches.size(); ++i)
+        {
+            count += shards_[i]->CancelTimers(batches[i].begin(), batches[i].end());
+        }
+        return count;
+    }
+
+    /**
+     * Resets every timer in [first, last) to expire after the same delay, with one batch per shard.
+     *
+     * @param first The first handle.
+     * @param last One past the last handle.
+     * @param delay The time to wait before the timers expire, in milliseconds or as any std::chrono::duration.
+     *
+     * @return The number of timers that were still pending.
+     */
+    template <class InputIt, class Delay>
+    size_t ResetTimersAfter(InputIt first, InputIt last, Delay delay)
+    {
+        size_t count = 0;
+        auto batches = this->SplitByShard(first, last);
+        for (size_t i = 0; i < batches.size(); ++i)
+        {
+            count += shards_[i]->ResetTimersAfter(batches[i].begin(), batches[i].end(), delay);
+        }
+        return count;
+    }
+
+    /**
+     * Starts every shard.
+     *
+     * @return false if no time wheel has been appended.
+     */
+    bool Start(void)
+    {
+        for (auto &shard : shards_)
+        {
+            if (!shard->Start())
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * Stops every shard.
+     */
+    void Stop(void)
+    {
+        for (auto &shard : shards_)
+        {
+            shard->Stop();
+        }
+    }
+
+    size_t GetNumShards() const
+    {
+        return shards_.size();
+    }
+
+    /**
+     * @return The pending timers of all shards together, and the worst lag of any shard.
+     */
+    TimeWheelSchedulerStats GetStats()
+    {
+        TimeWheelSchedulerStats total;
+        for (auto &shard : shards_)
+        {
+            auto stats = shard->GetStats();
+            total.num_timers += stats.num_timers;
+            total.lag = std::max(total.lag, stats.lag);
+            total.max_lag = std::max(total.max_lag, stats.max_lag);
+        }
+        return total;
+    }
+
+    /**
+     * @param shard The index of the shard, below GetNumShards().
+     * @return The stats of a single shard.
+     */
+    TimeWheelSchedulerStats GetShardStats(size_t shard)
+    {
+        return shards_.at(shard)->GetStats();
+    }
+
+private:
+    template <class MakeShard>
+    void MakeShards(size_t num_shards, MakeShard make_shard)
+    {
+        if (num_shards == 0)
+        {
+            num_shards = std::max(1u, std::thread::hardware_concurrency());
+        }
+
+        shards_.reserve(num_shards);
+        for (size_t i = 0; i < num_shards; ++i)
+        {
+            shards_.push_back(make_shard());
+            shards_.back()->shard_ = static_cast<uint32_t>(i);
+        }
+    }
+
+    // Handles that belong to no shard are dropped; every operation on them would fail anyway.
+    template <class InputIt>
+    std::vector<std::vector<TimerHandle>> SplitByShard(InputIt first, InputIt last)
+    {
+        std::vector<std::vector<TimerHandle>> batches(shards_.size());
+        for (; first != last; ++first)
+        {
+            const TimerHandle &timer = *first;
+            if (this->GetShard(timer) != nullptr)
+            {
+                batches[timer.shard_].push_back(timer);
+            }
+        }
+        return batches;
+    }
+
+    TimeWheelScheduler *GetShard(const TimerHandle &timer)
+    {
+        if (!timer || timer.shard_ >= shards_.size())
+        {
+            return nullptr;
+        }
+        return shards_[timer.shard_].get();
+    }
+
+    // Threads are numbered in the order they first create a timer, which spreads them evenly over the shards.
+    TimeWheelScheduler &GetLocalShard()
+    {
+        static std::atomic<size_t> next_thread{ 0 };
+        thread_local size_t thread_index = next_thread.fetch_add(1, std::memory_order_relaxed);
+        return *shards_[thread_index % shards_.size()];
+    }
+
+    std::vector<std::unique_ptr<TimeWheelScheduler>> shards_;
+};
+} // namespace shkwon
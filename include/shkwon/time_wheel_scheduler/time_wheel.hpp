@@ -1,7 +1,9 @@
 #pragma once
 
+#include <algorithm>
 #include <chrono>
-#include <list>
+#include <cstdint>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -17,6 +19,26 @@ inline int64_t GetNowTimestamp()
     return duration_cast<milliseconds>(now).count();
 }
 
+/**
+ * Returns the time of the steady clock in milliseconds. Unlike GetNowTimestamp(), it never jumps when the system clock
+ * is set, so the time wheels run on it.
+ */
+inline int64_t GetSteadyTimestamp()
+{
+    using namespace std::chrono;
+
+    auto now = steady_clock::now().time_since_epoch();
+    return duration_cast<milliseconds>(now).count();
+}
+
+/**
+ * One level of a hierarchy of time wheels.
+ *
+ * The wheel does not care about the unit of time, as long as the interval and every timestamp given to it use the same
+ * one: milliseconds for the wheels of a TimeWheelScheduler built from a tick in milliseconds, ticks of the resolution
+ * for one built from a resolution. A wheel whose number of slots and interval are powers of two places timers with a
+ * mask and a shift instead of a division.
+ */
 class TimeWheel
 {
 public:
@@ -24,15 +46,18 @@ public:
      * Constructs a TimeWheel object with the specified number of slots and interval.
      *
      * @param total_slot_num The total number of slots in the TimeWheel.
-     * @param interval The interval (in milliseconds) between each slot.
+     * @param interval The interval between each slot, in milliseconds or whatever unit the timestamps are in.
      * @param name An optional name for the TimeWheel.
      */
-    TimeWheel(uint32_t total_slot_num, uint32_t interval, const std::string &name = "")
+    TimeWheel(uint32_t total_slot_num, uint64_t interval, const std::string &name = "")
         : name_(name)
         , slot_num_(total_slot_num)
-        , interval_in_millisecond_(interval)
+        , slot_mask_(IsPowerOfTwo(total_slot_num) ? total_slot_num - 1 : kNoMask)
+        , interval_(static_cast<int64_t>(interval))
+        , interval_shift_(IsPowerOfTwo(interval) ? __builtin_ctzll(interval) : -1)
         , curr_slot_idx_(0)
         , slots_(total_slot_num)
+        , occupied_((total_slot_num + 63) / 64)
         , less_level_timewheel_(nullptr)
         , greater_level_timewheel_(nullptr)
     {
@@ -59,13 +84,13 @@ public:
     }
 
     /**
-     * Returns the current time in milliseconds.
+     * Returns the time covered by the current slots of this wheel and the ones below it.
      *
-     * @return The current time in milliseconds.
+     * @return The current time, in the unit of the interval.
      */
     int64_t GetCurrentTime(void) const
     {
-        int64_t time = curr_slot_idx_ * interval_in_millisecond_;
+        int64_t time = curr_slot_idx_ * interval_;
         if (less_level_timewheel_ != nullptr)
         {
             time += less_level_timewheel_->GetCurrentTime();
@@ -75,86 +100,275 @@ public:
     }
 
     /**
-     * Adds a timer to the time wheel.
+     * Returns how far ahead a timer can be added to this wheel. Further ahead, its slot would wrap around to one that
+     * comes up earlier.
      *
-     * @param timer A shared pointer to the timer to add.
+     * @return The longest delay, in the unit of the interval.
      */
-    void AddTimer(TimerPtr timer)
+    int64_t GetReach() const
+    {
+        return static_cast<int64_t>(slot_num_ - 1) * interval_;
+    }
+
+    /**
+     * Adds a timer to a time wheel in milliseconds.
+     *
+     * @param timer The timer to add. It must not be linked into any slot.
+     */
+    void AddTimer(TimerNode *timer)
+    {
+        AddTimer(timer, GetSteadyTimestamp());
+    }
+
+    /**
+     * Adds a timer to the time wheel, given the current time.
+     *
+     * @param timer The timer to add, placed at its `when`, at most GetReach() ahead of `now`. It must not be linked into
+     *              any slot.
+     * @param now The time of the current slot of the least level time wheel, on the same clock as the expiration
+     *            time of the timer. Passing the same value for many timers only reads the clock once.
+     */
+    void AddTimer(TimerNode *timer, int64_t now)
     {
         int64_t less_level_time = 0;
         if (less_level_timewheel_ != nullptr)
         {
             less_level_time = less_level_timewheel_->GetCurrentTime();
         }
-        auto diff = timer->GetExpirationTime() + less_level_time - GetNowTimestamp();
+        auto diff = timer->when + less_level_time - now;
 
         // If the difference is greater than scale unit, the timer can be added into the current time wheel.
-        if (diff >= interval_in_millisecond_)
+        if (diff >= interval_)
         {
-            size_t n = (curr_slot_idx_ + diff / interval_in_millisecond_) % slot_num_;
-            slots_[n].push_back(timer);
+            Link(WrapSlot(curr_slot_idx_ + static_cast<uint64_t>(ToSlots(diff))), timer);
             return;
         }
 
         // If the difference is less than scale uint, the timer should be added into less level time wheel.
         if (less_level_timewheel_ != nullptr)
         {
-            less_level_timewheel_->AddTimer(timer);
+            less_level_timewheel_->AddTimer(timer, now);
             return;
         }
 
-        // If the current time wheel is the least level, the timer can be added into the current time wheel.
-        slots_[curr_slot_idx_].push_back(timer);
+        // If the current time wheel is the least level, the timer is due and fires on the next tick. The current slot
+        // has already been popped, so linking it there would hold it back for a whole turn of the wheel.
+        Link(WrapSlot(curr_slot_idx_ + 1), timer);
     }
 
     /**
      * Increases the current time slot of the time wheel by one.
+     *
+     * @param now The time of the new current slot, used to place the timers cascading from the greater level. Defaults
+     *            to the steady clock, for wheels in milliseconds.
+     */
+    void Increase(int64_t now = GetSteadyTimestamp())
+    {
+        Advance(1, now);
+    }
+
+    /**
+     * Moves the current time slot forward by several ticks in one step.
+     *
+     * The slots passed on the way are not popped, so this must only jump over ticks that GetTicksToNextEvent() reports
+     * as empty, then land on the next event at most. Cascades from the greater levels still happen at every wrap.
+     *
+     * @param ticks The number of ticks to move forward.
+     * @param now The time of the slot this lands on.
      */
-    void Increase(void)
+    void Advance(uint64_t ticks, int64_t now)
     {
-        curr_slot_idx_++;
-        if (curr_slot_idx_ < slot_num_)
+        while (ticks > 0)
         {
-            return;
+            uint64_t to_wrap = slot_num_ - curr_slot_idx_;
+            if (ticks < to_wrap)
+            {
+                curr_slot_idx_ += static_cast<uint32_t>(ticks);
+                return;
+            }
+
+            // If the time wheel is full, the greater level time wheel should be increased.
+            // The timers in the current slot of the greater level time wheel should be moved into the current level
+            // time wheel.
+            ticks -= to_wrap;
+            curr_slot_idx_ = 0;
+            if (greater_level_timewheel_ != nullptr)
+            {
+                auto wrap_time = now - static_cast<int64_t>(ticks) * interval_;
+                greater_level_timewheel_->Increase(wrap_time);
+                // Only relinks the jobs; nothing is allocated or reference counted on the way down.
+                auto slot = greater_level_timewheel_->PopCurrentSlot();
+                while (!slot.Empty())
+                {
+                    AddTimer(slot.PopFront(), wrap_time);
+                }
+            }
+        }
+    }
+
+    /**
+     * Returns how many ticks of this time wheel pass before a slot with timers becomes current, either in this wheel or
+     * by a cascade from a greater level.
+     *
+     * Cancelled timers may leave their slot marked as occupied; such slots are found empty here and unmarked, so the
+     * answer can only be early, never late.
+     *
+     * @return The number of ticks, at least 1, or kNoEvent if no wheel from this one up holds a timer.
+     */
+    uint64_t GetTicksToNextEvent()
+    {
+        uint64_t next = kNoEvent;
+        size_t slot = FindOccupiedSlot(curr_slot_idx_ + 1, slot_num_);
+        if (slot < slot_num_)
+        {
+            next = slot - curr_slot_idx_;
+        }
+        else
+        {
+            // Wrap around; the current slot itself is a whole turn away.
+            slot = FindOccupiedSlot(0, curr_slot_idx_ + 1);
+            if (slot <= curr_slot_idx_)
+            {
+                next = slot + slot_num_ - curr_slot_idx_;
+            }
         }
 
-        // If the time wheel is full, the greater level time wheel should be increased.
-        // The timers in the current slot of the greater level time wheel should be moved into the current level time
-        // wheel.
-        curr_slot_idx_ %= slot_num_;
         if (greater_level_timewheel_ != nullptr)
         {
-            greater_level_timewheel_->Increase();
-            auto slot = std::move(greater_level_timewheel_->PopCurrentSlot());
-            for (const auto &timer : slot)
+            auto greater = greater_level_timewheel_->GetTicksToNextEvent();
+            if (greater != kNoEvent)
             {
-                AddTimer(timer);
+                next = std::min<uint64_t>(next, (slot_num_ - curr_slot_idx_) + (greater - 1) * slot_num_);
             }
         }
+        return next;
     }
 
     /**
      * Removes and returns all timers in the current time slot.
      *
-     * @return A list of shared pointers to the timers that were removed.
+     * @return The timers that were removed, still linked to each other.
      */
-    std::list<TimerPtr> PopCurrentSlot()
+    TimerList PopCurrentSlot()
     {
-        auto slot = std::move(slots_[curr_slot_idx_]);
+        TimerList slot;
+        slot.Splice(slots_[curr_slot_idx_]);
+        occupied_[curr_slot_idx_ / 64] &= ~(uint64_t(1) << (curr_slot_idx_ % 64));
         return slot;
     }
 
+    /**
+     * Returned by GetTicksToNextEvent() when there is no timer left.
+     */
+    static constexpr uint64_t kNoEvent = UINT64_MAX;
+
 private:
+    static constexpr uint32_t kNoMask = UINT32_MAX;
+
+    static bool IsPowerOfTwo(uint64_t value)
+    {
+        return value != 0 && (value & (value - 1)) == 0;
+    }
+
+    size_t WrapSlot(uint64_t slot) const
+    {
+        return slot_mask_ != kNoMask ? static_cast<size_t>(slot & slot_mask_) : static_cast<size_t>(slot % slot_num_);
+    }
+
+    // `time` is never negative here, so the shift rounds the same way as the division.
+    int64_t ToSlots(int64_t time) const
+    {
+        return interval_shift_ >= 0 ? time >> interval_shift_ : time / interval_;
+    }
+
+    void Link(size_t slot, TimerNode *timer)
+    {
+        slots_[slot].PushBack(timer);
+        occupied_[slot / 64] |= uint64_t(1) << (slot % 64);
+    }
+
+    // Returns the first occupied slot in [from, to), or `to` if there is none.
+    size_t FindOccupiedSlot(size_t from, size_t to)
+    {
+        while (from < to)
+        {
+            size_t word = from / 64;
+            uint64_t bits = occupied_[word] & (~uint64_t(0) << (from % 64));
+            if (bits == 0)
+            {
+                from = (word + 1) * 64;
+                continue;
+            }
+
+            size_t slot = word * 64 + static_cast<size_t>(__builtin_ctzll(bits));
+            if (slot >= to)
+            {
+                break;
+            }
+            if (slots_[slot].Empty())
+            {
+                // Every timer in the slot has been cancelled or reset elsewhere since it was marked.
+                occupied_[word] &= ~(uint64_t(1) << (slot % 64));
+                from = slot + 1;
+                continue;
+            }
+            return slot;
+        }
+        return to;
+    }
+
     std::string name_;
 
     uint32_t slot_num_;
-    uint32_t interval_in_millisecond_;
+    // slot_num_ - 1 if it is a power of two, kNoMask otherwise.
+    uint32_t slot_mask_;
+    int64_t interval_;
+    // log2(interval_) if it is a power of two, -1 otherwise.
+    int interval_shift_;
     uint32_t curr_slot_idx_;
-    std::vector<std::list<TimerPtr>> slots_;
+    std::vector<TimerList> slots_;
+    // One bit per slot, set while the slot may hold timers.
+    std::vector<uint64_t> occupied_;
 
     TimeWheel *less_level_timewheel_;
     TimeWheel *greater_level_timewheel_;
 };
 
 using TimeWheelPtr = std::shared_ptr<TimeWheel>;
+
+/**
+ * Builds a hierarchy of time wheels that reaches at least `ticks` ticks ahead, linked to each other.
+ *
+ * Every wheel has 64 slots, except for a smaller greatest one, and spans a power of two of ticks, so timers are placed
+ * with masks and shifts and the occupancy of a wheel is a single word. The wheels are named "level0" upwards.
+ *
+ * @param ticks The longest delay to cover, in ticks of the least level wheel.
+ * @return The wheels from the greatest level to the least.
+ */
+inline std::vector<TimeWheelPtr> MakeTimeWheelHierarchy(uint64_t ticks)
+{
+    constexpr int kWheelBits = 6;
+
+    int bits = 1;
+    while (bits < 63 && (uint64_t(1) << bits) < ticks)
+    {
+        ++bits;
+    }
+
+    std::vector<TimeWheelPtr> timewheels;
+    int levels = (bits + kWheelBits - 1) / kWheelBits;
+    for (int level = levels - 1; level >= 0; --level)
+    {
+        int level_bits = std::min(kWheelBits, bits - level * kWheelBits);
+        auto timewheel = std::make_shared<TimeWheel>(uint32_t(1) << level_bits, uint64_t(1) << (level * kWheelBits),
+                                                     "level" + std::to_string(level));
+        if (!timewheels.empty())
+        {
+            timewheels.back()->SetLessLevelTimeWheel(timewheel.get());
+            timewheel->SetGreaterLevelTimeWheel(timewheels.back().get());
+        }
+        timewheels.push_back(timewheel);
+    }
+    return timewheels;
+}
 } // namespace shkwon
\ No newline at end of file
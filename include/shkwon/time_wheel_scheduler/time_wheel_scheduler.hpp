@@ -1,16 +1,108 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <climits>
+#include <condition_variable>
+#include <iterator>
+#include <memory>
 #include <mutex>
+#include <stdexcept>
+#include <string>
 #include <thread>
-#include <unordered_set>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+#include "shkwon/debug/tracer.hpp"
+#include "shkwon/thread_pool/future.hpp"
+#include "shkwon/thread_pool/mpsc_queue.hpp"
 #include "shkwon/thread_pool/thread_pool.hpp"
 #include "shkwon/time_wheel_scheduler/time_wheel.hpp"
+#include "shkwon/time_wheel_scheduler/timer_slab.hpp"
 
 namespace shkwon
 {
+/**
+ * How the thread of a TimeWheelScheduler paces itself.
+ */
+enum class TimerTickMode
+{
+    // Wake up on every tick, whether or not a timer is due.
+    Periodic,
+    // Sleep until the next slot that holds a timer, or until a timer is added in front of it, and jump over the empty
+    // ticks in between in one step. An idle scheduler does not wake up at all.
+    Tickless,
+};
+
+/**
+ * Where a TimeWheelScheduler runs the callbacks of expired timers.
+ */
+enum class TimerExecution
+{
+    // Post every callback to the executor as a job of its own.
+    Post,
+    // Post the callbacks that expire in the same slot as a single job, which saves a hand-off per timer when many of
+    // them expire together.
+    Batched,
+    // Run the callbacks on the scheduler thread. Meant for trivial callbacks such as setting a flag or waking a waiter;
+    // a slow one holds up every timer behind it.
+    Inline,
+};
+
+namespace detail
+{
+// Drops whatever a timer callback throws, as the discarded future of a pool job used to, so that a callback running
+// inline or in a batch cannot take down the scheduler thread or the callbacks after it.
+template <class F>
+struct CatchingTimerTask
+{
+    void operator()()
+    {
+        try
+        {
+            f();
+        }
+        catch (...)
+        {
+        }
+    }
+
+    F f;
+};
+} // namespace detail
+
+/**
+ * A snapshot of how a TimeWheelScheduler is doing.
+ */
+struct TimeWheelSchedulerStats
+{
+    // Timers that have not fired yet, including repeating ones.
+    size_t num_timers = 0;
+    // How late the thread woke up for the tick it last waited for. Every tick that fell due meanwhile was caught up.
+    std::chrono::milliseconds lag{ 0 };
+    // The largest lag seen so far.
+    std::chrono::milliseconds max_lag{ 0 };
+};
+
+/**
+ * Runs tasks at given times on a hierarchy of time wheels.
+ *
+ * Only the scheduler thread touches the wheels. Creating, resetting and cancelling timers pushes a command onto a
+ * lock-free queue that the thread drains at the start of every tick, so callers never wait for the thread and the
+ * thread works on the wheels without a lock. Jobs come from a slab under a lock that is held for the allocation alone,
+ * and that the thread takes once per tick to give back the jobs that are done.
+ *
+ * The hierarchy is either appended wheel by wheel in milliseconds, or built from a resolution and a horizon, which
+ * also allows ticks below a millisecond:
+ *
+ * @code
+ * TimeWheelScheduler scheduler(std::chrono::microseconds(100), std::chrono::hours(24 * 7), TimerTickMode::Tickless);
+ * scheduler.Start();
+ * auto retransmit = scheduler.CreateTimerAfter(std::chrono::microseconds(250), []() { ... });
+ * @endcode
+ */
 class TimeWheelScheduler
 {
 public:
@@ -19,21 +111,74 @@ public:
      *
      * @param interval The minimum time interval in milliseconds between two consecutive
      *                 executions of the timer wheel. The value must be greater than or
-     *                 equal to 1ms and defaults to 50ms.
+     *                 equal to 1ms and defaults to 50ms. Timers never fire before their time, but up
+     *                 to a tick after it.
+     * @param mode Whether the scheduler wakes up on every tick or only when a timer is due.
      */
-    explicit TimeWheelScheduler(uint32_t interval = 50)
-        : stop_flag_(false)
+    explicit TimeWheelScheduler(uint32_t interval = 50, TimerTickMode mode = TimerTickMode::Periodic)
+        : shard_(0)
+        , stop_flag_(false)
         , timer_id_(1)
-        , interval_in_millisecond_(interval)
+        , unit_(std::chrono::milliseconds(1))
+        , tick_(interval)
+        , preset_(false)
+        , tick_mode_(mode)
+        , execution_(TimerExecution::Post)
+        , custom_executor_(false)
+        , wheel_time_(GetTime())
+        , wakeup_time_(INT64_MIN)
+        , lag_(0)
+        , max_lag_(0)
     {
-        if (interval_in_millisecond_.count() < 1)
+        if (tick_ < 1)
         {
             throw std::invalid_argument("TimeoutJob step must be greater than or equal to 10ms.");
         }
     }
 
     /**
-     * Appends a new time wheel to the scheduler with the specified number of slots and interval.
+     * Constructs a TimeWheelScheduler that ticks every `resolution` and builds its own hierarchy of wheels, reaching at
+     * least `horizon` ahead.
+     *
+     * Every wheel has 64 slots, except for a smaller greatest one, and spans a power of two of ticks, so timers are
+     * placed with masks and shifts and the occupancy of a wheel is a single word. 100us to 7 days takes six wheels.
+     * Below a millisecond the tickless mode is usually the better choice; a periodic scheduler wakes up every tick.
+     *
+     * @param resolution The length of a tick, at least 1ns. Timers never fire before their time, but up to a tick
+     *                   after it.
+     * @param horizon The longest delay to place in one go. Timers further ahead are placed at the horizon, then again
+     *                from there until they are due, so they never fire early.
+     * @param mode Whether the scheduler wakes up on every tick or only when a timer is due.
+     */
+    TimeWheelScheduler(std::chrono::nanoseconds resolution, std::chrono::nanoseconds horizon,
+                       TimerTickMode mode = TimerTickMode::Periodic)
+        : shard_(0)
+        , stop_flag_(false)
+        , timer_id_(1)
+        , unit_(resolution)
+        , tick_(1)
+        , preset_(true)
+        , tick_mode_(mode)
+        , execution_(TimerExecution::Post)
+        , custom_executor_(false)
+        , wheel_time_(0)
+        , wakeup_time_(INT64_MIN)
+        , lag_(0)
+        , max_lag_(0)
+    {
+        if (resolution.count() < 1 || horizon < resolution)
+        {
+            throw std::invalid_argument("Timer resolution must be at least 1ns and no longer than the horizon.");
+        }
+        wheel_time_ = GetTime();
+
+        auto ticks = static_cast<uint64_t>((horizon.count() + resolution.count() - 1) / resolution.count());
+        timewheels_ = MakeTimeWheelHierarchy(ticks);
+    }
+
+    /**
+     * Appends a new time wheel to the scheduler with the specified number of slots and interval. The wheels have to be
+     * set up before the first timer is created.
      *
      * @param total_slot_num The total number of slots in the time wheel.
      * @param interval The interval (in milliseconds) between each slot in the time wheel.
@@ -41,38 +186,49 @@ public:
      */
     void AppendTimeWheel(uint32_t total_slot_num, uint32_t interval, const std::string &name = "")
     {
-        auto curr_timewheel = std::make_shared<TimeWheel>(total_slot_num, interval, name);
-        if (timewheels_.empty())
+        if (preset_)
         {
-            timewheels_.push_back(curr_timewheel);
-            return;
+            throw std::logic_error("A TimeWheelScheduler built from a resolution already has its time wheels.");
         }
+        this->AddTimeWheel(total_slot_num, interval, name);
+    }
 
-        auto greater_timewheel = timewheels_.back();
-        greater_timewheel->SetLessLevelTimeWheel(curr_timewheel.get());
-        curr_timewheel->SetGreaterLevelTimeWheel(greater_timewheel.get());
-        timewheels_.push_back(curr_timewheel);
+    /**
+     * Sets how expired timers run. Has to be called before Start().
+     *
+     * @param execution Whether callbacks are posted one by one, posted in batches, or run on the scheduler thread.
+     */
+    void SetExecution(TimerExecution execution)
+    {
+        execution_ = execution;
+    }
+
+    /**
+     * Sets where posted and batched callbacks run, for example a WorkStealingThreadPool shared with other work. Has to
+     * be called before Start(). Without one, Start() creates a ThreadPool of its own.
+     *
+     * @param executor The executor for the callbacks. It has to outlive the scheduler thread.
+     */
+    void SetExecutor(const Executor &executor)
+    {
+        executor_ = executor;
+        custom_executor_ = true;
     }
 
     /**
      * Creates a timer that will execute the given task at the specified time.
      *
-     * @param when The time at which the task will be executed in milliseconds since the Epoch.
-     * @param task The task to execute when the timer expires.
+     * @param when The time at which the task will be executed in milliseconds since the Epoch. It is converted to the
+     *             steady clock once, here, so setting the system clock later does not move the timer.
+     * @param task The task to execute when the timer expires. Any `void()` callable; small ones are stored without
+     *             allocating. Exceptions it throws are ignored.
      *
-     * @return The ID of the newly created timer. Return 0 if the timer creation fails.
+     * @return A handle to the new timer. Empty if the timer creation fails.
      */
-    uint32_t CreateTimerAt(int64_t when, const TimerTask &task)
+    template <class F>
+    TimerHandle CreateTimerAt(int64_t when, F &&task)
     {
-        if (timewheels_.empty())
-        {
-            return 0;
-        }
-
-        std::lock_guard<std::mutex> lock(mutex_);
-        this->GetGreatestTimeWheel()->AddTimer(std::make_shared<TimeoutJob>(timer_id_, when, 0, task));
-
-        return timer_id_++;
+        return this->CreateTimer(FromWallTime(when), 0, std::forward<F>(task));
     }
 
     /**
@@ -81,12 +237,26 @@ public:
      * @param delay The time in milliseconds to wait before executing the task.
      * @param task The task to execute when the timer expires.
      *
-     * @return The ID of the newly created timer. Return 0 if the timer creation fails.
+     * @return A handle to the new timer. Empty if the timer creation fails.
      */
-    uint32_t CreateTimerAfter(int64_t delay, const TimerTask &task)
+    template <class F>
+    TimerHandle CreateTimerAfter(int64_t delay, F &&task)
     {
-        auto when = GetNowTimestamp() + delay;
-        return this->CreateTimerAt(when, task);
+        return this->CreateTimerAfter(std::chrono::milliseconds(delay), std::forward<F>(task));
+    }
+
+    /**
+     * Creates a timer that will execute the given task after the specified delay, rounded up to whole ticks.
+     *
+     * @param delay The time to wait before executing the task.
+     * @param task The task to execute when the timer expires.
+     *
+     * @return A handle to the new timer. Empty if the timer creation fails.
+     */
+    template <class Rep, class Period, class F>
+    TimerHandle CreateTimerAfter(std::chrono::duration<Rep, Period> delay, F &&task)
+    {
+        return this->CreateTimer(ToDeadline(GetSteadyNanoseconds(), delay), 0, std::forward<F>(task));
     }
 
     /**
@@ -95,55 +265,179 @@ public:
      * @param interval The time in milliseconds between periodic task executions.
      * @param task The task to execute.
      *
-     * @return The ID of the created timer. Return 0 if the timer creation fails.
+     * @return A handle to the new timer. Empty if the timer creation fails.
      */
-    uint32_t CreateTimerEvery(int64_t interval, const TimerTask &task)
+    template <class F>
+    TimerHandle CreateTimerEvery(int64_t interval, F &&task)
     {
-        if (timewheels_.empty())
+        return this->CreateTimerEvery(std::chrono::milliseconds(interval), std::forward<F>(task));
+    }
+
+    /**
+     * Creates a timer that executes the given task at a fixed interval, rounded up to whole ticks.
+     *
+     * @param interval The time between periodic task executions, at least one tick.
+     * @param task The task to execute.
+     *
+     * @return A handle to the new timer. Empty if the timer creation fails.
+     */
+    template <class Rep, class Period, class F>
+    TimerHandle CreateTimerEvery(std::chrono::duration<Rep, Period> interval, F &&task)
+    {
+        auto ticks = std::max<int64_t>(ToTicks(interval), 1);
+        return this->CreateTimer(ToDeadline(GetSteadyNanoseconds(), interval), ticks, std::forward<F>(task));
+    }
+
+    /**
+     * Resets the timer to expire at the specified time. The timer moves to its new slot on the next tick.
+     *
+     * @param timer The timer to reset.
+     * @param when The time at which the timer should expire, in milliseconds since epoch. Like in CreateTimerAt(),
+     *             it is converted to the steady clock once.
+     *
+     * @return false if the timer has already fired (for a one-shot timer) or has been cancelled. A timer that falls due
+     *         before the next tick picks up the reset fires at its old time, even though true was returned.
+     */
+    bool ResetTimerAt(const TimerHandle &timer, int64_t when)
+    {
+        return this->ResetTimer(timer, FromWallTime(when));
+    }
+
+    /**
+     * Resets the timer to expire after the specified delay.
+     *
+     * @param timer The timer to reset.
+     * @param delay The time in milliseconds to wait before the timer expires.
+     *
+     * @return false if the timer has already fired (for a one-shot timer) or has been cancelled.
+     */
+    bool ResetTimerAfter(const TimerHandle &timer, int64_t delay)
+    {
+        return this->ResetTimerAfter(timer, std::chrono::milliseconds(delay));
+    }
+
+    /**
+     * Resets the timer to expire after the specified delay, rounded up to whole ticks.
+     *
+     * @param timer The timer to reset.
+     * @param delay The time to wait before the timer expires.
+     *
+     * @return false if the timer has already fired (for a one-shot timer) or has been cancelled.
+     */
+    template <class Rep, class Period>
+    bool ResetTimerAfter(const TimerHandle &timer, std::chrono::duration<Rep, Period> delay)
+    {
+        return this->ResetTimer(timer, ToDeadline(GetSteadyNanoseconds(), delay));
+    }
+
+    /**
+     * Cancels a timer. It takes effect right away: once this returns true, the timer is not fired again. Its job is
+     * unlinked and given back on the next tick.
+     *
+     * @param timer The timer to cancel.
+     *
+     * @return false if the timer has already fired (for a one-shot timer) or has been cancelled.
+     */
+    bool CancelTimer(const TimerHandle &timer)
+    {
+        if (!timer || !timer.job_->TryCancel(timer.id_))
         {
-            return 0;
+            return false;
         }
 
-        std::lock_guard<std::mutex> lock(mutex_);
-        auto when = GetNowTimestamp() + interval;
-        this->GetGreatestTimeWheel()->AddTimer(std::make_shared<TimeoutJob>(timer_id_, when, interval, task));
+        this->Submit(Command{ CommandType::Reclaim, timer.job_, timer.id_, 0 });
+        return true;
+    }
 
-        return timer_id_++;
+    /**
+     * Creates a timer for every element of [first, last), a pair of the time in milliseconds since the Epoch and the
+     * task, as for CreateTimerAt().
+     *
+     * The whole batch takes the slab lock once, reads the clocks once and reaches the scheduler thread as a single
+     * command. The jobs are sorted by expiration time on the calling thread, so that the scheduler thread places each
+     * run of equal times through the wheels once and links the rest of the run right behind it.
+     *
+     * @param first The first timer to create. The range is walked twice, so it has to be a forward range. Pass move
+     *              iterators to move the tasks instead of copying them.
+     * @param last One past the last timer to create.
+     *
+     * @return The handles of the new timers, in the order of the range. Empty if no time wheel has been appended.
+     */
+    template <class ForwardIt>
+    std::vector<TimerHandle> CreateTimersAt(ForwardIt first, ForwardIt last)
+    {
+        auto now = GetSteadyNanoseconds();
+        auto wall_now = GetNowTimestamp();
+        return this->CreateTimers(first, last, [this, now, wall_now](int64_t when) {
+            return ToDeadline(now, when - wall_now);
+        });
     }
 
     /**
-     * Resets the timer with the given ID to expire at the specified time.
+     * Creates a timer for every element of [first, last), a pair of the delay and the task, as for CreateTimerAfter().
+     * See CreateTimersAt().
+     *
+     * @param first The first timer to create. The delay is in milliseconds, or any std::chrono::duration.
+     * @param last One past the last timer to create.
      *
-     * @param id The ID of the timer to reset.
-     * @param when The time at which the timer should expire, in milliseconds since epoch.
+     * @return The handles of the new timers, in the order of the range. Empty if no time wheel has been appended.
      */
-    void ResetTimerAt(uint32_t id, int64_t when)
+    template <class ForwardIt>
+    std::vector<TimerHandle> CreateTimersAfter(ForwardIt first, ForwardIt last)
     {
-        std::lock_guard<std::mutex> lock(mutex_);
-        restart_timer_infos_[id] = when;
+        auto now = GetSteadyNanoseconds();
+        return this->CreateTimers(first, last, [this, now](const auto &delay) { return ToDeadline(now, delay); });
     }
 
     /**
-     * Resets the timer with the given ID to expire after the specified delay.
+     * Cancels every timer in [first, last), as CancelTimer() does, with one push to the command queue.
      *
-     * @param id The ID of the timer to reset.
-     * @param delay The time in milliseconds to wait before the timer expires.
+     * @param first The first handle.
+     * @param last One past the last handle.
+     *
+     * @return The number of timers that were cancelled.
      */
-    void ResetTimerAfter(uint32_t id, int64_t delay)
+    template <class InputIt>
+    size_t CancelTimers(InputIt first, InputIt last)
     {
-        auto when = GetNowTimestamp() + delay;
-        this->ResetTimerAt(id, when);
+        std::vector<Command> commands;
+        for (; first != last; ++first)
+        {
+            const TimerHandle &timer = *first;
+            if (timer && timer.job_->TryCancel(timer.id_))
+            {
+                commands.push_back(Command{ CommandType::Reclaim, timer.job_, timer.id_, 0 });
+            }
+        }
+        this->SubmitBatch(commands, INT64_MAX);
+        return commands.size();
     }
 
     /**
-     * Cancels a timer with the given ID.
+     * Resets every timer in [first, last) to expire after the same delay, read off the clock once, with one push to the
+     * command queue.
      *
-     * @param id The ID of the timer to cancel.
+     * @param first The first handle.
+     * @param last One past the last handle.
+     * @param delay The time to wait before the timers expire, in milliseconds or as any std::chrono::duration.
+     *
+     * @return The number of timers that were still pending. See ResetTimerAt().
      */
-    void CancelTimer(uint32_t id)
+    template <class InputIt, class Delay>
+    size_t ResetTimersAfter(InputIt first, InputIt last, Delay delay)
     {
-        std::lock_guard<std::mutex> lock(mutex_);
-        canceled_timer_ids_.insert(id);
+        auto when = ToDeadline(GetSteadyNanoseconds(), delay);
+        std::vector<Command> commands;
+        for (; first != last; ++first)
+        {
+            const TimerHandle &timer = *first;
+            if (timer && timer.job_->GetID() == timer.id_)
+            {
+                commands.push_back(Command{ CommandType::Reset, timer.job_, timer.id_, when });
+            }
+        }
+        this->SubmitBatch(commands, when);
+        return commands.size();
     }
 
     /**
@@ -158,54 +452,15 @@ public:
             return false;
         }
 
-        thread_pool_ = std::make_unique<ThreadPool>(10);
-        thread_ = std::thread([this]() {
-            while (true)
-            {
-                auto now = std::chrono::system_clock::now();
-
-                {
-                    std::lock_guard<std::mutex> lock(mutex_);
-
-                    if (stop_flag_)
-                    {
-                        break;
-                    }
-
-                    auto least_timewheel = this->GetLeastTimeWheel();
-                    least_timewheel->Increase();
-                    auto slot = std::move(least_timewheel->PopCurrentSlot());
-                    for (const auto &timer : slot)
-                    {
-                        auto it = restart_timer_infos_.find(timer->GetID());
-                        if (it != restart_timer_infos_.end())
-                        {
-                            timer->UpdateExpirationTime(it->second);
-                            this->GetGreatestTimeWheel()->AddTimer(timer);
-                            restart_timer_infos_.erase(it);
-                            continue;
-                        }
-
-                        auto id = canceled_timer_ids_.find(timer->GetID());
-                        if (id != canceled_timer_ids_.end())
-                        {
-                            canceled_timer_ids_.erase(id);
-                            continue;
-                        }
-
-                        thread_pool_->Push([timer]() { timer->Run(); });
-
-                        if (timer->IsRepeated())
-                        {
-                            timer->UpdateExpirationTime();
-                            this->GetGreatestTimeWheel()->AddTimer(timer);
-                        }
-                    }
-                }
-
-                std::this_thread::sleep_until(now + interval_in_millisecond_);
-            }
-        });
+        if (!custom_executor_ && execution_ != TimerExecution::Inline)
+        {
+            // Keep one worker around and grow to ten while callbacks pile up, instead of parking ten threads all day.
+            ThreadPoolOptions pool_options(1);
+            pool_options.max_threads = 10;
+            thread_pool_ = std::make_unique<ThreadPool>(pool_options);
+            executor_ = Executor(*thread_pool_);
+        }
+        thread_ = std::thread([this]() { this->Run(); });
 
         return true;
     }
@@ -215,42 +470,579 @@ public:
      */
     void Stop(void)
     {
+        stop_flag_.store(true);
         {
             std::lock_guard<std::mutex> lock(mutex_);
-            stop_flag_ = true;
+            cv_.notify_one();
         }
 
         thread_.join();
     }
 
+    TimerTickMode GetTickMode() const
+    {
+        return tick_mode_;
+    }
+
+    /**
+     * @return The length of a tick.
+     */
+    std::chrono::nanoseconds GetResolution() const
+    {
+        return unit_ * tick_;
+    }
+
+    /**
+     * @return The number of pending timers and how far the scheduler thread has fallen behind its tick schedule.
+     */
+    TimeWheelSchedulerStats GetStats()
+    {
+        TimeWheelSchedulerStats stats;
+        {
+            std::lock_guard<std::mutex> lock(slab_mutex_);
+            stats.num_timers = jobs_.GetNumAllocated();
+        }
+        stats.lag = std::chrono::duration_cast<std::chrono::milliseconds>(unit_ * lag_.load(std::memory_order_relaxed));
+        stats.max_lag =
+            std::chrono::duration_cast<std::chrono::milliseconds>(unit_ * max_lag_.load(std::memory_order_relaxed));
+        return stats;
+    }
+
 private:
-    TimeWheelPtr GetGreatestTimeWheel()
+    friend class ShardedTimeWheelScheduler;
+
+    enum class CommandType
     {
+        // Link a new job into the wheels.
+        Add,
+        // Link a batch of new jobs, sorted by expiration time and chained through `prev`, into the wheels.
+        AddBatch,
+        // Move a job to `when`.
+        Reset,
+        // Unlink a cancelled job and give it back to the slab.
+        Reclaim,
+    };
+
+    struct Command
+    {
+        CommandType type;
+        TimeoutJob *job;
+        // The ID the job had when the command was made, so that a command for a timer that is gone does nothing.
+        uint32_t id;
+        int64_t when;
+    };
+
+    void AddTimeWheel(uint32_t total_slot_num, uint64_t interval, const std::string &name)
+    {
+        auto curr_timewheel = std::make_shared<TimeWheel>(total_slot_num, interval, name);
         if (timewheels_.empty())
         {
-            return TimeWheelPtr();
+            timewheels_.push_back(curr_timewheel);
+            return;
         }
-        return timewheels_.front();
+
+        auto greater_timewheel = timewheels_.back();
+        greater_timewheel->SetLessLevelTimeWheel(curr_timewheel.get());
+        curr_timewheel->SetGreaterLevelTimeWheel(greater_timewheel.get());
+        timewheels_.push_back(curr_timewheel);
+    }
+
+    static int64_t GetSteadyNanoseconds()
+    {
+        auto now = std::chrono::steady_clock::now().time_since_epoch();
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+    }
+
+    // The steady clock in units of unit_, which is what the wheels and every internal timestamp run on.
+    int64_t GetTime() const
+    {
+        return GetSteadyNanoseconds() / unit_.count();
+    }
+
+    // The expiration time of a timer due `delay` after `now`, in nanoseconds of the steady clock. The sum is rounded up
+    // to a whole unit once: the wheels fire a slot as soon as the clock reaches its start, so rounding down would let
+    // the timer fire early, and rounding the time and the delay up separately would make it up to a unit later still.
+    template <class Rep, class Period>
+    int64_t ToDeadline(int64_t now, std::chrono::duration<Rep, Period> delay) const
+    {
+        auto ns = now + std::chrono::duration_cast<std::chrono::nanoseconds>(delay).count();
+        return ns > 0 ? (ns + unit_.count() - 1) / unit_.count() : ns / unit_.count();
+    }
+
+    // A delay in milliseconds.
+    int64_t ToDeadline(int64_t now, int64_t delay) const
+    {
+        return ToDeadline(now, std::chrono::milliseconds(delay));
     }
-    TimeWheelPtr GetLeastTimeWheel()
+
+    // Rounds up, so that a repeating timer never fires more often than its interval.
+    template <class Rep, class Period>
+    int64_t ToTicks(std::chrono::duration<Rep, Period> duration) const
+    {
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+        return ns > 0 ? (ns + unit_.count() - 1) / unit_.count() : ns / unit_.count();
+    }
+
+    int64_t FromWallTime(int64_t wall_time) const
+    {
+        return ToDeadline(GetSteadyNanoseconds(), wall_time - GetNowTimestamp());
+    }
+
+    // `when(element.first)` gives the expiration time of every element.
+    template <class ForwardIt, class When>
+    std::vector<TimerHandle> CreateTimers(ForwardIt first, ForwardIt last, When when)
+    {
+        std::vector<TimerHandle> handles;
+        if (timewheels_.empty() || first == last)
+        {
+            return handles;
+        }
+
+        std::vector<TimeoutJob *> jobs(static_cast<size_t>(std::distance(first, last)));
+        {
+            std::lock_guard<std::mutex> lock(slab_mutex_);
+            for (auto &job : jobs)
+            {
+                job = jobs_.Allocate();
+            }
+        }
+
+        handles.reserve(jobs.size());
+        try
+        {
+            for (auto *job : jobs)
+            {
+                auto &&timer = *first++;
+                using TaskType = typename std::decay<decltype(timer.second)>::type;
+                auto id = this->NextID();
+                job->Assign(id, when(timer.first), 0,
+                            detail::CatchingTimerTask<TaskType>{ std::forward<decltype(timer)>(timer).second });
+                handles.push_back(TimerHandle(job, id, shard_));
+            }
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(slab_mutex_);
+            for (auto *job : jobs)
+            {
+                jobs_.Free(job);
+            }
+            throw;
+        }
+
+        std::stable_sort(jobs.begin(), jobs.end(), [](const TimeoutJob *lhs, const TimeoutJob *rhs) {
+            return lhs->GetExpirationTime() < rhs->GetExpirationTime();
+        });
+        for (size_t i = 0; i + 1 < jobs.size(); ++i)
+        {
+            jobs[i]->prev = jobs[i + 1];
+        }
+        this->Submit(Command{ CommandType::AddBatch, jobs.front(), 0, jobs.front()->GetExpirationTime() });
+        return handles;
+    }
+
+    template <class F>
+    TimerHandle CreateTimer(int64_t when, int64_t interval, F &&task)
+    {
+        if (timewheels_.empty())
+        {
+            return TimerHandle();
+        }
+
+        auto id = this->NextID();
+        TimeoutJob *job;
+        {
+            std::lock_guard<std::mutex> lock(slab_mutex_);
+            job = jobs_.Allocate();
+        }
+        job->Assign(id, when, interval,
+                    detail::CatchingTimerTask<typename std::decay<F>::type>{ std::forward<F>(task) });
+        this->Submit(Command{ CommandType::Add, job, id, when });
+        return TimerHandle(job, id, shard_);
+    }
+
+    bool ResetTimer(const TimerHandle &timer, int64_t when)
+    {
+        // The slab never frees a job, so a stale handle still points at a valid job and only the ID tells it has moved
+        // on. The thread checks the ID again when it applies the reset.
+        if (!timer || timer.job_->GetID() != timer.id_)
+        {
+            return false;
+        }
+
+        this->Submit(Command{ CommandType::Reset, timer.job_, timer.id_, when });
+        return true;
+    }
+
+    uint32_t NextID()
+    {
+        while (true)
+        {
+            auto id = timer_id_.fetch_add(1, std::memory_order_relaxed);
+            // Zero marks a released job.
+            if (id != 0 && id != TimeoutJob::kCancelledID)
+            {
+                return id;
+            }
+        }
+    }
+
+    void Submit(const Command &command)
+    {
+        commands_.Push(command);
+        this->WakeUpFor(command.type == CommandType::Reclaim ? INT64_MAX : command.when);
+    }
+
+    void SubmitBatch(const std::vector<Command> &commands, int64_t earliest)
+    {
+        if (commands.empty())
+        {
+            return;
+        }
+        commands_.PushBatch(commands.begin(), commands.end());
+        this->WakeUpFor(earliest);
+    }
+
+    // Pairs with the thread publishing its wake-up time before it looks at the queue one last time: either it sees the
+    // new commands, or this sees the wake-up time and wakes it.
+    void WakeUpFor(int64_t when)
+    {
+        if (tick_mode_ == TimerTickMode::Tickless && when < wakeup_time_.load())
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            cv_.notify_one();
+        }
+    }
+
+    // Ticks run on an absolute schedule, at wheel_time_ plus a whole number of intervals, so a late wake-up does not
+    // push back the ticks after it. Whatever fell due meanwhile is caught up in one batch.
+    void Run()
+    {
+#if defined(SHKWON_ENABLE_TRACING)
+        Tracer::Get().SetThreadName("TimeWheelScheduler");
+#endif
+        auto planned = INT64_MIN;
+        while (!stop_flag_.load())
+        {
+            auto now = GetTime();
+            if (planned != INT64_MIN && now >= planned)
+            {
+                auto lag = now - planned;
+                lag_.store(lag, std::memory_order_relaxed);
+                if (lag > max_lag_.load(std::memory_order_relaxed))
+                {
+                    max_lag_.store(lag, std::memory_order_relaxed);
+                }
+            }
+
+            {
+                SHKWON_TRACE_SCOPE("TimeWheelScheduler::Tick");
+                // New timers are placed against the current slot, so move over the ticks slept through first.
+                this->SkipEmptyTicks(now);
+                this->ApplyCommands();
+                this->AdvanceTo(now);
+                this->FreeReleasedJobs();
+            }
+
+            auto ticks = uint64_t(1);
+            if (tick_mode_ == TimerTickMode::Tickless)
+            {
+                ticks = this->GetLeastTimeWheel()->GetTicksToNextEvent();
+            }
+            planned = ticks == TimeWheel::kNoEvent
+                          ? INT64_MAX
+                          : wheel_time_ + static_cast<int64_t>(ticks) * tick_;
+
+            std::unique_lock<std::mutex> lock(mutex_);
+            wakeup_time_.store(planned);
+            if (stop_flag_.load() || (tick_mode_ == TimerTickMode::Tickless && !commands_.IsEmpty()))
+            {
+                wakeup_time_.store(INT64_MIN);
+                planned = INT64_MIN;
+                continue;
+            }
+
+            // A tickless thread is woken up early when a timer is added in front of this one; the loop then plans
+            // again.
+            if (planned == INT64_MAX)
+            {
+                cv_.wait(lock);
+                planned = INT64_MIN;
+            }
+            else
+            {
+                std::chrono::steady_clock::time_point wakeup{ std::chrono::duration_cast<
+                    std::chrono::steady_clock::duration>(unit_ * planned) };
+                cv_.wait_until(lock, wakeup);
+            }
+            wakeup_time_.store(INT64_MIN);
+        }
+    }
+
+    void ApplyCommands()
+    {
+        Command command;
+        while (commands_.TryPop(command))
+        {
+            auto *job = command.job;
+            switch (command.type)
+            {
+            case CommandType::Add:
+                // Skipped if the timer was cancelled before it got here; its Reclaim follows.
+                if (job->GetID() == command.id)
+                {
+                    this->Place(job);
+                }
+                break;
+            case CommandType::AddBatch:
+                this->AddBatch(job);
+                break;
+            case CommandType::Reset:
+                if (job->GetID() == command.id)
+                {
+                    TimerList::Unlink(job);
+                    job->UpdateExpirationTime(command.when);
+                    this->Place(job);
+                }
+                break;
+            case CommandType::Reclaim:
+                TimerList::Unlink(job);
+                released_.push_back(job);
+                break;
+            }
+        }
+    }
+
+    // Adds a job to the wheels, at most as far ahead as the greatest wheel reaches from where the wheels are. A job
+    // further ahead comes up early and is placed again by FireTimers(). Otherwise it is placed at the first tick at or
+    // after its expiration time: a slot fires as soon as the wheels reach its start, so a job placed by its expiration
+    // time alone would fire up to a tick early whenever a tick is longer than a unit.
+    void Place(TimeoutJob *job)
+    {
+        auto *greatest = this->GetGreatestTimeWheel();
+        auto delay = job->GetExpirationTime() - wheel_time_;
+        auto reach = greatest->GetReach();
+        job->when = wheel_time_ + (delay > reach ? reach : (delay + tick_ - 1) / tick_ * tick_);
+        greatest->AddTimer(job, wheel_time_);
+    }
+
+    // The jobs come sorted by expiration time. A job due at the same time as the one before it goes to the same slot, so
+    // it is linked right behind that one instead of being placed through the wheels again.
+    void AddBatch(TimeoutJob *job)
+    {
+        TimeoutJob *placed = nullptr;
+        while (job != nullptr)
+        {
+            auto *next = static_cast<TimeoutJob *>(job->prev);
+            job->prev = nullptr;
+            // A job cancelled before it got here is left to its Reclaim command, which follows.
+            if (!job->IsCancelled())
+            {
+                if (placed != nullptr && placed->GetExpirationTime() == job->GetExpirationTime())
+                {
+                    job->when = placed->when;
+                    TimerList::InsertAfter(placed, job);
+                }
+                else
+                {
+                    this->Place(job);
+                }
+                placed = job;
+            }
+            job = next;
+        }
+    }
+
+    // Moves the wheels forward to `now`, firing the due timers and jumping over every run of empty ticks at once.
+    void AdvanceTo(int64_t now)
+    {
+        if (now <= wheel_time_)
+        {
+            return;
+        }
+
+        auto least_timewheel = this->GetLeastTimeWheel();
+        auto interval = tick_;
+        auto elapsed = static_cast<uint64_t>((now - wheel_time_) / interval);
+        while (elapsed > 0)
+        {
+            auto ticks = least_timewheel->GetTicksToNextEvent();
+            if (ticks == TimeWheel::kNoEvent)
+            {
+                // Nothing is placed against the old position, so the wheels need not move at all.
+                wheel_time_ += static_cast<int64_t>(elapsed) * interval;
+                return;
+            }
+            if (ticks > elapsed)
+            {
+                wheel_time_ += static_cast<int64_t>(elapsed) * interval;
+                least_timewheel->Advance(elapsed, wheel_time_);
+                return;
+            }
+
+            elapsed -= ticks;
+            wheel_time_ += static_cast<int64_t>(ticks) * interval;
+            least_timewheel->Advance(ticks, wheel_time_);
+            this->FireTimers(least_timewheel->PopCurrentSlot());
+        }
+    }
+
+    // Moves the wheels forward to `now` like AdvanceTo(), but stops short of the next event, so nothing fires. It also
+    // stops a tick short of `now`, so that a timer added just before and already due goes to the slot that AdvanceTo()
+    // fires right after, instead of the one a tick later.
+    void SkipEmptyTicks(int64_t now)
+    {
+        if (now <= wheel_time_)
+        {
+            return;
+        }
+
+        auto interval = tick_;
+        auto elapsed = static_cast<uint64_t>((now - wheel_time_) / interval);
+        if (elapsed == 0)
+        {
+            return;
+        }
+        --elapsed;
+        auto ticks = this->GetLeastTimeWheel()->GetTicksToNextEvent();
+        if (ticks == TimeWheel::kNoEvent)
+        {
+            wheel_time_ += static_cast<int64_t>(elapsed) * interval;
+            return;
+        }
+
+        elapsed = std::min(elapsed, ticks - 1);
+        wheel_time_ += static_cast<int64_t>(elapsed) * interval;
+        this->GetLeastTimeWheel()->Advance(elapsed, wheel_time_);
+    }
+
+    void FireTimers(TimerList slot)
+    {
+        while (!slot.Empty())
+        {
+            auto *timer = static_cast<TimeoutJob *>(slot.PopFront());
+            if (timer->GetExpirationTime() > wheel_time_)
+            {
+                // Placed at the horizon; there is still some way to go.
+                this->Place(timer);
+                continue;
+            }
+            if (!timer->IsRepeated())
+            {
+                // A timer cancelled in the meantime is left to its Reclaim command.
+                if (timer->TryClaim())
+                {
+                    this->Dispatch(timer->TakeTask());
+                    released_.push_back(timer);
+                }
+                continue;
+            }
+
+            if (timer->IsCancelled())
+            {
+                continue;
+            }
+            this->Dispatch([task = timer->GetRepeatedTask()]() { (*task)(); });
+            timer->UpdateExpirationTime();
+            this->Place(timer);
+        }
+
+        if (!batch_.empty())
+        {
+            executor_.Execute([batch = std::move(batch_)]() mutable {
+                for (auto &task : batch)
+                {
+                    task();
+                }
+            });
+            batch_.clear();
+        }
+    }
+
+    void Dispatch(Task task)
+    {
+        switch (execution_)
+        {
+        case TimerExecution::Post:
+            executor_.Execute(std::move(task));
+            break;
+        case TimerExecution::Batched:
+            batch_.push_back(std::move(task));
+            break;
+        case TimerExecution::Inline:
+            task();
+            break;
+        }
+    }
+
+    void FreeReleasedJobs()
+    {
+        if (released_.empty())
+        {
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(slab_mutex_);
+        for (auto *job : released_)
+        {
+            jobs_.Free(job);
+        }
+        released_.clear();
+    }
+
+    TimeWheel *GetGreatestTimeWheel()
     {
         if (timewheels_.empty())
         {
-            return TimeWheelPtr();
+            return nullptr;
         }
-        return timewheels_.back();
+        return timewheels_.front().get();
     }
+    TimeWheel *GetLeastTimeWheel()
+    {
+        if (timewheels_.empty())
+        {
+            return nullptr;
+        }
+        return timewheels_.back().get();
+    }
+
+    // The index of this scheduler within a ShardedTimeWheelScheduler, recorded in its handles.
+    uint32_t shard_;
 
+    // Only used to put the thread to sleep and wake it up.
     std::mutex mutex_;
+    std::condition_variable cv_;
     std::thread thread_;
     std::unique_ptr<ThreadPool> thread_pool_;
+    Executor executor_;
 
-    bool stop_flag_;
-    uint32_t timer_id_;
-    std::chrono::milliseconds interval_in_millisecond_;
+    std::atomic<bool> stop_flag_;
+    std::atomic<uint32_t> timer_id_;
+    // The unit of every internal timestamp: a millisecond, or the resolution for a scheduler built from one.
+    std::chrono::nanoseconds unit_;
+    // The length of a tick of the least level time wheel, in units.
+    int64_t tick_;
+    // Whether the wheels were built from a resolution.
+    bool preset_;
+    TimerTickMode tick_mode_;
+    TimerExecution execution_;
+    bool custom_executor_;
+    // The steady time, in units, of the current slot of the least level time wheel. New timers are placed relative to it.
+    int64_t wheel_time_;
+    // When the thread is due to wake up; INT64_MAX while a tickless thread waits for a timer, INT64_MIN while the
+    // thread is not waiting.
+    std::atomic<int64_t> wakeup_time_;
+    std::atomic<int64_t> lag_;
+    std::atomic<int64_t> max_lag_;
 
+    MpscQueue<Command> commands_;
     std::vector<TimeWheelPtr> timewheels_;
-    std::unordered_set<uint32_t> canceled_timer_ids_;
-    std::unordered_map<uint32_t, int64_t> restart_timer_infos_;
+    std::mutex slab_mutex_;
+    TimerSlab jobs_;
+    // Jobs that are done, given back to the slab once per tick. Only used by the scheduler thread.
+    std::vector<TimeoutJob *> released_;
+    // The callbacks of the slot being fired, for TimerExecution::Batched. Only used by the scheduler thread.
+    std::vector<Task> batch_;
 };
-} // namespace shkwon
\ No newline at end of file
+} // namespace shkwon
@@ -1,14 +1,64 @@
 #pragma once
 
+#include <atomic>
+#include <cstdint>
 #include <functional>
+#include <memory>
+#include <utility>
+
+#include "shkwon/thread_pool/task.hpp"
 
 namespace shkwon
 {
 typedef std::function<void()> TimerTask;
 
-class TimeoutJob
+/**
+ * The links of a node in a TimerList.
+ */
+struct TimerLink
+{
+    TimerLink *prev = nullptr;
+    TimerLink *next = nullptr;
+};
+
+/**
+ * A node of a TimeWheel: its links and the time it is placed at, in the unit of the wheel.
+ *
+ * TimeoutJob builds on it, and so can anything else that only needs to be found again when its time comes.
+ */
+struct TimerNode : TimerLink
+{
+    int64_t when = 0;
+
+    bool IsLinked() const noexcept
+    {
+        return next != nullptr;
+    }
+};
+
+/**
+ * A timer as stored in the slots of a TimeWheel.
+ *
+ * The job carries its own list links and stores its task in a Task, so a one-shot timer with a small callable needs no
+ * allocation beyond its slot in a TimerSlab. A repeating timer keeps its task in a shared Task instead, because every
+ * firing hands the pool a reference to it while the job stays in the wheel.
+ *
+ * The job expires at its expiration time, but may be placed earlier, at the horizon of the wheels, as its `when`; the
+ * scheduler places it again from there until it is due.
+ *
+ * Everything but the ID belongs to the thread that owns the wheels. The ID is atomic so that other threads can check a
+ * handle against it and cancel the timer by swapping it for kCancelledID, which the owner then respects.
+ */
+class TimeoutJob : public TimerNode
 {
 public:
+    TimeoutJob() noexcept
+        : when_(0)
+        , interval_(0)
+        , id_(0)
+    {
+    }
+
     /**
      * @brief Constructs a new TimeoutJob object with the specified ID, expiration time, interval, and task.
      *
@@ -17,26 +67,113 @@ public:
      * @param interval The interval (in milliseconds) between repeated executions of the timer task.
      * @param task The task to be executed when the timer expires.
      */
-    TimeoutJob(uint32_t id, int64_t when, int64_t interval, const TimerTask &task)
-        : id_(id)
-        , when_(when)
-        , interval_(interval)
-        , is_repeated_(interval > 0)
-        , task_(task)
+    template <class F>
+    TimeoutJob(uint32_t id, int64_t when, int64_t interval, F &&task)
+        : TimeoutJob()
+    {
+        Assign(id, when, interval, std::forward<F>(task));
+    }
+
+    TimeoutJob(const TimeoutJob &) = delete;
+    TimeoutJob &operator=(const TimeoutJob &) = delete;
+
+    /**
+     * The ID of a job that has been cancelled but not released yet. Never handed out to a timer.
+     */
+    static constexpr uint32_t kCancelledID = UINT32_MAX;
+
+    /**
+     * Reuses a released job for a new timer.
+     *
+     * @param id The ID of the new timer.
+     * @param when The time (in milliseconds) when the timer should expire.
+     * @param interval The interval (in milliseconds) between repeated executions of the timer task.
+     * @param task The task to be executed when the timer expires.
+     */
+    template <class F>
+    void Assign(uint32_t id, int64_t when, int64_t interval, F &&task)
+    {
+        id_.store(id, std::memory_order_relaxed);
+        TimerNode::when = when;
+        when_ = when;
+        interval_ = interval;
+        if (interval > 0)
+        {
+            repeated_task_ = std::make_shared<Task>(std::forward<F>(task));
+        }
+        else
+        {
+            task_ = Task(std::forward<F>(task));
+        }
+    }
+
+    /**
+     * Marks the job as free, which invalidates every TimerHandle that still refers to it.
+     */
+    void Release()
     {
+        id_.store(0, std::memory_order_release);
+        task_.Reset();
+        repeated_task_.reset();
     }
 
-    void Run(void) const
+    void Run(void)
     {
-        if (task_)
+        if (repeated_task_)
+        {
+            (*repeated_task_)();
+        }
+        else if (task_)
         {
             task_();
         }
     }
 
+    /**
+     * Moves the task out of a one-shot job that is about to be released.
+     */
+    Task TakeTask()
+    {
+        return std::move(task_);
+    }
+
+    /**
+     * @return The task of a repeating job, shared with the firings that are still running.
+     */
+    const std::shared_ptr<Task> &GetRepeatedTask() const
+    {
+        return repeated_task_;
+    }
+
     uint32_t GetID() const
     {
-        return id_;
+        return id_.load(std::memory_order_acquire);
+    }
+
+    /**
+     * Cancels the timer if it still has the given ID. May be called from any thread.
+     *
+     * @return false if the timer has fired (one-shot), been cancelled, or the job has moved on to another timer.
+     */
+    bool TryCancel(uint32_t id)
+    {
+        return id_.compare_exchange_strong(id, kCancelledID, std::memory_order_acq_rel);
+    }
+
+    /**
+     * Claims a due one-shot timer for firing, which makes later cancels fail.
+     *
+     * @return false if the timer has been cancelled first.
+     */
+    bool TryClaim()
+    {
+        auto id = id_.load(std::memory_order_acquire);
+        return id != kCancelledID && id_.compare_exchange_strong(id, 0, std::memory_order_acq_rel);
+    }
+
+    bool IsCancelled() const
+    {
+        return id_.load(std::memory_order_acquire) == kCancelledID;
     }
 
     int64_t GetExpirationTime() const
@@ -46,7 +183,7 @@ public:
 
     bool IsRepeated() const
     {
-        return is_repeated_;
+        return interval_ > 0;
     }
 
     void UpdateExpirationTime(int64_t new_when = 0)
@@ -59,15 +196,153 @@ public:
         {
             when_ += interval_;
         }
+        when = when_;
     }
 
 private:
-    uint32_t id_;
     int64_t when_;
     int64_t interval_;
-    bool is_repeated_;
-    TimerTask task_;
+    std::atomic<uint32_t> id_;
+    Task task_;
+    std::shared_ptr<Task> repeated_task_;
 };
 
-using TimerPtr = std::shared_ptr<TimeoutJob>;
-} // namespace shkwon
\ No newline at end of file
+/**
+ * An intrusive doubly linked list of TimerNodes, used for the slots of a TimeWheel.
+ *
+ * The links live in the nodes themselves, so linking, unlinking and splicing never allocate, and a node can be unlinked
+ * in O(1) without knowing which list it is in. The list does not own its nodes; its users cast them back to what they
+ * are part of.
+ */
+class TimerList
+{
+public:
+    TimerList() noexcept
+    {
+        head_.prev = &head_;
+        head_.next = &head_;
+    }
+
+    TimerList(TimerList &&other) noexcept
+        : TimerList()
+    {
+        Splice(other);
+    }
+
+    TimerList(const TimerList &) = delete;
+    TimerList &operator=(const TimerList &) = delete;
+
+    bool Empty() const noexcept
+    {
+        return head_.next == &head_;
+    }
+
+    void PushBack(TimerNode *job) noexcept
+    {
+        job->prev = head_.prev;
+        job->next = &head_;
+        head_.prev->next = job;
+        head_.prev = job;
+    }
+
+    TimerNode *PopFront() noexcept
+    {
+        auto *job = static_cast<TimerNode *>(head_.next);
+        Unlink(job);
+        return job;
+    }
+
+    /**
+     * Moves every job of `other` to the end of this list in O(1).
+     */
+    void Splice(TimerList &other) noexcept
+    {
+        if (other.Empty())
+        {
+            return;
+        }
+
+        TimerLink *first = other.head_.next;
+        TimerLink *last = other.head_.prev;
+        first->prev = head_.prev;
+        last->next = &head_;
+        head_.prev->next = first;
+        head_.prev = last;
+
+        other.head_.prev = &other.head_;
+        other.head_.next = &other.head_;
+    }
+
+    /**
+     * Links `job` right behind `pos`, in whichever list `pos` is in.
+     */
+    static void InsertAfter(TimerNode *pos, TimerNode *job) noexcept
+    {
+        job->prev = pos;
+        job->next = pos->next;
+        pos->next->prev = job;
+        pos->next = job;
+    }
+
+    /**
+     * Removes a job from whichever list it is in. Does nothing if it is not in a list.
+     */
+    static void Unlink(TimerNode *job) noexcept
+    {
+        if (!job->IsLinked())
+        {
+            return;
+        }
+
+        job->prev->next = job->next;
+        job->next->prev = job->prev;
+        job->prev = nullptr;
+        job->next = nullptr;
+    }
+
+private:
+    TimerLink head_;
+};
+
+/**
+ * Refers to a timer created by a TimeWheelScheduler, for cancelling or resetting it.
+ *
+ * A handle outlives its timer safely: once a one-shot timer has fired or a timer has been cancelled, operations on the
+ * handle simply report that the timer is gone. A default-constructed handle refers to no timer.
+ */
+class TimerHandle
+{
+public:
+    TimerHandle() noexcept
+        : job_(nullptr)
+        , id_(0)
+        , shard_(0)
+    {
+    }
+
+    explicit operator bool() const noexcept
+    {
+        return job_ != nullptr;
+    }
+
+    uint32_t GetID() const noexcept
+    {
+        return id_;
+    }
+
+private:
+    friend class TimeWheelScheduler;
+    friend class ShardedTimeWheelScheduler;
+
+    TimerHandle(TimeoutJob *job, uint32_t id, uint32_t shard) noexcept
+        : job_(job)
+        , id_(id)
+        , shard_(shard)
+    {
+    }
+
+    TimeoutJob *job_;
+    uint32_t id_;
+    uint32_t shard_;
+};
+} // namespace shkwon
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "shkwon/time_wheel_scheduler/timeout_job.hpp"
+
+namespace shkwon
+{
+/**
+ * A slab allocator for TimeoutJobs.
+ *
+ * Jobs are allocated in chunks of contiguous storage and recycled through an intrusive free list, so creating and
+ * finishing timers does not touch the heap once the slab has grown to the number of live timers. Jobs are never
+ * returned to the heap before the slab is destroyed, which is what lets a TimerHandle safely look at the job it
+ * refers to long after the timer is gone. Not thread-safe.
+ */
+class TimerSlab
+{
+public:
+    /**
+     * @param chunk_size The number of jobs allocated at once when the free list runs dry.
+     */
+    explicit TimerSlab(size_t chunk_size = 4096)
+        : chunk_size_(chunk_size == 0 ? 1 : chunk_size)
+        , free_(nullptr)
+        , num_allocated_(0)
+    {
+    }
+
+    TimerSlab(const TimerSlab &) = delete;
+    TimerSlab &operator=(const TimerSlab &) = delete;
+
+    /**
+     * @return A released job, not linked into any list.
+     */
+    TimeoutJob *Allocate()
+    {
+        if (free_ == nullptr)
+        {
+            Grow();
+        }
+
+        auto *job = free_;
+        free_ = static_cast<TimeoutJob *>(job->prev);
+        job->prev = nullptr;
+        ++num_allocated_;
+        return job;
+    }
+
+    /**
+     * Releases a job and puts it back on the free list. The job must not be linked into any list.
+     */
+    void Free(TimeoutJob *job)
+    {
+        job->Release();
+        // The free list goes through `prev`, so that `next` keeps telling that the job is not linked.
+        job->prev = free_;
+        free_ = job;
+        --num_allocated_;
+    }
+
+    size_t GetNumAllocated() const noexcept
+    {
+        return num_allocated_;
+    }
+
+    size_t GetCapacity() const noexcept
+    {
+        return chunks_.size() * chunk_size_;
+    }
+
+private:
+    void Grow()
+    {
+        chunks_.emplace_back(new TimeoutJob[chunk_size_]);
+        auto *chunk = chunks_.back().get();
+        // Thread the new jobs so that they are handed out in address order.
+        for (size_t i = chunk_size_; i-- > 0;)
+        {
+            chunk[i].prev = free_;
+            free_ = &chunk[i];
+        }
+    }
+
+    size_t chunk_size_;
+    std::vector<std::unique_ptr<TimeoutJob[]>> chunks_;
+    TimeoutJob *free_;
+    size_t num_allocated_;
+};
+} // namespace shkwon
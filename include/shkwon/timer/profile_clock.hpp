@@ -0,0 +1,78 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+#if defined(SHKWON_PROFILE_TSC) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#define SHKWON_PROFILE_USE_TSC
+#endif
+
+namespace shkwon
+{
+/**
+ * The clock of the profiler and the tracer: the steady clock in nanoseconds, or the time stamp counter of the CPU if
+ * SHKWON_PROFILE_TSC is defined on x86, which reads in a few cycles but needs an invariant TSC to be right across cores.
+ * Ticks are converted to nanoseconds only when the stats are collected or the events written out.
+ */
+class ProfileClock
+{
+public:
+    static uint64_t Now() noexcept
+    {
+#if defined(SHKWON_PROFILE_USE_TSC)
+        return __rdtsc();
+#else
+        return static_cast<uint64_t>(GetSteadyNanoseconds());
+#endif
+    }
+
+    /**
+     * Returns the length of a tick. The TSC is measured against the steady clock since the profiler started, waiting
+     * for 10ms to have passed if need be.
+     */
+    static double GetNanosecondsPerTick()
+    {
+#if defined(SHKWON_PROFILE_USE_TSC)
+        auto &origin = GetOrigin();
+        auto elapsed = GetSteadyNanoseconds() - origin.nanoseconds;
+        if (elapsed < 10 * 1000 * 1000)
+        {
+            std::this_thread::sleep_for(std::chrono::nanoseconds(10 * 1000 * 1000 - elapsed));
+            elapsed = GetSteadyNanoseconds() - origin.nanoseconds;
+        }
+        return static_cast<double>(elapsed) / static_cast<double>(__rdtsc() - origin.ticks);
+#else
+        return 1.0;
+#endif
+    }
+
+    /**
+     * Takes the reference point for GetNanosecondsPerTick(). Called when the profiler or the tracer starts.
+     */
+    static void Calibrate()
+    {
+        GetOrigin();
+    }
+
+private:
+    struct Origin
+    {
+        int64_t nanoseconds;
+        uint64_t ticks;
+    };
+
+    static int64_t GetSteadyNanoseconds() noexcept
+    {
+        auto now = std::chrono::steady_clock::now().time_since_epoch();
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+    }
+
+    static Origin &GetOrigin()
+    {
+        static Origin origin{ GetSteadyNanoseconds(), Now() };
+        return origin;
+    }
+};
+} // namespace shkwon
@@ -0,0 +1,448 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "shkwon/timer/profile_clock.hpp"
+
+/**
+ * Times the rest of the enclosing scope as the zone `name`, which must be a string literal, e.g.
+ * SHKWON_PROFILE_SCOPE("parse"). Expands to nothing unless SHKWON_ENABLE_PROFILER is defined, which the
+ * SHKWON_ENABLE_PROFILER CMake option does.
+ */
+#if defined(SHKWON_ENABLE_PROFILER)
+#define SHKWON_PROFILE_CONCAT_IMPL(a, b) a##b
+#define SHKWON_PROFILE_CONCAT(a, b) SHKWON_PROFILE_CONCAT_IMPL(a, b)
+#define SHKWON_PROFILE_SCOPE(name)                                                                                     \
+    static const ::shkwon::ProfileZone SHKWON_PROFILE_CONCAT(shkwon_profile_zone_, __LINE__)(name);                   \
+    ::shkwon::ProfileScope SHKWON_PROFILE_CONCAT(shkwon_profile_scope_, __LINE__)(                                     \
+        SHKWON_PROFILE_CONCAT(shkwon_profile_zone_, __LINE__))
+#else
+#define SHKWON_PROFILE_SCOPE(name) static_cast<void>(0)
+#endif
+
+namespace shkwon
+{
+/**
+ * The aggregated timings of one zone over every thread, in nanoseconds.
+ */
+struct ProfileReport
+{
+    std::string name;
+    uint64_t count = 0;
+    double total_ns = 0;
+    double min_ns = 0;
+    double max_ns = 0;
+    // The number of timings in each bucket of the log-linear histogram, and the lowest time of each bucket.
+    std::vector<uint64_t> histogram;
+    std::vector<double> bucket_ns;
+
+    double GetMean() const
+    {
+        return count != 0 ? total_ns / static_cast<double>(count) : 0;
+    }
+
+    /**
+     * Estimates a percentile from the histogram, to within a quarter of the time.
+     *
+     * @param p The fraction of timings at or below the result, from 0 to 1.
+     */
+    double GetPercentile(double p) const
+    {
+        if (count == 0)
+        {
+            return 0;
+        }
+        auto rank = static_cast<uint64_t>(p * static_cast<double>(count - 1)) + 1;
+        uint64_t seen = 0;
+        for (size_t b = 0; b < histogram.size(); ++b)
+        {
+            seen += histogram[b];
+            if (seen >= rank)
+            {
+                return std::min(std::max(bucket_ns[b], min_ns), max_ns);
+            }
+        }
+        return max_ns;
+    }
+};
+
+/**
+ * Collects the timings of the profiling zones.
+ *
+ * Every thread records into stats of its own, allocated the first time it enters a zone, so recording takes no lock
+ * and no atomic read-modify-write: the only writer of the stats stores plain values, which collecting threads may read
+ * at any time. Locks are only taken to register a zone or a thread and to collect. The stats of threads that exit are
+ * merged into a total that stays.
+ */
+class Profiler
+{
+public:
+    /**
+     * The most zones a program may have.
+     */
+    static constexpr uint32_t kMaxZones = 256;
+
+    static Profiler &Get()
+    {
+        static Profiler profiler;
+        return profiler;
+    }
+
+    Profiler(const Profiler &) = delete;
+    Profiler &operator=(const Profiler &) = delete;
+
+    /**
+     * @return The ID of the zone. Zones with the same name share it.
+     */
+    uint32_t RegisterZone(const char *name)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = std::find(names_.begin(), names_.end(), name);
+        if (it != names_.end())
+        {
+            return static_cast<uint32_t>(it - names_.begin());
+        }
+        if (names_.size() >= kMaxZones)
+        {
+            throw std::length_error("Too many profiling zones.");
+        }
+        names_.emplace_back(name);
+        return static_cast<uint32_t>(names_.size() - 1);
+    }
+
+    /**
+     * Adds a timing to the stats of the calling thread.
+     *
+     * @param zone The ID of the zone.
+     * @param ticks The time taken, in ticks of ProfileClock.
+     */
+    void Record(uint32_t zone, uint64_t ticks)
+    {
+        auto &profile = GetThreadProfile();
+        auto *stats = profile.zones[zone].load(std::memory_order_relaxed);
+        if (stats == nullptr)
+        {
+            stats = new ZoneStats();
+            profile.zones[zone].store(stats, std::memory_order_release);
+        }
+        stats->Add(ticks);
+    }
+
+    /**
+     * Collects the stats of every zone entered so far, over every thread. Threads go on recording meanwhile, so the
+     * fields of a report may be a few timings apart.
+     */
+    std::vector<ProfileReport> Collect()
+    {
+        std::vector<ProfileReport> reports;
+        auto ns_per_tick = ProfileClock::GetNanosecondsPerTick();
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (uint32_t zone = 0; zone < names_.size(); ++zone)
+        {
+            ZoneTotals totals;
+            totals.Merge(retired_[zone]);
+            for (auto *profile : threads_)
+            {
+                if (auto *stats = profile->zones[zone].load(std::memory_order_acquire))
+                {
+                    totals.Merge(*stats);
+                }
+            }
+            if (totals.count == 0)
+            {
+                continue;
+            }
+
+            ProfileReport report;
+            report.name = names_[zone];
+            report.count = totals.count;
+            report.total_ns = static_cast<double>(totals.total) * ns_per_tick;
+            report.min_ns = static_cast<double>(totals.min) * ns_per_tick;
+            report.max_ns = static_cast<double>(totals.max) * ns_per_tick;
+            report.histogram.assign(totals.histogram, totals.histogram + kNumBuckets);
+            for (size_t b = 0; b < kNumBuckets; ++b)
+            {
+                report.bucket_ns.push_back(static_cast<double>(GetBucketLowerBound(b)) * ns_per_tick);
+            }
+            reports.push_back(std::move(report));
+        }
+        return reports;
+    }
+
+    /**
+     * Prints a table of every zone entered so far, in microseconds.
+     */
+    void Dump(FILE *out = stderr)
+    {
+        auto reports = this->Collect();
+        std::fprintf(out, "%-24s %12s %12s %10s %10s %10s %10s %10s\n", "zone", "count", "total_ms", "mean_us", "min_us",
+                     "p50_us", "p99_us", "max_us");
+        for (auto &report : reports)
+        {
+            std::fprintf(out, "%-24s %12llu %12.3f %10.3f %10.3f %10.3f %10.3f %10.3f\n", report.name.c_str(),
+                         static_cast<unsigned long long>(report.count), report.total_ns / 1e6, report.GetMean() / 1e3,
+                         report.min_ns / 1e3, report.GetPercentile(0.5) / 1e3, report.GetPercentile(0.99) / 1e3,
+                         report.max_ns / 1e3);
+        }
+        std::fflush(out);
+    }
+
+private:
+    // Four buckets per power of two; the error of a bucket is at most a quarter of its times.
+    static constexpr int kSubBucketBits = 2;
+    static constexpr size_t kNumBuckets = (64 - kSubBucketBits + 1) << kSubBucketBits;
+
+    static size_t GetBucket(uint64_t ticks) noexcept
+    {
+        constexpr uint64_t kSubBuckets = uint64_t(1) << kSubBucketBits;
+        if (ticks < kSubBuckets)
+        {
+            return static_cast<size_t>(ticks);
+        }
+        int msb = 63 - __builtin_clzll(ticks);
+        auto sub = (ticks >> (msb - kSubBucketBits)) & (kSubBuckets - 1);
+        return static_cast<size_t>((msb - kSubBucketBits + 1) * kSubBuckets + sub);
+    }
+
+    static uint64_t GetBucketLowerBound(size_t bucket) noexcept
+    {
+        constexpr uint64_t kSubBuckets = uint64_t(1) << kSubBucketBits;
+        if (bucket < kSubBuckets)
+        {
+            return bucket;
+        }
+        int msb = static_cast<int>(bucket / kSubBuckets) + kSubBucketBits - 1;
+        return (kSubBuckets + bucket % kSubBuckets) << (msb - kSubBucketBits);
+    }
+
+    // Written by one thread only, with loads and stores rather than read-modify-writes; atomic so that collecting is
+    // not a data race.
+    struct ZoneStats
+    {
+        std::atomic<uint64_t> count{ 0 };
+        std::atomic<uint64_t> total{ 0 };
+        std::atomic<uint64_t> min{ UINT64_MAX };
+        std::atomic<uint64_t> max{ 0 };
+        std::atomic<uint64_t> histogram[kNumBuckets] = {};
+
+        void Add(uint64_t ticks) noexcept
+        {
+            Bump(count, 1);
+            Bump(total, ticks);
+            if (ticks < min.load(std::memory_order_relaxed))
+            {
+                min.store(ticks, std::memory_order_relaxed);
+            }
+            if (ticks > max.load(std::memory_order_relaxed))
+            {
+                max.store(ticks, std::memory_order_relaxed);
+            }
+            Bump(histogram[GetBucket(ticks)], 1);
+        }
+
+        static void Bump(std::atomic<uint64_t> &value, uint64_t by) noexcept
+        {
+            value.store(value.load(std::memory_order_relaxed) + by, std::memory_order_relaxed);
+        }
+    };
+
+    struct ZoneTotals
+    {
+        uint64_t count = 0;
+        uint64_t total = 0;
+        uint64_t min = UINT64_MAX;
+        uint64_t max = 0;
+        uint64_t histogram[kNumBuckets] = {};
+
+        void Merge(const ZoneStats &stats)
+        {
+            count += stats.count.load(std::memory_order_relaxed);
+            total += stats.total.load(std::memory_order_relaxed);
+            min = std::min(min, stats.min.load(std::memory_order_relaxed));
+            max = std::max(max, stats.max.load(std::memory_order_relaxed));
+            for (size_t b = 0; b < kNumBuckets; ++b)
+            {
+                histogram[b] += stats.histogram[b].load(std::memory_order_relaxed);
+            }
+        }
+
+        void Merge(const ZoneTotals &other)
+        {
+            count += other.count;
+            total += other.total;
+            min = std::min(min, other.min);
+            max = std::max(max, other.max);
+            for (size_t b = 0; b < kNumBuckets; ++b)
+            {
+                histogram[b] += other.histogram[b];
+            }
+        }
+    };
+
+    struct ThreadProfile
+    {
+        std::atomic<ZoneStats *> zones[kMaxZones] = {};
+    };
+
+    // Registers the thread's profile on its first timing and retires it when the thread exits.
+    struct ThreadHolder
+    {
+        ThreadHolder()
+            : profile(new ThreadProfile())
+        {
+            Profiler::Get().AddThread(profile);
+        }
+
+        ~ThreadHolder()
+        {
+            Profiler::Get().RetireThread(profile);
+        }
+
+        ThreadProfile *profile;
+    };
+
+    Profiler()
+        : retired_(new ZoneTotals[kMaxZones])
+    {
+        ProfileClock::Calibrate();
+    }
+
+    static ThreadProfile &GetThreadProfile()
+    {
+        static thread_local ThreadHolder holder;
+        return *holder.profile;
+    }
+
+    void AddThread(ThreadProfile *profile)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        threads_.push_back(profile);
+    }
+
+    void RetireThread(ThreadProfile *profile)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        threads_.erase(std::find(threads_.begin(), threads_.end(), profile));
+        for (uint32_t zone = 0; zone < kMaxZones; ++zone)
+        {
+            if (auto *stats = profile->zones[zone].load(std::memory_order_relaxed))
+            {
+                retired_[zone].Merge(*stats);
+                delete stats;
+            }
+        }
+        delete profile;
+    }
+
+    std::mutex mutex_;
+    std::vector<std::string> names_;
+    std::vector<ThreadProfile *> threads_;
+    // The stats of the threads that have exited.
+    std::unique_ptr<ZoneTotals[]> retired_;
+};
+
+/**
+ * A named zone to time. Meant to be a function-local static, as SHKWON_PROFILE_SCOPE declares it.
+ */
+class ProfileZone
+{
+public:
+    explicit ProfileZone(const char *name)
+        : id_(Profiler::Get().RegisterZone(name))
+    {
+    }
+
+    uint32_t GetID() const noexcept
+    {
+        return id_;
+    }
+
+private:
+    uint32_t id_;
+};
+
+/**
+ * Times its own lifetime into a zone.
+ */
+class ProfileScope
+{
+public:
+    explicit ProfileScope(const ProfileZone &zone) noexcept
+        : zone_(zone.GetID())
+        , start_(ProfileClock::Now())
+    {
+    }
+
+    ProfileScope(const ProfileScope &) = delete;
+    ProfileScope &operator=(const ProfileScope &) = delete;
+
+    ~ProfileScope()
+    {
+        Profiler::Get().Record(zone_, ProfileClock::Now() - start_);
+    }
+
+private:
+    uint32_t zone_;
+    uint64_t start_;
+};
+
+/**
+ * Dumps the profiler periodically on a thread of its own, and once more when destroyed.
+ */
+class ProfileDumper
+{
+public:
+    /**
+     * @param interval The time between two dumps.
+     * @param out Where to print the dumps.
+     */
+    explicit ProfileDumper(std::chrono::nanoseconds interval, FILE *out = stderr)
+        : interval_(interval)
+        , out_(out)
+        , stop_flag_(false)
+    {
+        thread_ = std::thread([this]() {
+            std::unique_lock<std::mutex> lock(mutex_);
+            while (!cv_.wait_for(lock, interval_, [this]() { return stop_flag_; }))
+            {
+                Profiler::Get().Dump(out_);
+            }
+        });
+    }
+
+    ProfileDumper(const ProfileDumper &) = delete;
+    ProfileDumper &operator=(const ProfileDumper &) = delete;
+
+    ~ProfileDumper()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_flag_ = true;
+        }
+        cv_.notify_all();
+        thread_.join();
+        Profiler::Get().Dump(out_);
+    }
+
+private:
+    std::chrono::nanoseconds interval_;
+    FILE *out_;
+    bool stop_flag_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::thread thread_;
+};
+} // namespace shkwon